@@ -0,0 +1,136 @@
+#!/bin/sh
+#===============================================================================
+#   bench.sh    |   part of dec2bin     |   FreeBSD License
+#   James Hendrie                       |   hendrie.james@gmail.com
+#
+#   Benchmarks a dec2bin binary over a fixed set of generated corpora and
+#   flag combinations.  Each case gets a warm-up run, then RUNS timed runs;
+#   the median is reported as numbers/sec, input MB/s and output MB/s, on
+#   the terminal and as JSON.
+#
+#   Usage:  bench.sh [DEC2BIN]
+#
+#   Environment:
+#       RUNS        timed runs per case (default 5)
+#       SCALE       corpus size multiplier (default 1)
+#       GENCORPUS   corpus generator (default bench/gencorpus)
+#       BENCH_JSON  where the JSON goes (default bench_results.json)
+#===============================================================================
+
+DEC2BIN=${1:-./dec2bin}
+RUNS=${RUNS:-5}
+SCALE=${SCALE:-1}
+GENCORPUS=${GENCORPUS:-bench/gencorpus}
+BENCH_JSON=${BENCH_JSON:-bench_results.json}
+
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/dec2bin-bench.XXXXXX") || exit 1
+trap 'rm -rf "$WORK"' EXIT INT TERM
+
+
+#   Nanoseconds on the wall clock (GNU date).  It can jump if the clock is
+#   set mid-run, which spoils that one sample; the median of RUNS of them
+#   shrugs it off.  A monotonic clock from the shell would mean starting
+#   another program, and its start-up time would land in every sample.
+now_ns()
+{
+    date +%s%N
+}
+
+
+#   gen NAME KIND COUNT: write a corpus and remember how many items it holds
+gen()
+{
+    "$GENCORPUS" "$2" "$3" 1 > "$WORK/$1" || exit 1
+    echo "$3" > "$WORK/$1.count"
+}
+
+
+echo "Generating corpora (SCALE=$SCALE)..."
+gen small   small   $(( 2000000 * SCALE ))
+gen large   large   $(( 1000000 * SCALE ))
+gen huge    huge    $((  200000 * SCALE ))
+gen text    text    $(( 20000000 * SCALE ))
+gen argv    large   $((   50000 * SCALE ))
+
+
+#   run_case NAME CORPUS INPUT FLAGS...
+#       INPUT is 'stdin' (the corpus is piped in) or 'argv' (the numbers are
+#       handed over as arguments, through xargs)
+first=1
+run_case()
+{
+    name=$1; corpus=$2; input=$3
+    shift 3
+
+    file="$WORK/$corpus"
+    items=$(cat "$file.count")
+    inBytes=$(wc -c < "$file")
+
+    if [ "$input" = "argv" ]; then
+        set -- xargs "$DEC2BIN" "$@"
+    else
+        set -- "$DEC2BIN" "$@" -
+    fi
+
+    #   Warm-up, which also measures the output
+    outBytes=$( "$@" < "$file" | wc -c )
+
+    times=""
+    i=0
+    while [ $i -lt "$RUNS" ]; do
+        start=$(now_ns)
+        "$@" < "$file" > /dev/null
+        end=$(now_ns)
+        times="$times $(( end - start ))"
+        i=$(( i + 1 ))
+    done
+
+    median=$(printf '%s\n' $times | sort -n |
+        awk '{ t[NR] = $1 } END { print t[int((NR + 1) / 2)] }')
+
+    set -- $(awk -v ns="$median" -v n="$items" -v ib="$inBytes" \
+        -v ob="$outBytes" 'BEGIN {
+            s = ns / 1e9
+            printf "%.6f %.0f %.2f %.2f\n", s, n / s, ib / s / 1e6, ob / s / 1e6
+        }')
+
+    printf '%-18s %10s s %14s num/s %10s MB/s in %10s MB/s out\n' \
+        "$name" "$1" "$2" "$3" "$4"
+
+    if [ $first -eq 0 ]; then printf ',\n' >> "$BENCH_JSON"; fi
+    first=0
+    printf '    { "name": "%s", "input": "%s", "items": %s, ' \
+        "$name" "$input" "$items" >> "$BENCH_JSON"
+    printf '"input_bytes": %s, "output_bytes": %s, "runs": %s, ' \
+        "$inBytes" "$outBytes" "$RUNS" >> "$BENCH_JSON"
+    printf '"median_seconds": %s, "numbers_per_sec": %s, ' \
+        "$1" "$2" >> "$BENCH_JSON"
+    printf '"input_mb_per_sec": %s, "output_mb_per_sec": %s }' \
+        "$3" "$4" >> "$BENCH_JSON"
+}
+
+
+printf '{\n  "dec2bin": "%s",\n  "version": "%s",\n  "date": "%s",\n' \
+    "$DEC2BIN" "$("$DEC2BIN" --version | head -n 1)" \
+    "$(date -u +%Y-%m-%dT%H:%M:%SZ)" > "$BENCH_JSON"
+printf '  "runs": %s,\n  "scale": %s,\n  "cases": [\n' \
+    "$RUNS" "$SCALE" >> "$BENCH_JSON"
+
+echo "Running $RUNS timed runs per case..."
+run_case small-bin      small   stdin
+run_case small-vxXoasl  small   stdin   -vxXoasl
+run_case large-bin      large   stdin
+run_case large-xo       large   stdin   -xo
+run_case large-se       large   stdin   -se
+run_case large-vxXoasl  large   stdin   -vxXoasl
+run_case large-dj4      large   stdin   -d -j 4
+run_case huge-bin       huge    stdin
+run_case huge-xo        huge    stdin   -xo
+run_case text-bin       text    stdin   -t
+run_case text-se        text    stdin   -tse
+run_case text-vxl       text    stdin   -tvxl
+run_case argv-bin       argv    argv
+run_case argv-vxXoasl   argv    argv    -vxXoasl
+
+printf '\n  ]\n}\n' >> "$BENCH_JSON"
+echo "Results written to $BENCH_JSON"
@@ -0,0 +1,124 @@
+/*******************************************************************************
+ * gencorpus.c  |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      Writes reproducible benchmark input to stdout.  The same kind, size
+ *      and seed always give the same bytes, so runs on different builds (or
+ *      machines) convert exactly the same thing.
+ *
+ *  Usage:
+ *      gencorpus KIND COUNT [SEED]
+ *
+ *      small   COUNT numbers from 0 to 65535, several to a line
+ *      large   COUNT numbers spread over the whole 64-bit range
+ *      huge    COUNT 128-bit numbers (past 64 bits, so the bignum path)
+ *      text    COUNT bytes of printable ASCII text in lines
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+static uint64_t state;
+
+
+/*  xorshift64*; plenty random for a benchmark and the same everywhere */
+static uint64_t next_random(void)
+{
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+
+    return( state * 2685821657736338717ULL );
+}
+
+
+/*  Random number of a random bit length, so every width shows up */
+static uint64_t random_width(void)
+{
+    int bits = (int)( next_random() % 64 ) + 1;
+
+    if( bits == 64 )
+        return( next_random() );
+
+    return( next_random() & ( ( 1ULL << bits ) - 1 ) );
+}
+
+
+/*  Print the 128-bit value hi:lo in decimal */
+static void print_u128( uint64_t hi, uint64_t lo )
+{
+    unsigned __int128 n = ( (unsigned __int128)hi << 64 ) | lo;
+    char digits[40];
+    int i = sizeof( digits );
+
+    digits[--i] = '\0';
+    do
+    {
+        digits[--i] = (char)( '0' + (int)( n % 10 ) );
+        n /= 10;
+    } while( n != 0 );
+
+    fputs( digits + i, stdout );
+}
+
+
+int main( int argc, char *argv[] )
+{
+    unsigned long long count = 0;
+    unsigned long long i = 0;
+
+    if( argc < 3 )
+    {
+        fprintf(stderr,
+                "Usage:\tgencorpus small|large|huge|text COUNT [SEED]\n");
+        return(1);
+    }
+
+    count = strtoull( argv[2], NULL, 10 );
+    state = ( argc > 3 ) ? strtoull( argv[3], NULL, 10 ) : 0;
+    state ^= 0x9e3779b97f4a7c15ULL;     //  Never zero, even for seed 0
+
+    if( strcmp( argv[1], "small" ) == 0 )
+    {
+        for( i = 0; i < count; ++i )
+            printf( "%llu%c", (unsigned long long)( next_random() % 65536 ),
+                    ( i % 8 == 7 ) ? '\n' : ' ' );
+    }
+    else if( strcmp( argv[1], "large" ) == 0 )
+    {
+        for( i = 0; i < count; ++i )
+            printf( "%llu\n", (unsigned long long)random_width() );
+    }
+    else if( strcmp( argv[1], "huge" ) == 0 )
+    {
+        for( i = 0; i < count; ++i )
+        {
+            print_u128( next_random() | 1, next_random() );
+            putchar( '\n' );
+        }
+    }
+    else if( strcmp( argv[1], "text" ) == 0 )
+    {
+        for( i = 0; i < count; ++i )
+        {
+            uint64_t r = next_random();
+
+            /*  Mostly letters and spaces, an occasional newline */
+            if( r % 61 == 0 )
+                putchar( '\n' );
+            else if( r % 7 == 0 )
+                putchar( ' ' );
+            else
+                putchar( 0x21 + (int)( ( r >> 8 ) % 94 ) );
+        }
+    }
+    else
+    {
+        fprintf(stderr, "gencorpus:  unknown kind '%s'\n", argv[1] );
+        return(1);
+    }
+
+    return(0);
+}
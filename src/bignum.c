@@ -0,0 +1,920 @@
+/*******************************************************************************
+ * bignum.c     |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      Arbitrary-precision unsigned integers; see bignum.h
+ *
+ *  Notes:
+ *      Decimal to binary works by splitting the digit string in two, the low
+ *      half being 19 * 2^i digits long, converting each half recursively and
+ *      joining them as hi * 10^(19 * 2^i) + lo.  The powers of ten are built
+ *      by repeated squaring.  With Karatsuba doing the multiplying, the whole
+ *      thing costs roughly O(n^1.6) instead of the O(n^2) of the schoolbook
+ *      multiply-by-ten-and-add loop.
+ *
+ *      Binary to decimal runs the same split backwards: divide by the power,
+ *      then write out the quotient and remainder recursively.  The division
+ *      is a multiply by a Newton inverse of the power, so the cost stays
+ *      within a small factor of the way in.
+ ******************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+
+#include "bignum.h"
+#include "convert.h"
+
+typedef unsigned __int128 uint128_t;
+
+#define CHUNK_DIGITS 19                     //  10^19 is the most a limb holds
+#define CHUNK_BASE 10000000000000000000ULL  //  10^19
+#define LEAF_DIGITS ( CHUNK_DIGITS * 16 )   //  Below this, go schoolbook
+#define KARATSUBA_LIMBS 32                  //  Below this, go schoolbook
+#define MAX_POWERS 64
+
+/*
+ *  10^(19 * 2^i) for i < count, built as they're needed, and for the way
+ *  back to decimal, B^(2 * size) / 10^(19 * 2^i) for i < inverses, B being
+ *  2^64 (rounded down, and maybe a little further)
+ */
+struct radix_powers
+{
+    uint64_t *limbs[MAX_POWERS];
+    size_t size[MAX_POWERS];
+    int count;
+    uint64_t *inverse[MAX_POWERS];  //  size + 1 limbs each
+    int inverses;
+};
+
+static const uint64_t powersOfTen[CHUNK_DIGITS + 1] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+    100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+    100000000000000000ULL, 1000000000000000000ULL, CHUNK_BASE };
+
+
+/*  Upper bound on the limbs needed for [digits] decimal digits */
+static size_t limbs_for_digits( size_t digits )
+{
+    return( digits / CHUNK_DIGITS + 4 );
+}
+
+
+/*  Length of [a] once leading zero limbs are dropped */
+static size_t normalize( const uint64_t *a, size_t n )
+{
+    while( n > 0 && a[n - 1] == 0 )
+        --n;
+
+    return( n );
+}
+
+
+/*  r = a + b, where an >= bn; returns the carry out of the top limb */
+static uint64_t add_n( uint64_t *r, const uint64_t *a, size_t an,
+        const uint64_t *b, size_t bn )
+{
+    uint64_t carry = 0;
+    size_t i = 0;
+
+    for( i = 0; i < bn; ++i )
+    {
+        uint128_t t = (uint128_t)a[i] + b[i] + carry;
+        r[i] = (uint64_t)t;
+        carry = (uint64_t)( t >> 64 );
+    }
+    for( ; i < an; ++i )
+    {
+        r[i] = a[i] + carry;
+        carry = ( r[i] < carry );
+    }
+
+    return( carry );
+}
+
+
+/*  r += b, rippling the carry no further than rn limbs */
+static void add_into( uint64_t *r, size_t rn, const uint64_t *b, size_t bn )
+{
+    uint64_t carry = 0;
+    size_t i = 0;
+
+    for( i = 0; i < bn; ++i )
+    {
+        uint128_t t = (uint128_t)r[i] + b[i] + carry;
+        r[i] = (uint64_t)t;
+        carry = (uint64_t)( t >> 64 );
+    }
+    for( ; carry != 0 && i < rn; ++i )
+    {
+        ++r[i];
+        carry = ( r[i] == 0 );
+    }
+}
+
+
+/*  r -= b, where r >= b */
+static void sub_into( uint64_t *r, size_t rn, const uint64_t *b, size_t bn )
+{
+    uint64_t borrow = 0;
+    size_t i = 0;
+
+    for( i = 0; i < bn; ++i )
+    {
+        uint64_t ri = r[i];
+        uint64_t d = ri - b[i];
+        uint64_t out = ( ri < b[i] );
+
+        out |= ( d < borrow );
+        r[i] = d - borrow;
+        borrow = out;
+    }
+    for( ; borrow != 0 && i < rn; ++i )
+    {
+        borrow = ( r[i] == 0 );
+        --r[i];
+    }
+}
+
+
+/*  Schoolbook r = a * b; r holds an + bn limbs */
+static void mul_basecase( uint64_t *r, const uint64_t *a, size_t an,
+        const uint64_t *b, size_t bn )
+{
+    size_t i = 0;
+    size_t j = 0;
+
+    memset( r, 0, ( an + bn ) * sizeof( uint64_t ) );
+
+    for( i = 0; i < an; ++i )
+    {
+        uint64_t carry = 0;
+
+        for( j = 0; j < bn; ++j )
+        {
+            uint128_t t = (uint128_t)a[i] * b[j] + r[i + j] + carry;
+            r[i + j] = (uint64_t)t;
+            carry = (uint64_t)( t >> 64 );
+        }
+        r[i + bn] = carry;
+    }
+}
+
+
+/*  ----------------------  mul -------------------------------------------
+ *
+ *  r = a * b, with r holding an + bn limbs and overlapping neither input.
+ *  Karatsuba for big balanced operands, slices for lopsided ones.  Returns 1
+ *  if we run out of memory for the scratch space.
+ */
+static int mul( uint64_t *r, const uint64_t *a, size_t an,
+        const uint64_t *b, size_t bn )
+{
+    if( an < bn )
+    {
+        const uint64_t *t = a; a = b; b = t;
+        size_t tn = an; an = bn; bn = tn;
+    }
+
+    if( bn == 0 )
+    {
+        memset( r, 0, an * sizeof( uint64_t ) );
+        return( 0 );
+    }
+
+    if( bn < KARATSUBA_LIMBS )
+    {
+        mul_basecase( r, a, an, b, bn );
+        return( 0 );
+    }
+
+    /*  Lopsided: multiply b by one bn-sized slice of a at a time */
+    if( an >= 2 * bn )
+    {
+        uint64_t *t = malloc( 2 * bn * sizeof( uint64_t ) );
+        size_t offset = 0;
+
+        if( t == NULL )
+            return( 1 );
+
+        memset( r, 0, ( an + bn ) * sizeof( uint64_t ) );
+        for( offset = 0; offset < an; offset += bn )
+        {
+            size_t length = ( an - offset < bn ) ? an - offset : bn;
+
+            if( mul( t, a + offset, length, b, bn ) == 1 )
+            {
+                free( t );
+                return( 1 );
+            }
+            add_into( r + offset, an + bn - offset, t, length + bn );
+        }
+
+        free( t );
+        return( 0 );
+    }
+
+    /*
+     *  Karatsuba:  a = a1*B^m + a0, b = b1*B^m + b0, and the middle term is
+     *  (a0 + a1)(b0 + b1) - a0*b0 - a1*b1
+     */
+    size_t m = ( an + 1 ) / 2;
+    size_t a1n = an - m;
+    size_t b1n = bn - m;
+    uint64_t *scratch = malloc( ( 4 * m + 4 ) * sizeof( uint64_t ) );
+    uint64_t *sa = scratch;
+    uint64_t *sb = scratch + m + 1;
+    uint64_t *z1 = scratch + 2 * m + 2;
+
+    if( scratch == NULL )
+        return( 1 );
+
+    sa[m] = add_n( sa, a, m, a + m, a1n );
+    sb[m] = add_n( sb, b, m, b + m, b1n );
+
+    if( mul( z1, sa, m + 1, sb, m + 1 ) == 1 ||
+            mul( r, a, m, b, m ) == 1 ||
+            mul( r + 2 * m, a + m, a1n, b + m, b1n ) == 1 )
+    {
+        free( scratch );
+        return( 1 );
+    }
+
+    sub_into( z1, 2 * m + 2, r, 2 * m );
+    sub_into( z1, 2 * m + 2, r + 2 * m, a1n + b1n );
+    add_into( r + m, an + bn - m, z1, normalize( z1, 2 * m + 2 ) );
+
+    free( scratch );
+    return( 0 );
+}
+
+
+/*  ----------------------  convert_leaf  ----------------------------------
+ *
+ *  schoolbook conversion of a short digit string, 19 digits at a time
+ */
+static size_t convert_leaf( uint64_t *r, const char *digits, size_t length )
+{
+    size_t size = 0;
+    size_t position = 0;
+    size_t chunkLength = length % CHUNK_DIGITS;
+    size_t i = 0;
+
+    if( chunkLength == 0 )
+        chunkLength = CHUNK_DIGITS;
+
+    while( position < length )
+    {
+        uint64_t multiplier = powersOfTen[chunkLength];
+        uint64_t carry = 0;
+
+        /*  Gather the chunk, then r = r * 10^chunkLength + chunk */
+        for( i = 0; i < chunkLength; ++i )
+            carry = carry * 10 + (uint64_t)( digits[position + i] - '0' );
+
+        for( i = 0; i < size; ++i )
+        {
+            uint128_t t = (uint128_t)r[i] * multiplier + carry;
+            r[i] = (uint64_t)t;
+            carry = (uint64_t)( t >> 64 );
+        }
+        if( carry != 0 )
+            r[size++] = carry;
+
+        position += chunkLength;
+        chunkLength = CHUNK_DIGITS;
+    }
+
+    return( size );
+}
+
+
+/*  Make sure powers->limbs[index] exists, squaring our way up to it */
+static int build_power( struct radix_powers *powers, int index )
+{
+    while( powers->count <= index )
+    {
+        int i = powers->count;
+        size_t size = powers->size[i - 1];
+        uint64_t *p = malloc( 2 * size * sizeof( uint64_t ) );
+
+        if( p == NULL )
+            return( 1 );
+
+        if( mul( p, powers->limbs[i - 1], size,
+                    powers->limbs[i - 1], size ) == 1 )
+        {
+            free( p );
+            return( 1 );
+        }
+
+        powers->limbs[i] = p;
+        powers->size[i] = normalize( p, 2 * size );
+        ++powers->count;
+    }
+
+    return( 0 );
+}
+
+
+/*  Release whatever build_power and build_inverse made */
+static void free_powers( struct radix_powers *powers )
+{
+    int i = 0;
+
+    for( i = 1; i < powers->count; ++i )
+        free( powers->limbs[i] );
+    for( i = 0; i < powers->inverses; ++i )
+        free( powers->inverse[i] );
+}
+
+
+/*  ----------------------  convert_range ---------------------------------
+ *
+ *  r = the value of [length] digits, recursively; r holds
+ *  limbs_for_digits(length) limbs.  Returns 1 when out of memory.
+ */
+static int convert_range( struct radix_powers *powers, uint64_t *r,
+        const char *digits, size_t length, size_t *size )
+{
+    if( length <= LEAF_DIGITS )
+    {
+        *size = convert_leaf( r, digits, length );
+        return( 0 );
+    }
+
+    /*  Low part is the biggest 19 * 2^i digits that leave a high part */
+    int index = 0;
+    while( ( (size_t)CHUNK_DIGITS << ( index + 1 ) ) < length )
+        ++index;
+
+    size_t lowLength = (size_t)CHUNK_DIGITS << index;
+    size_t highLength = length - lowLength;
+    size_t lowSize = 0;
+    size_t highSize = 0;
+    uint64_t *low = malloc( limbs_for_digits( lowLength )
+            * sizeof( uint64_t ) );
+    uint64_t *high = malloc( limbs_for_digits( highLength )
+            * sizeof( uint64_t ) );
+    int status = 1;
+
+    if( low != NULL && high != NULL &&
+            build_power( powers, index ) == 0 &&
+            convert_range( powers, high, digits, highLength, &highSize ) == 0 &&
+            convert_range( powers, low, digits + highLength, lowLength,
+                &lowSize ) == 0 )
+    {
+        size_t powerSize = powers->size[index];
+
+        /*  r = high * 10^lowLength + low */
+        if( mul( r, powers->limbs[index], powerSize, high, highSize ) == 0 )
+        {
+            size_t total = powerSize + highSize;
+
+            if( total < lowSize )
+            {
+                memset( r + total, 0,
+                        ( lowSize - total ) * sizeof( uint64_t ) );
+                total = lowSize;
+            }
+            add_into( r, total, low, lowSize );
+            *size = normalize( r, total );
+            status = 0;
+        }
+    }
+
+    free( low );
+    free( high );
+    return( status );
+}
+
+
+/*  ----------------------  bignum_from_decimal  ----------------------------
+ *
+ *  read a string of decimal digits into [number]
+ */
+int bignum_from_decimal( struct bignum *number, const char *digits,
+        size_t length )
+{
+    struct radix_powers powers;
+    uint64_t base = CHUNK_BASE;
+    int status = 0;
+
+    number->limbs = NULL;
+    number->size = 0;
+
+    /*  Leading zeroes only make the recursion deeper */
+    while( length > 0 && *digits == '0' )
+    {
+        ++digits;
+        --length;
+    }
+
+    number->limbs = malloc( limbs_for_digits( length ) * sizeof( uint64_t ) );
+    if( number->limbs == NULL )
+        return( 1 );
+
+    powers.limbs[0] = &base;
+    powers.size[0] = 1;
+    powers.count = 1;
+    powers.inverses = 0;
+
+    status = convert_range( &powers, number->limbs, digits, length,
+            &number->size );
+
+    free_powers( &powers );
+
+    if( status != 0 )
+        bignum_free( number );
+
+    return( status );
+}
+
+
+/*  ----------------------  bignum_from_digits  -----------------------------
+ *
+ *  a power-of-two radix needs no arithmetic: each digit's bits are just
+ *  ORed into place, straddling two limbs when they have to
+ */
+int bignum_from_digits( struct bignum *number, const char *digits,
+        size_t length, int bits, int bigEndian )
+{
+    size_t limbs = ( length * bits + 63 ) / 64 + 1;
+    size_t i = 0;
+
+    number->size = 0;
+    number->limbs = calloc( limbs, sizeof( uint64_t ) );
+    if( number->limbs == NULL )
+        return( 1 );
+
+    for( i = 0; i < length; ++i )
+    {
+        unsigned char c = (unsigned char)digits[i];
+        uint64_t digit = ( c <= '9' ) ? c - '0' : ( c | 0x20 ) - 'a' + 10;
+        size_t position = ( ( bigEndian == 1 ) ? length - 1 - i : i ) * bits;
+        unsigned shift = position % 64;
+
+        number->limbs[position / 64] |= digit << shift;
+        if( shift + bits > 64 )
+            number->limbs[position / 64 + 1] |= digit >> ( 64 - shift );
+    }
+
+    number->size = normalize( number->limbs, limbs );
+    return( 0 );
+}
+
+
+void bignum_free( struct bignum *number )
+{
+    free( number->limbs );
+    number->limbs = NULL;
+    number->size = 0;
+}
+
+
+size_t bignum_bit_length( const struct bignum *number )
+{
+    if( number->size == 0 )
+        return( 0 );
+
+    return( ( number->size - 1 ) * 64 +
+            bit_length( number->limbs[number->size - 1] ) );
+}
+
+
+/*  ---------------------   bignum_to_binary    ---------------------------
+ *
+ *  one 64-digit run per limb, the top limb trimmed of its leading zeroes
+ */
+size_t bignum_to_binary( char *s, const struct bignum *number, int bigEndian )
+{
+    size_t length = 0;
+    size_t i = 0;
+
+    if( number->size == 0 )
+        return( u64_to_binary( s, 0, 0, bigEndian ) );
+
+    if( bigEndian == 1 )
+    {
+        length = u64_to_binary( s, number->limbs[number->size - 1], 0, 1 );
+        for( i = number->size - 1; i > 0; --i )
+            length += u64_to_binary( s + length, number->limbs[i - 1], 64, 1 );
+    }
+    else
+    {
+        for( i = 0; i + 1 < number->size; ++i )
+            length += u64_to_binary( s + length, number->limbs[i], 64, 0 );
+        length += u64_to_binary( s + length, number->limbs[i], 0, 0 );
+    }
+
+    return( length );
+}
+
+
+size_t bignum_to_hex( char *s, const struct bignum *number, int caps )
+{
+    size_t length = 0;
+    size_t i = 0;
+
+    if( number->size == 0 )
+        return( u64_to_hex( s, 0, 0, caps ) );
+
+    length = u64_to_hex( s, number->limbs[number->size - 1], 0, caps );
+    for( i = number->size - 1; i > 0; --i )
+        length += u64_to_hex( s + length, number->limbs[i - 1],
+                MAX_HEX_DIGITS, caps );
+
+    return( length );
+}
+
+
+/*  Octal digits straddle limbs, so pull each three-bit group out directly */
+size_t bignum_to_octal( char *s, const struct bignum *number )
+{
+    size_t bits = bignum_bit_length( number );
+    size_t length = ( bits + 2 ) / 3;
+    size_t i = 0;
+
+    if( length == 0 )
+    {
+        s[0] = '0';
+        return( 1 );
+    }
+
+    for( i = 0; i < length; ++i )
+    {
+        size_t position = ( length - 1 - i ) * 3;
+        size_t limb = position / 64;
+        unsigned shift = position % 64;
+        uint64_t group = number->limbs[limb] >> shift;
+
+        if( shift > 61 && limb + 1 < number->size )
+            group |= number->limbs[limb + 1] << ( 64 - shift );
+
+        s[i] = (char)( '0' + ( group & 7 ) );
+    }
+
+    return( length );
+}
+
+
+/*  -1, 0 or 1 as [a] is less than, equal to or greater than [b] */
+static int compare( const uint64_t *a, size_t an, const uint64_t *b,
+        size_t bn )
+{
+    an = normalize( a, an );
+    bn = normalize( b, bn );
+    if( an != bn )
+        return( ( an < bn ) ? -1 : 1 );
+
+    while( an > 0 )
+    {
+        --an;
+        if( a[an] != b[an] )
+            return( ( a[an] < b[an] ) ? -1 : 1 );
+    }
+
+    return( 0 );
+}
+
+
+/*  ----------------------  refine_inverse  --------------------------------
+ *
+ *  Newton's method from below: [x] (n + 1 limbs) is at most
+ *  floor(B^(2n) / p), and ends up no more than a few short of it.  Each
+ *  step takes d = B^(2n) - p * x and adds x * d / B^(2n), squaring the
+ *  error, so once a step adds less than half the limbs of x the next one
+ *  would add next to nothing.  Only the top limbs of x and d can reach
+ *  the sum, so the rest are left out.  Returns 1 when out of memory.
+ */
+static int refine_inverse( uint64_t *x, const uint64_t *p, size_t n )
+{
+    uint64_t *d = malloc( ( 5 * n + 2 ) * sizeof( uint64_t ) );
+    uint64_t *t = d + 2 * n + 1;
+    const uint64_t one = 1;
+    size_t size = 0;
+    size_t dn = 0;
+    size_t xCut = 0;
+    size_t dCut = 0;
+    size_t step = 0;
+    size_t i = 0;
+
+    if( d == NULL )
+        return( 1 );
+
+    for( ;; )
+    {
+        size = normalize( x, n + 1 );
+        if( mul( d, x, size, p, n ) == 1 )
+        {
+            free( d );
+            return( 1 );
+        }
+        for( i = size + n; i < 2 * n; ++i )
+            d[i] = 0;
+
+        /*  p * x is at most B^(2n), so its negative is d */
+        for( i = 0; i < 2 * n; ++i )
+            d[i] = ~d[i];
+        add_into( d, 2 * n, &one, 1 );
+
+        if( compare( d, 2 * n, p, n ) < 0 )
+            break;
+
+        /*
+         *  d is at least p, so it has n limbs or more.  Leaving out all but
+         *  the top of each side costs the sum less than one.
+         */
+        dn = normalize( d, 2 * n );
+        dCut = ( n > 2 ) ? n - 2 : 0;
+        xCut = ( dn + 1 < 2 * n ) ? 2 * n - 1 - dn : 0;
+        if( xCut >= size )
+            xCut = size - 1;
+
+        if( mul( t, x + xCut, size - xCut, d + dCut, dn - dCut ) == 1 )
+        {
+            free( d );
+            return( 1 );
+        }
+        step = ( size + dn > 2 * n ) ? normalize( t + 2 * n - xCut - dCut,
+                size + dn - 2 * n ) : 0;
+
+        /*  Close enough that the step rounds to nothing; count it out */
+        if( step == 0 )
+        {
+            while( compare( d, 2 * n, p, n ) >= 0 )
+            {
+                sub_into( d, 2 * n, p, n );
+                add_into( x, n + 1, &one, 1 );
+            }
+            break;
+        }
+
+        add_into( x, n + 1, t + 2 * n - xCut - dCut, step );
+        if( 2 * step + 2 <= n )
+            break;
+    }
+
+    free( d );
+    return( 0 );
+}
+
+
+/*  ----------------------  build_inverse  ---------------------------------
+ *
+ *  make sure powers->inverse[index] exists.  The first comes from one
+ *  128-bit division; each after that starts from the square of the one
+ *  before, which is already good to half its limbs.
+ */
+static int build_inverse( struct radix_powers *powers, int index )
+{
+    if( build_power( powers, index ) == 1 )
+        return( 1 );
+
+    while( powers->inverses <= index )
+    {
+        int i = powers->inverses;
+        size_t n = powers->size[i];
+        uint64_t *x = malloc( ( n + 1 ) * sizeof( uint64_t ) );
+
+        if( x == NULL )
+            return( 1 );
+
+        if( i == 0 )
+        {
+            uint128_t q = ~(uint128_t)0 / CHUNK_BASE;
+
+            x[0] = (uint64_t)q;
+            x[1] = (uint64_t)( q >> 64 );
+        }
+        else
+        {
+            size_t previous = powers->size[i - 1];
+            uint64_t *square = malloc( ( 2 * previous + 2 ) *
+                    sizeof( uint64_t ) );
+
+            /*  Scaled from B^(4 * previous) down to B^(2n), rounding down */
+            if( square == NULL || mul( square, powers->inverse[i - 1],
+                        previous + 1, powers->inverse[i - 1],
+                        previous + 1 ) == 1 )
+            {
+                free( square );
+                free( x );
+                return( 1 );
+            }
+            memcpy( x, square + ( 4 * previous - 2 * n ),
+                    ( n + 1 ) * sizeof( uint64_t ) );
+            free( square );
+
+            if( refine_inverse( x, powers->limbs[i], n ) == 1 )
+            {
+                free( x );
+                return( 1 );
+            }
+        }
+
+        powers->inverse[i] = x;
+        ++powers->inverses;
+    }
+
+    return( 0 );
+}
+
+
+/*  ----------------------  divide_power  ---------------------------------
+ *
+ *  q = a / 10^(19 * 2^index) and r what's left, for an [a] below the square
+ *  of that power.  Only the top limbs of [a] go through the inverse, which
+ *  halves the multiply; q comes out a few short at worst.  q holds size + 1
+ *  limbs, r holds an.  Returns 1 when out of memory.
+ */
+static int divide_power( struct radix_powers *powers, int index,
+        const uint64_t *a, size_t an, uint64_t *q, size_t *qn, uint64_t *r,
+        size_t *rn )
+{
+    const uint64_t *p = powers->limbs[index];
+    size_t n = powers->size[index];
+    size_t xn = normalize( powers->inverse[index], n + 1 );
+    size_t low = ( an > n - 1 ) ? n - 1 : an;
+    uint64_t *t = malloc( ( an + 2 * n + 2 ) * sizeof( uint64_t ) );
+    const uint64_t one = 1;
+
+    if( t == NULL || mul( t, a + low, an - low, powers->inverse[index],
+                xn ) == 1 )
+    {
+        free( t );
+        return( 1 );
+    }
+
+    memset( q, 0, ( n + 1 ) * sizeof( uint64_t ) );
+    *qn = 0;
+    if( an - low + xn > n + 1 )
+    {
+        *qn = normalize( t + n + 1, an - low + xn - n - 1 );
+        memcpy( q, t + n + 1, *qn * sizeof( uint64_t ) );
+    }
+
+    if( mul( t, q, *qn, p, n ) == 1 )
+    {
+        free( t );
+        return( 1 );
+    }
+    memcpy( r, a, an * sizeof( uint64_t ) );
+    sub_into( r, an, t, normalize( t, *qn + n ) );
+    *rn = normalize( r, an );
+
+    while( compare( r, *rn, p, n ) >= 0 )
+    {
+        sub_into( r, *rn, p, n );
+        *rn = normalize( r, *rn );
+        add_into( q, n + 1, &one, 1 );
+        *qn = normalize( q, n + 1 );
+    }
+
+    free( t );
+    return( 0 );
+}
+
+
+/*  ----------------------  decimal_leaf  ----------------------------------
+ *
+ *  schoolbook: divide a copy of [a] by 10^19 until nothing is left and
+ *  print the remainders most significant first, padded to [width] digits
+ *  if that isn't 0.  [a] is under 10^LEAF_DIGITS.
+ */
+static size_t decimal_leaf( char *s, const uint64_t *a, size_t size,
+        size_t width )
+{
+    uint64_t limbs[LEAF_DIGITS / CHUNK_DIGITS + 1];
+    uint64_t parts[LEAF_DIGITS / CHUNK_DIGITS + 1];
+    size_t chunks = 0;
+    size_t length = 0;
+    size_t i = 0;
+
+    memcpy( limbs, a, size * sizeof( uint64_t ) );
+    while( size > 0 )
+    {
+        uint64_t remainder = 0;
+
+        for( i = size; i > 0; --i )
+        {
+            uint128_t part = ( (uint128_t)remainder << 64 ) | limbs[i - 1];
+
+            limbs[i - 1] = (uint64_t)( part / CHUNK_BASE );
+            remainder = (uint64_t)( part % CHUNK_BASE );
+        }
+
+        parts[chunks++] = remainder;
+        size = normalize( limbs, size );
+    }
+
+    if( width > 0 )
+    {
+        for( i = width / CHUNK_DIGITS; i > 0; --i )
+            length += u64_to_decimal( s + length, ( i <= chunks ) ?
+                    parts[i - 1] : 0, CHUNK_DIGITS );
+        return( length );
+    }
+
+    if( chunks == 0 )
+        return( u64_to_decimal( s, 0, 0 ) );
+
+    length = u64_to_decimal( s, parts[chunks - 1], 0 );
+    for( i = chunks - 1; i > 0; --i )
+        length += u64_to_decimal( s + length, parts[i - 1], CHUNK_DIGITS );
+
+    return( length );
+}
+
+
+/*  ----------------------  decimal_range  ---------------------------------
+ *
+ *  convert_range the other way: write [a], which is under
+ *  10^(19 * 2^(index + 1)), as the digits of a / 10^(19 * 2^index) then
+ *  those of the remainder, padded to half of [width] (or, for a [width] of
+ *  0, the first half unpadded).  Sets *length to the digits written;
+ *  returns 1 when out of memory.
+ */
+static int decimal_range( struct radix_powers *powers, const uint64_t *a,
+        size_t an, int index, char *s, size_t width, size_t *length )
+{
+    size_t half = (size_t)CHUNK_DIGITS << index;
+    size_t n = 0;
+    size_t qn = 0;
+    size_t rn = 0;
+    size_t written = 0;
+    int status = 1;
+
+    if( 2 * half <= LEAF_DIGITS )
+    {
+        *length = decimal_leaf( s, a, an, width );
+        return( 0 );
+    }
+
+    n = powers->size[index];
+    uint64_t *q = malloc( ( n + 1 + an ) * sizeof( uint64_t ) );
+    uint64_t *r = q + n + 1;
+
+    if( q != NULL &&
+            divide_power( powers, index, a, an, q, &qn, r, &rn ) == 0 )
+    {
+        if( width == 0 && qn == 0 )
+            status = decimal_range( powers, r, rn, index - 1, s, 0, length );
+        else if( decimal_range( powers, q, qn, index - 1, s, width / 2,
+                    &written ) == 0 &&
+                decimal_range( powers, r, rn, index - 1, s + written, half,
+                    length ) == 0 )
+        {
+            *length += written;
+            status = 0;
+        }
+    }
+
+    free( q );
+    return( status );
+}
+
+
+/*  ---------------------   bignum_to_decimal   ---------------------------
+ *
+ *  split in two by the biggest 10^(19 * 2^i) below the number, as
+ *  convert_range does on the way in, dividing by way of a Newton inverse
+ *  so that the whole thing costs a log factor more than one multiply.
+ *  Returns 0 if we ran out of memory.
+ */
+size_t bignum_to_decimal( char *s, const struct bignum *number )
+{
+    struct radix_powers powers;
+    uint64_t base = CHUNK_BASE;
+    size_t length = 0;
+    int index = 0;
+    int status = 0;
+
+    powers.limbs[0] = &base;
+    powers.size[0] = 1;
+    powers.count = 1;
+    powers.inverses = 0;
+
+    /*  Anything under 10^LEAF_DIGITS can go straight to the schoolbook */
+    if( number->size * 64 < LEAF_DIGITS * 3 )
+        return( decimal_leaf( s, number->limbs, number->size, 0 ) );
+
+    /*  Otherwise the smallest power whose square is past the number */
+    while( ( (size_t)CHUNK_DIGITS << ( index + 1 ) ) < LEAF_DIGITS )
+        ++index;
+    while( ( status = build_power( &powers, index + 1 ) ) == 0 &&
+            compare( number->limbs, number->size, powers.limbs[index + 1],
+                powers.size[index + 1] ) >= 0 )
+        ++index;
+
+    if( status == 0 )
+        status = build_inverse( &powers, index );
+    if( status == 0 )
+        status = decimal_range( &powers, number->limbs, number->size, index,
+                s, 0, &length );
+
+    free_powers( &powers );
+
+    return( ( status == 0 ) ? length : 0 );
+}
@@ -0,0 +1,63 @@
+/*******************************************************************************
+ * bignum.h     |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      Arbitrary-precision unsigned integers for numbers that don't fit in
+ *      64 bits.  Decimal input is converted with a divide-and-conquer radix
+ *      conversion over Karatsuba multiplication, and decimal output with the
+ *      same split in reverse, so the cost grows well below the square of the
+ *      number of digits.
+ ******************************************************************************/
+#ifndef DEC2BIN_BIGNUM_H
+#define DEC2BIN_BIGNUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*  Little-endian array of 64-bit limbs; size never counts leading zeroes */
+struct bignum
+{
+    uint64_t *limbs;
+    size_t size;
+};
+
+
+/*
+ *  Read [length] decimal digits (no sign, nothing else) into [number].
+ *  Returns 0 on success, 1 if we ran out of memory.
+ */
+int bignum_from_decimal( struct bignum *number, const char *digits,
+        size_t length );
+
+/*
+ *  Read [length] digits of [bits] bits each (1 for binary, 3 for octal, 4
+ *  for hex, in either case) into [number].  Binary can come least
+ *  significant digit first ([bigEndian] 0); the others never do.  Returns 0
+ *  on success, 1 if we ran out of memory.
+ */
+int bignum_from_digits( struct bignum *number, const char *digits,
+        size_t length, int bits, int bigEndian );
+
+/*  Release the limbs held by [number] */
+void bignum_free( struct bignum *number );
+
+/*  Number of significant bits in [number] */
+size_t bignum_bit_length( const struct bignum *number );
+
+/*
+ *  Writers; each fills [s] with digits (no terminating null) and returns the
+ *  count.  [s] must have room for bignum_bit_length() digits in binary, a
+ *  quarter of that (rounded up) in hex and a third in octal.
+ */
+size_t bignum_to_binary( char *s, const struct bignum *number, int bigEndian );
+size_t bignum_to_hex( char *s, const struct bignum *number, int caps );
+size_t bignum_to_octal( char *s, const struct bignum *number );
+
+/*
+ *  Decimal needs a third of bignum_bit_length() digits, plus one.  Returns
+ *  0 if we ran out of memory.
+ */
+size_t bignum_to_decimal( char *s, const struct bignum *number );
+
+#endif
@@ -0,0 +1,286 @@
+/*******************************************************************************
+ * bitexpand.c  |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      Bulk byte-to-bit-string expansion; see bitexpand.h
+ *
+ *  Notes:
+ *      The vector kernels copy each input byte into eight lanes, AND every
+ *      lane with its own bit (0x80, 0x40, ... for big-endian) and compare
+ *      against that bit, which leaves 0xff where the bit is set.  '0' minus
+ *      that is '1', and '0' minus zero is '0'.  With gaps, each byte's
+ *      eight digits are stored on their own at a fixed stride.
+ *
+ *      A BMI2 kernel (PDEP the byte into eight lanes, add '0') was tried for
+ *      the gapped case; it lost to the fixed-stride SSE2 stores.
+ *
+ *      Setting DEC2BIN_KERNEL=scalar or =sse2 in the environment holds the
+ *      selection down to that level, which is handy for comparing kernels.
+ ******************************************************************************/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bitexpand.h"
+#include "convert.h"
+
+#if defined(__x86_64__)
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+
+/*  Eight copies of [c], for gap runs */
+static uint64_t gap_word( char c )
+{
+    return( 0x0101010101010101ULL * (unsigned char)c );
+}
+
+
+/*  ------------------  expand_table    ---------------------------
+ *
+ *  portable kernel: one eight-byte table copy per input byte
+ */
+static size_t expand_table( char *out, const unsigned char *in, size_t n,
+        int bigEndian, char gapChar, int gapLength )
+{
+    const char (*table)[8] = bigEndian ? bigEndianBits : littleEndianBits;
+    uint64_t gap = gap_word( gapChar );
+    size_t stride = 8 + gapLength;
+    size_t i = 0;
+
+    for( i = 0; i < n; ++i )
+    {
+        memcpy( out + i * stride, table[ in[i] ], 8 );
+        memcpy( out + i * stride + 8, &gap, 8 );    //  Slack covers the spill
+    }
+
+    return( n * stride );
+}
+
+
+#ifdef HAVE_X86_KERNELS
+
+/*  Per-lane bit to test, in output order */
+static __m128i lane_bits_128( int bigEndian )
+{
+    if( bigEndian )
+        return( _mm_set_epi8( 1, 2, 4, 8, 16, 32, 64, -128,
+                    1, 2, 4, 8, 16, 32, 64, -128 ) );
+
+    return( _mm_set_epi8( -128, 64, 32, 16, 8, 4, 2, 1,
+                -128, 64, 32, 16, 8, 4, 2, 1 ) );
+}
+
+
+/*  Turn lanes holding copies of a byte into '0'/'1' characters */
+static inline __m128i lanes_to_digits_128( __m128i v, __m128i bits )
+{
+    __m128i set = _mm_cmpeq_epi8( _mm_and_si128( v, bits ), bits );
+
+    return( _mm_sub_epi8( _mm_set1_epi8( '0' ), set ) );
+}
+
+
+/*  ------------------  expand_sse2 ---------------------------
+ *
+ *  16 input bytes per step, 128 characters out; no gaps
+ */
+static size_t expand_sse2( char *out, const unsigned char *in, size_t n,
+        int bigEndian, char gapChar, int gapLength )
+{
+    const __m128i bits = lane_bits_128( bigEndian );
+    size_t i = 0;
+
+    for( i = 0; i + 16 <= n; i += 16 )
+    {
+        __m128i x = _mm_loadu_si128( (const __m128i *)( in + i ) );
+        __m128i half[2];
+        int h = 0;
+
+        half[0] = _mm_unpacklo_epi8( x, x );        //  b0 b0 ... b7 b7
+        half[1] = _mm_unpackhi_epi8( x, x );        //  b8 b8 ... b15 b15
+
+        for( h = 0; h < 2; ++h )
+        {
+            __m128i lo = _mm_unpacklo_epi16( half[h], half[h] );
+            __m128i hi = _mm_unpackhi_epi16( half[h], half[h] );
+            __m128i *dest = (__m128i *)( out + i * 8 + h * 64 );
+
+            _mm_storeu_si128( dest + 0, lanes_to_digits_128(
+                        _mm_unpacklo_epi32( lo, lo ), bits ) );
+            _mm_storeu_si128( dest + 1, lanes_to_digits_128(
+                        _mm_unpackhi_epi32( lo, lo ), bits ) );
+            _mm_storeu_si128( dest + 2, lanes_to_digits_128(
+                        _mm_unpacklo_epi32( hi, hi ), bits ) );
+            _mm_storeu_si128( dest + 3, lanes_to_digits_128(
+                        _mm_unpackhi_epi32( hi, hi ), bits ) );
+        }
+    }
+
+    return( i * 8 + expand_table( out + i * 8, in + i, n - i, bigEndian,
+                gapChar, gapLength ) );
+}
+
+
+/*  ------------------  expand_sse2_gapped  ---------------------------
+ *
+ *  the same 16 bytes per step, with each byte's eight digits stored on
+ *  their own so the gap run can go in after them
+ */
+static size_t expand_sse2_gapped( char *out, const unsigned char *in,
+        size_t n, int bigEndian, char gapChar, int gapLength )
+{
+    const __m128i bits = lane_bits_128( bigEndian );
+    uint64_t gap = gap_word( gapChar );
+    size_t stride = 8 + gapLength;
+    size_t i = 0;
+    int k = 0;
+
+    for( i = 0; i + 16 <= n; i += 16 )
+    {
+        __m128i x = _mm_loadu_si128( (const __m128i *)( in + i ) );
+        __m128i quarter[4];
+        char *p = out + i * stride;
+
+        quarter[0] = _mm_unpacklo_epi8( x, x );
+        quarter[2] = _mm_unpackhi_epi8( x, x );
+        quarter[1] = _mm_unpackhi_epi16( quarter[0], quarter[0] );
+        quarter[0] = _mm_unpacklo_epi16( quarter[0], quarter[0] );
+        quarter[3] = _mm_unpackhi_epi16( quarter[2], quarter[2] );
+        quarter[2] = _mm_unpacklo_epi16( quarter[2], quarter[2] );
+
+        /*  Each quarter holds four bytes, four lanes apiece */
+        for( k = 0; k < 4; ++k )
+        {
+            __m128i lo = lanes_to_digits_128(
+                    _mm_unpacklo_epi32( quarter[k], quarter[k] ), bits );
+            __m128i hi = lanes_to_digits_128(
+                    _mm_unpackhi_epi32( quarter[k], quarter[k] ), bits );
+
+            _mm_storel_epi64( (__m128i *)p, lo );
+            memcpy( p + 8, &gap, 8 );
+            _mm_storel_epi64( (__m128i *)( p + stride ),
+                    _mm_unpackhi_epi64( lo, lo ) );
+            memcpy( p + stride + 8, &gap, 8 );
+            _mm_storel_epi64( (__m128i *)( p + 2 * stride ), hi );
+            memcpy( p + 2 * stride + 8, &gap, 8 );
+            _mm_storel_epi64( (__m128i *)( p + 3 * stride ),
+                    _mm_unpackhi_epi64( hi, hi ) );
+            memcpy( p + 3 * stride + 8, &gap, 8 );
+            p += 4 * stride;
+        }
+    }
+
+    return( i * stride + expand_table( out + i * stride, in + i, n - i,
+                bigEndian, gapChar, gapLength ) );
+}
+
+
+/*  ------------------  expand_avx2 ---------------------------
+ *
+ *  32 input bytes per step, 256 characters out; no gaps.  Each 32-byte
+ *  register takes four input bytes, spread eight lanes apiece by a shuffle.
+ */
+__attribute__((target("avx2")))
+static size_t expand_avx2( char *out, const unsigned char *in, size_t n,
+        int bigEndian, char gapChar, int gapLength )
+{
+    const __m256i spread = _mm256_setr_epi8(
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+            2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3 );
+    const __m256i bits = _mm256_broadcastsi128_si256(
+            lane_bits_128( bigEndian ) );
+    const __m256i zero = _mm256_set1_epi8( '0' );
+    size_t i = 0;
+    int k = 0;
+
+    for( i = 0; i + 32 <= n; i += 32 )
+    {
+        for( k = 0; k < 8; ++k )
+        {
+            uint32_t four;
+            memcpy( &four, in + i + k * 4, 4 );
+
+            __m256i v = _mm256_shuffle_epi8( _mm256_set1_epi32( (int)four ),
+                    spread );
+            __m256i set = _mm256_cmpeq_epi8( _mm256_and_si256( v, bits ),
+                    bits );
+
+            _mm256_storeu_si256( (__m256i *)( out + i * 8 + k * 32 ),
+                    _mm256_sub_epi8( zero, set ) );
+        }
+    }
+
+    return( i * 8 + expand_sse2( out + i * 8, in + i, n - i, bigEndian,
+                gapChar, gapLength ) );
+}
+
+
+#endif
+
+
+/*  ------------------  kernel selection    ---------------------------
+ *
+ *  done once, before main, so every later call is a plain indirect call
+ */
+typedef size_t (*expand_kernel)( char *, const unsigned char *, size_t,
+        int, char, int );
+
+static expand_kernel plainKernel = expand_table;
+static expand_kernel gappedKernel = expand_table;
+
+__attribute__((constructor))
+static void select_kernels( void )
+{
+#ifdef HAVE_X86_KERNELS
+    const char *limit = getenv( "DEC2BIN_KERNEL" );
+
+    if( limit != NULL && strcmp( limit, "scalar" ) == 0 )
+        return;
+
+    __builtin_cpu_init();
+
+    plainKernel = expand_sse2;
+    gappedKernel = expand_sse2_gapped;
+    if( limit != NULL && strcmp( limit, "sse2" ) == 0 )
+        return;
+
+    if( __builtin_cpu_supports( "avx2" ) )
+        plainKernel = expand_avx2;
+#endif
+}
+
+
+size_t expand_bits( char *out, const unsigned char *in, size_t n,
+        int bigEndian, char gapChar, int gapLength )
+{
+    if( gapLength == 0 )
+        return( plainKernel( out, in, n, bigEndian, gapChar, 0 ) );
+
+    return( gappedKernel( out, in, n, bigEndian, gapChar, gapLength ) );
+}
+
+
+size_t ascii_run( const unsigned char *in, size_t n )
+{
+    size_t i = 0;
+
+#ifdef HAVE_X86_KERNELS
+    for( i = 0; i + 16 <= n; i += 16 )
+    {
+        int high = _mm_movemask_epi8(
+                _mm_loadu_si128( (const __m128i *)( in + i ) ) );
+
+        if( high != 0 )
+            return( i + __builtin_ctz( high ) );
+    }
+#endif
+
+    while( i < n && in[i] < 0x80 )
+        ++i;
+
+    return( i );
+}
+
@@ -0,0 +1,34 @@
+/*******************************************************************************
+ * bitexpand.h  |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      Bulk byte-to-bit-string expansion for text mode.  Every input byte
+ *      becomes eight '0'/'1' characters, optionally followed by a run of gap
+ *      characters (the spaces of -s or the newline of -l).  SSE2 is the
+ *      baseline on x86-64; an AVX2 kernel is picked at startup when the CPU
+ *      has it, and everything else gets a table-driven kernel.
+ ******************************************************************************/
+#ifndef DEC2BIN_BITEXPAND_H
+#define DEC2BIN_BITEXPAND_H
+
+#include <stddef.h>
+
+/*  Bytes a kernel may scribble past the end of its output */
+#define EXPAND_SLACK 32
+
+/*  Longest gap the kernels handle */
+#define EXPAND_MAX_GAP 8
+
+
+/*
+ *  Expand [n] bytes from [in] into [out], which needs room for
+ *  n * (8 + gapLength) + EXPAND_SLACK bytes.  Returns the bytes written.
+ */
+size_t expand_bits( char *out, const unsigned char *in, size_t n,
+        int bigEndian, char gapChar, int gapLength );
+
+/*  Length of the run of ASCII bytes at the start of [in] */
+size_t ascii_run( const unsigned char *in, size_t n );
+
+#endif
@@ -0,0 +1,393 @@
+/*******************************************************************************
+ * bitstats.c   |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      Bit statistics for --bitstats; see bitstats.h
+ *
+ *  Notes:
+ *      The vector kernels count how often each bit is set the way bitexpand
+ *      spells them out: a number's bytes are copied eight lanes apiece and
+ *      each lane tested for its own bit, which leaves 0xff where the bit is
+ *      set.  Taking that from a byte counter adds one, so 64 counters go up
+ *      a number at a time with no branches; they're added into the totals
+ *      every 255 numbers, before they can wrap.  The total of ones is the
+ *      sum of those counts, so no number needs a popcount of its own.
+ *
+ *      Bit lengths are one LZCNT apiece where the CPU has it.  A run of
+ *      numbers the same length would have every count wait on the one
+ *      before, so each kernel keeps four histograms and takes turns.
+ *
+ *      DEC2BIN_KERNEL=scalar or =sse2 in the environment holds the choice
+ *      of kernel down, as for bitexpand.
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "bitstats.h"
+
+#if defined(__x86_64__)
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+/*  Numbers a byte counter can take before it wraps */
+#define LANE_LIMIT 255
+
+static pthread_mutex_t mergeLock = PTHREAD_MUTEX_INITIALIZER;
+
+
+/*  Bits it takes to write [value]; none for 0 */
+static inline int bit_length( uint64_t value )
+{
+    return( ( value == 0 ) ? 0 : 64 - __builtin_clzll( value ) );
+}
+
+
+/*  Add [hist]'s four histograms of bit lengths into [bits] */
+static void add_lengths( struct bitstats *bits, uint64_t hist[4][65] )
+{
+    int i = 0;
+
+    for( i = 0; i < 65; ++i )
+        bits->lengths[i] += hist[0][i] + hist[1][i] + hist[2][i] + hist[3][i];
+}
+
+
+/*  ------------------  count_scalar    ---------------------------
+ *
+ *  portable kernel: a number at a time, and a bit at a time for the ones
+ *  that are set
+ */
+static void count_scalar( struct bitstats *bits, const uint64_t *values,
+        size_t n )
+{
+    size_t i = 0;
+
+    for( i = 0; i < n; ++i )
+    {
+        uint64_t value = values[i];
+
+        if( value < bits->min )
+            bits->min = value;
+        if( value > bits->max )
+            bits->max = value;
+
+        ++bits->lengths[ bit_length( value ) ];
+        for( ; value != 0; value &= value - 1 )
+            ++bits->positions[ __builtin_ctzll( value ) ];
+    }
+
+    bits->numbers += n;
+}
+
+
+#ifdef HAVE_X86_KERNELS
+
+/*  Per-lane bit to test: lane n of 8 gets bit n of its byte */
+static __m128i lane_bits_128( void )
+{
+    return( _mm_set_epi8( -128, 64, 32, 16, 8, 4, 2, 1,
+                -128, 64, 32, 16, 8, 4, 2, 1 ) );
+}
+
+
+/*  Add 64 byte counters, lane n for bit n, to the totals */
+static void add_lanes( struct bitstats *bits, const unsigned char *lanes )
+{
+    int i = 0;
+
+    for( i = 0; i < 64; ++i )
+        bits->positions[i] += lanes[i];
+}
+
+
+/*  ------------------  count_sse2  ---------------------------
+ *
+ *  set bits counted 64 lanes at a time, in four registers of two bytes
+ *  each; the rest is count_scalar's
+ */
+static void count_sse2( struct bitstats *bits, const uint64_t *values,
+        size_t n )
+{
+    const __m128i laneBits = lane_bits_128();
+    uint64_t hist[4][65];
+    unsigned char lanes[64];
+    size_t i = 0;
+    size_t k = 0;
+
+    memset( hist, 0, sizeof( hist ) );
+
+    for( i = 0; i < n; i += LANE_LIMIT )
+    {
+        size_t end = ( n - i < LANE_LIMIT ) ? n : i + LANE_LIMIT;
+        __m128i counts[4];
+        int r = 0;
+
+        for( r = 0; r < 4; ++r )
+            counts[r] = _mm_setzero_si128();
+
+        for( k = i; k < end; ++k )
+        {
+            uint64_t value = values[k];
+            __m128i x = _mm_loadl_epi64( (const __m128i *)( values + k ) );
+            __m128i pairs = _mm_unpacklo_epi8( x, x );
+            __m128i quads[2];
+            __m128i spread[4];
+
+            if( value < bits->min )
+                bits->min = value;
+            if( value > bits->max )
+                bits->max = value;
+            ++hist[k & 3][ bit_length( value ) ];
+
+            quads[0] = _mm_unpacklo_epi16( pairs, pairs );
+            quads[1] = _mm_unpackhi_epi16( pairs, pairs );
+            spread[0] = _mm_unpacklo_epi32( quads[0], quads[0] );
+            spread[1] = _mm_unpackhi_epi32( quads[0], quads[0] );
+            spread[2] = _mm_unpacklo_epi32( quads[1], quads[1] );
+            spread[3] = _mm_unpackhi_epi32( quads[1], quads[1] );
+
+            for( r = 0; r < 4; ++r )
+                counts[r] = _mm_sub_epi8( counts[r], _mm_cmpeq_epi8(
+                            _mm_and_si128( spread[r], laneBits ),
+                            laneBits ) );
+        }
+
+        for( r = 0; r < 4; ++r )
+            _mm_storeu_si128( (__m128i *)( lanes + r * 16 ), counts[r] );
+        add_lanes( bits, lanes );
+    }
+
+    add_lengths( bits, hist );
+    bits->numbers += n;
+}
+
+
+/*
+ *  The smallest and biggest of [n] numbers, four at a time.  AVX2 only
+ *  compares signed, so the top bit is flipped going in and coming out.
+ */
+__attribute__((target("avx2")))
+static void min_max_avx2( struct bitstats *bits, const uint64_t *values,
+        size_t n )
+{
+    const __m256i flip = _mm256_set1_epi64x( (long long)( 1ULL << 63 ) );
+    __m256i low = _mm256_xor_si256( _mm256_set1_epi64x( bits->min ), flip );
+    __m256i high = _mm256_xor_si256( _mm256_set1_epi64x( bits->max ), flip );
+    uint64_t lows[4];
+    uint64_t highs[4];
+    size_t i = 0;
+    int k = 0;
+
+    for( i = 0; i + 4 <= n; i += 4 )
+    {
+        __m256i x = _mm256_xor_si256( _mm256_loadu_si256(
+                    (const __m256i *)( values + i ) ), flip );
+
+        low = _mm256_blendv_epi8( low, x, _mm256_cmpgt_epi64( low, x ) );
+        high = _mm256_blendv_epi8( high, x, _mm256_cmpgt_epi64( x, high ) );
+    }
+
+    _mm256_storeu_si256( (__m256i *)lows, _mm256_xor_si256( low, flip ) );
+    _mm256_storeu_si256( (__m256i *)highs, _mm256_xor_si256( high, flip ) );
+    for( k = 0; k < 4; ++k )
+    {
+        if( lows[k] < bits->min )
+            bits->min = lows[k];
+        if( highs[k] > bits->max )
+            bits->max = highs[k];
+    }
+
+    for( ; i < n; ++i )
+    {
+        if( values[i] < bits->min )
+            bits->min = values[i];
+        if( values[i] > bits->max )
+            bits->max = values[i];
+    }
+}
+
+
+/*  ------------------  count_avx2  ---------------------------
+ *
+ *  count_sse2 in two registers, each byte spread by one shuffle of the
+ *  number copied to every quarter; LZCNT for the lengths
+ */
+__attribute__((target("avx2,lzcnt")))
+static void count_avx2( struct bitstats *bits, const uint64_t *values,
+        size_t n )
+{
+    const __m256i spreadLow = _mm256_setr_epi8(
+            0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+            2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3 );
+    const __m256i spreadHigh = _mm256_add_epi8( spreadLow,
+            _mm256_set1_epi8( 4 ) );
+    const __m256i laneBits = _mm256_broadcastsi128_si256( lane_bits_128() );
+    uint64_t hist[4][65];
+    unsigned char lanes[64];
+    size_t i = 0;
+    size_t k = 0;
+
+    memset( hist, 0, sizeof( hist ) );
+    min_max_avx2( bits, values, n );
+
+    for( i = 0; i < n; i += LANE_LIMIT )
+    {
+        size_t end = ( n - i < LANE_LIMIT ) ? n : i + LANE_LIMIT;
+        __m256i low = _mm256_setzero_si256();
+        __m256i high = _mm256_setzero_si256();
+
+        for( k = i; k < end; ++k )
+        {
+            __m256i x = _mm256_set1_epi64x( (long long)values[k] );
+            __m256i first = _mm256_shuffle_epi8( x, spreadLow );
+            __m256i last = _mm256_shuffle_epi8( x, spreadHigh );
+
+            ++hist[k & 3][ 64 - _lzcnt_u64( values[k] ) ];
+
+            low = _mm256_sub_epi8( low, _mm256_cmpeq_epi8(
+                        _mm256_and_si256( first, laneBits ), laneBits ) );
+            high = _mm256_sub_epi8( high, _mm256_cmpeq_epi8(
+                        _mm256_and_si256( last, laneBits ), laneBits ) );
+        }
+
+        _mm256_storeu_si256( (__m256i *)lanes, low );
+        _mm256_storeu_si256( (__m256i *)( lanes + 32 ), high );
+        add_lanes( bits, lanes );
+    }
+
+    add_lengths( bits, hist );
+    bits->numbers += n;
+}
+
+#endif
+
+
+/*  ------------------  kernel selection    ---------------------------
+ *
+ *  done once, before main, like bitexpand's
+ */
+typedef void (*count_kernel)( struct bitstats *, const uint64_t *, size_t );
+
+static count_kernel countKernel = count_scalar;
+
+__attribute__((constructor))
+static void select_count_kernel( void )
+{
+#ifdef HAVE_X86_KERNELS
+    const char *limit = getenv( "DEC2BIN_KERNEL" );
+
+    if( limit != NULL && strcmp( limit, "scalar" ) == 0 )
+        return;
+
+    __builtin_cpu_init();
+
+    countKernel = count_sse2;
+    if( limit != NULL && strcmp( limit, "sse2" ) == 0 )
+        return;
+
+    if( __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "lzcnt" ) )
+        countKernel = count_avx2;
+#endif
+}
+
+
+void bitstats_init( struct bitstats *bits )
+{
+    memset( bits, 0, offsetof( struct bitstats, batch ) );
+    bits->min = UINT64_MAX;
+}
+
+
+void bitstats_flush( struct bitstats *bits )
+{
+    if( bits->count == 0 )
+        return;
+
+    countKernel( bits, bits->batch, bits->count );
+    bits->count = 0;
+}
+
+
+void bitstats_merge( struct bitstats *into, struct bitstats *from )
+{
+    int i = 0;
+
+    bitstats_flush( from );
+    pthread_mutex_lock( &mergeLock );
+
+    into->numbers += from->numbers;
+    into->rejected += from->rejected;
+    if( from->min < into->min )
+        into->min = from->min;
+    if( from->max > into->max )
+        into->max = from->max;
+    for( i = 0; i < 65; ++i )
+        into->lengths[i] += from->lengths[i];
+    for( i = 0; i < 64; ++i )
+        into->positions[i] += from->positions[i];
+
+    pthread_mutex_unlock( &mergeLock );
+}
+
+
+/*  printf to [out] */
+__attribute__((format(printf, 2, 3)))
+static void put_line( struct output *out, const char *format, ... )
+{
+    char line[128];
+    va_list args;
+    int length = 0;
+
+    va_start( args, format );
+    length = vsnprintf( line, sizeof( line ), format, args );
+    va_end( args );
+
+    if( length > 0 )
+        output_write( out, line, ( (size_t)length < sizeof( line ) ) ?
+                (size_t)length : sizeof( line ) - 1 );
+}
+
+
+void bitstats_report( struct output *out, struct bitstats *bits )
+{
+    uint64_t ones = 0;
+    int top = 0;
+    int i = 0;
+
+    bitstats_flush( bits );
+
+    put_line( out, "numbers   %20llu\n", (unsigned long long)bits->numbers );
+    put_line( out, "rejected  %20llu\n", (unsigned long long)bits->rejected );
+    if( bits->numbers == 0 )
+        return;
+
+    for( i = 0; i < 64; ++i )
+        ones += bits->positions[i];
+    top = bit_length( bits->max );
+
+    put_line( out, "min       %20llu\n", (unsigned long long)bits->min );
+    put_line( out, "max       %20llu\n", (unsigned long long)bits->max );
+    put_line( out, "ones      %20llu   (%.2f a number)\n",
+            (unsigned long long)ones, (double)ones / bits->numbers );
+
+    /*  Only the lengths some number has */
+    put_line( out, "\n  length               numbers\n" );
+    for( i = 0; i <= 64; ++i )
+        if( bits->lengths[i] > 0 )
+            put_line( out, "  %6d  %20llu\n", i,
+                    (unsigned long long)bits->lengths[i] );
+
+    /*  Every bit up to the biggest number's highest */
+    if( top > 0 )
+        put_line( out, "\n     bit                   set        %%\n" );
+    for( i = 0; i < top; ++i )
+        put_line( out, "  %6d  %20llu  %7.2f\n", i,
+                (unsigned long long)bits->positions[i],
+                100.0 * bits->positions[i] / bits->numbers );
+}
@@ -0,0 +1,56 @@
+/*******************************************************************************
+ * bitstats.h   |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      --bitstats: what the bits of the whole input add up to, with no
+ *      output made for any number.  Numbers are parsed into a batch, and a
+ *      full batch is counted in one go: how many bits each is long, how
+ *      often each bit is set and the smallest and biggest of them.  A
+ *      summary is printed at the end.
+ ******************************************************************************/
+#ifndef DEC2BIN_BITSTATS_H
+#define DEC2BIN_BITSTATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "output.h"
+
+/*  Numbers parsed before they're counted */
+#define BITSTATS_BATCH 4096
+
+struct bitstats
+{
+    uint64_t numbers;           //  Counted so far (batched ones aren't)
+    uint64_t rejected;          //  Tokens that weren't numbers we take
+    uint64_t min;
+    uint64_t max;
+    uint64_t lengths[65];       //  Numbers by bit length (0 has none)
+    uint64_t positions[64];     //  Numbers with bit n set
+    size_t count;               //  Numbers waiting in [batch]
+    uint64_t batch[BITSTATS_BATCH];
+};
+
+
+/*  Zero [bits] */
+void bitstats_init( struct bitstats *bits );
+
+/*  Count the numbers waiting in [bits]' batch */
+void bitstats_flush( struct bitstats *bits );
+
+/*  Add [value] to [bits], counting the batch when it fills up */
+static inline void bitstats_add( struct bitstats *bits, uint64_t value )
+{
+    bits->batch[bits->count++] = value;
+    if( bits->count == BITSTATS_BATCH )
+        bitstats_flush( bits );
+}
+
+/*  Flush [from] and add it to [into]; safe to call from several threads */
+void bitstats_merge( struct bitstats *into, struct bitstats *from );
+
+/*  Flush [bits] and print its summary to [out] */
+void bitstats_report( struct output *out, struct bitstats *bits );
+
+#endif
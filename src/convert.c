@@ -0,0 +1,225 @@
+/*******************************************************************************
+ * convert.c    |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      Integer conversion engine; see convert.h
+ ******************************************************************************/
+#include <string.h>
+
+#include "convert.h"
+
+
+/*
+ *  Every byte value spelled out as eight binary digits, once with the most
+ *  significant bit first and once with it last.  Built by the preprocessor so
+ *  the tables are read-only and need no initialisation.
+ */
+#define BIG_BITS(n) { \
+    '0' + (((n) >> 7) & 1), '0' + (((n) >> 6) & 1), \
+    '0' + (((n) >> 5) & 1), '0' + (((n) >> 4) & 1), \
+    '0' + (((n) >> 3) & 1), '0' + (((n) >> 2) & 1), \
+    '0' + (((n) >> 1) & 1), '0' + ((n) & 1) }
+
+#define LITTLE_BITS(n) { \
+    '0' + ((n) & 1), '0' + (((n) >> 1) & 1), \
+    '0' + (((n) >> 2) & 1), '0' + (((n) >> 3) & 1), \
+    '0' + (((n) >> 4) & 1), '0' + (((n) >> 5) & 1), \
+    '0' + (((n) >> 6) & 1), '0' + (((n) >> 7) & 1) }
+
+#define ROW2(f, n)  f(n), f((n) + 1)
+#define ROW4(f, n)  ROW2(f, n), ROW2(f, (n) + 2)
+#define ROW8(f, n)  ROW4(f, n), ROW4(f, (n) + 4)
+#define ROW16(f, n) ROW8(f, n), ROW8(f, (n) + 8)
+#define ROW32(f, n) ROW16(f, n), ROW16(f, (n) + 16)
+#define ROW64(f, n) ROW32(f, n), ROW32(f, (n) + 32)
+#define ROW128(f, n) ROW64(f, n), ROW64(f, (n) + 64)
+#define ROW256(f)   ROW64(f, 0), ROW64(f, 64), ROW64(f, 128), ROW64(f, 192)
+#define ROW512(f)   ROW128(f, 0), ROW128(f, 128), ROW128(f, 256), \
+                    ROW128(f, 384)
+
+const char bigEndianBits[256][8] = { ROW256(BIG_BITS) };
+const char littleEndianBits[256][8] = { ROW256(LITTLE_BITS) };
+
+/*  Every byte as two hex digits, in small letters and in capitals */
+#define NIBBLE(n, a)    ( ( (n) < 10 ) ? '0' + (n) : (a) + (n) - 10 )
+#define HEX_PAIR(n)     { NIBBLE((n) >> 4, 'a'), NIBBLE((n) & 15, 'a') }
+#define HEX_PAIR_CAPS(n) { NIBBLE((n) >> 4, 'A'), NIBBLE((n) & 15, 'A') }
+
+const char hexPairs[2][256][2] = {
+    { ROW256(HEX_PAIR) },
+    { ROW256(HEX_PAIR_CAPS) } };
+
+/*  Every nine bits as three octal digits */
+#define OCTAL_TRIPLET(n) { \
+    '0' + (((n) >> 6) & 7), '0' + (((n) >> 3) & 7), '0' + ((n) & 7) }
+
+const char octalTriplets[512][3] = { ROW512(OCTAL_TRIPLET) };
+
+/*  00 through 99 */
+#define DECIMAL_PAIR(n) { '0' + (n) / 10, '0' + (n) % 10 }
+
+const char decimalPairs[100][2] = {
+    ROW64(DECIMAL_PAIR, 0), ROW32(DECIMAL_PAIR, 64),
+    ROW4(DECIMAL_PAIR, 96) };
+
+
+/*  ----------------    bit_length  -----------------------------------
+ *
+ *  number of bits needed to hold [number]
+ */
+int bit_length( uint64_t number )
+{
+    if( number == 0 )
+        return( 0 );
+
+    return( 64 - __builtin_clzll( number ) );
+}
+
+
+/*  ---------------------   u64_to_binary   ---------------------------
+ *
+ *  spell [number] out in binary, eight digits per table lookup
+ */
+int u64_to_binary( char *s, uint64_t number, int width, int bigEndian )
+{
+    char digits[MAX_BINARY_DIGITS];     //  All 64 bits, padded with zeroes
+    int length = width;
+    int bytes = 0;
+    int i = 0;
+
+    if( length <= 0 )
+    {
+        length = bit_length( number );
+        if( length == 0 )
+            length = 1;     //  Zero is still one digit
+    }
+    if( length > MAX_BINARY_DIGITS )
+        length = MAX_BINARY_DIGITS;
+
+    /*  Only the bytes that hold our digits need to be looked up */
+    bytes = ( length + 7 ) / 8;
+
+    if( bigEndian == 1 )
+    {
+        /*  Most significant byte first; our digits end the buffer */
+        for( i = 8 - bytes; i < 8; ++i )
+            memcpy( digits + i * 8,
+                    bigEndianBits[ ( number >> ( 56 - i * 8 ) ) & 0xff ], 8 );
+
+        memcpy( s, digits + MAX_BINARY_DIGITS - length, length );
+    }
+    else
+    {
+        /*  Least significant byte first; our digits start the buffer */
+        for( i = 0; i < bytes; ++i )
+            memcpy( digits + i * 8,
+                    littleEndianBits[ ( number >> ( i * 8 ) ) & 0xff ], 8 );
+
+        memcpy( s, digits, length );
+    }
+
+    return( length );
+}
+
+
+/*
+ *  The digit count for [number] in a radix of [bits] bits per digit, or
+ *  [width] if that's set, capped at [most]
+ */
+static int digit_length( uint64_t number, int bits, int width, int most )
+{
+    int length = width;
+
+    if( length <= 0 )
+    {
+        length = ( bit_length( number ) + bits - 1 ) / bits;
+        if( length == 0 )
+            length = 1;     //  Zero is still one digit
+    }
+    if( length > most )
+        length = most;
+
+    return( length );
+}
+
+
+/*  ---------------------   u64_to_hex  ------------------------------
+ *
+ *  spell [number] out in hexadecimal, most significant nibble first, a byte
+ *  at a time from the right
+ */
+int u64_to_hex( char *s, uint64_t number, int width, int caps )
+{
+    const char (*table)[2] = hexPairs[ caps != 0 ];
+    int length = digit_length( number, 4, width, MAX_HEX_DIGITS );
+    int i = length;
+
+    while( i >= 2 )
+    {
+        i -= 2;
+        memcpy( s + i, table[ number & 0xff ], 2 );
+        number >>= 8;
+    }
+    if( i > 0 )
+        s[0] = table[ number & 0xf ][1];
+
+    return( length );
+}
+
+
+/*  ---------------------   u64_to_octal    ---------------------------
+ *
+ *  spell [number] out in octal, nine bits (three digits) per lookup
+ */
+int u64_to_octal( char *s, uint64_t number, int width )
+{
+    int length = digit_length( number, 3, width, MAX_OCTAL_DIGITS );
+    int i = length;
+
+    while( i >= 3 )
+    {
+        i -= 3;
+        memcpy( s + i, octalTriplets[ number & 0x1ff ], 3 );
+        number >>= 9;
+    }
+    while( i > 0 )
+    {
+        s[--i] = '0' + ( number & 7 );
+        number >>= 3;
+    }
+
+    return( length );
+}
+
+
+/*  ---------------------   u64_to_decimal  --------------------------
+ *
+ *  spell [number] out in decimal, two digits per division
+ */
+int u64_to_decimal( char *s, uint64_t number, int width )
+{
+    uint64_t rest = number;
+    int length = width;
+    int i = 0;
+
+    if( length <= 0 )
+    {
+        for( length = 1; rest >= 10; ++length )
+            rest /= 10;
+    }
+    if( length > MAX_DECIMAL_DIGITS )
+        length = MAX_DECIMAL_DIGITS;
+
+    i = length;
+    while( i >= 2 )
+    {
+        i -= 2;
+        memcpy( s + i, decimalPairs[ number % 100 ], 2 );
+        number /= 100;
+    }
+    if( i > 0 )
+        s[0] = '0' + number % 10;
+
+    return( length );
+}
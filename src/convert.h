@@ -0,0 +1,54 @@
+/*******************************************************************************
+ * convert.h    |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      Integer conversion engine.  Turns unsigned 64-bit integers into strings
+ *      of binary, hex, octal or decimal digits using a count-leading-zeros
+ *      instruction and table lookups (a byte, a pair of nibbles, a triplet of
+ *      octal digits or a pair of decimal digits at a time), with no floating
+ *      point and no printf involved.
+ ******************************************************************************/
+#ifndef DEC2BIN_CONVERT_H
+#define DEC2BIN_CONVERT_H
+
+#include <stdint.h>
+
+#define MAX_BINARY_DIGITS 64
+#define MAX_HEX_DIGITS 16
+#define MAX_OCTAL_DIGITS 22
+#define MAX_DECIMAL_DIGITS 20
+
+/*  Every byte value as eight binary digits, most significant bit first/last */
+extern const char bigEndianBits[256][8];
+extern const char littleEndianBits[256][8];
+
+/*  Every byte as two hex digits, small letters [0] or capitals [1] */
+extern const char hexPairs[2][256][2];
+
+/*  Every nine bits as three octal digits, and 00 through 99 */
+extern const char octalTriplets[512][3];
+extern const char decimalPairs[100][2];
+
+
+/*  Number of significant bits in [number]; 0 has a bit length of 0 */
+int bit_length( uint64_t number );
+
+/*
+ *  Write [number] to [s] as binary digits (no terminating null).  If [width]
+ *  is 0 the string is as short as possible, otherwise it is zero-padded or
+ *  truncated to exactly [width] digits.  Big-endian puts the most significant
+ *  bit first, little-endian puts it last.  Returns the number of digits.
+ */
+int u64_to_binary( char *s, uint64_t number, int width, int bigEndian );
+
+/*  Same idea for hexadecimal, one nibble per digit; [caps] picks A-F */
+int u64_to_hex( char *s, uint64_t number, int width, int caps );
+
+/*  ... for octal, three bits per digit */
+int u64_to_octal( char *s, uint64_t number, int width );
+
+/*  ... and for decimal */
+int u64_to_decimal( char *s, uint64_t number, int width );
+
+#endif
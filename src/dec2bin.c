@@ -1,37 +1,100 @@
 /*******************************************************************************
- * dec2bin.c    |   version 1.5     |   FreeBSD License     |   2017-11-20
+ * dec2bin.c    |   version 1.6     |   FreeBSD License     |   2026-10-17
  * James Hendrie                    |   hendrie.james@gmail.com
  *
  *  Description:
  *      Converts decimal numbers (positive integers) to binary numbers
  *
  *  Limitations:
- *      Can't handle numbers greater than (1e16) - 2
+ *      Numbers past (2^64) - 1 have to be whole numbers (1.5e30 will do, inf
+ *      won't) to be converted at all
  ******************************************************************************/
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <errno.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "libdec2bin.h"
+#include "output.h"
+#include "reader.h"
+#include "pipeline.h"
+#include "stats.h"
+#include "dump.h"
+#include "serve.h"
+#include "uring.h"
+#include "bitstats.h"
+#include "options.h"
 
 #define MAX_STRING_LENGTH 256
-#define VERSION "1.5"
+#define VERSION "1.6"
+#define MAX_WIDTH 64
+
+/*  Bytes of record cache each thread gets from a bare --cache */
+#define CACHE_DEFAULT_SIZE ( 1024 * 1024 )
+
+/*  --ieee numbers parsed before a batch of them is printed */
+#define IEEE_BATCH 512
+
+/*  Highest field -k can name, short of an open range like 3- */
+#define FIELD_LIMIT 64
+
+/*  Longest field that -k will look at as a number */
+#define FIELD_MAX 1024
+
+/*  -k: which fields of a line get converted */
+struct field_set
+{
+    uint64_t mask;              //  Bit n - 1 for field n, up to FIELD_LIMIT
+    size_t openFrom;            //  Every field from this one on (0 for none)
+    size_t last;                //  Highest field in [mask]
+};
 
 
 /*  ------------    Global Options  --------------- */
-int dec2dec;                //  Decimal to decimal 'conversion'
-int dec2bin;                //  Decimal to binary conversion
-int dec2hex;                //  Decimal to hexadecimal conversion
-int hexCaps;                //  Same, with capital letters
-int dec2pHex;               //  Decimal to 'prefice' hexadecimal conversion
-int phexCaps;               //  Same, with capital letters
-int dec2oct;                //  Decimal to octal conversion
+struct d2b_options userOptions;  //  Everything about how we convert
 int textMode;               //  Text to binary conversion
-int totalConversions;       //  Total number of conversion types to perform
-int sections;               //  Whether to use sections / how many to use
-int lineSpacing;            //  Whether to use extra line spacing
-int verbose;                //  Verbosity
-int bigEndian;              //  Big endian (1=yes, default)
+int threads;                //  Worker threads for stdin (0/1 = no pipeline)
+int rawWidth;               //  Bytes per raw input record (0 = text input)
+int rawBigEndian;           //  Raw records are big endian
+int rawLeftover;            //  Raw input ended partway through a record
+int tooWide;                //  A number needed more bits than --width
+int inputFd;                //  Where 'stdin' input really comes from
+struct uring_reader *inputRing; //  ... read ahead on io_uring, if set
+int outputFile;             //  Output goes to a file (-O), not stdout
+int statsMode;              //  --stats: 0 off, 1 text, 2 JSON
+int reverseMode;            //  Binary, hex or octal back to decimal
+int reverseRadix;           //  ... which of those (a D2B_RADIX_ value)
+int reverseLines;           //  ... one record per line (for -s and -v output)
+const char *dumpPath;       //  -f: dump this file's bits instead
+int rangeMode;              //  --range: the arguments are START END [STEP]
+d2b_typed_kernel typedKernel;   //  --type: converts every number, if set
+const char *typeName;       //  ... and the name of its type, for errors
+int ieeeFormat;             //  --ieee: a D2B_IEEE_ format, or 0 for none
+size_t cacheSize;           //  --cache: bytes of records per thread, or 0
+const char *serveSocket;    //  --serve: stay up answering clients here
+int fieldMode;              //  -k: convert fields of lines, pass the rest
+struct field_set fieldSet;  //  ... these fields
+int fieldDelimiter;         //  -F: ... split on this (-1 until given)
+int uringMode;              //  --uring: -i and -O files go through io_uring
+int groupMode;              //  --group or --sep was given
+int bitstatsMode;           //  --bitstats: count bits, print no records
+
+/*  Each thread's --cache, and the key that frees it when the thread ends */
+static __thread struct d2b_cache *threadCache;
+static pthread_key_t cacheKey;
+static pthread_once_t cacheOnce = PTHREAD_ONCE_INIT;
+
+struct output stdOutput;    //  Buffered writer for everything on stdout
+struct stats runStats;      //  What --stats reports
+uint64_t startNanos;        //  When we started, for the wall time
+struct bitstats runBits;    //  What --bitstats reports
 
 /*  Optstring
  *      v   verbosity
@@ -45,11 +108,18 @@ int bigEndian;              //  Big endian (1=yes, default)
  *      e   little endian
  *      E   big endian (default)
  *      t   turns on 'text mode' conversion
- *      s   sections; optarg is number of chars between spaces.  Default is 0
+ *      s   sections; groups of 4 digits (or --group's), space-separated
  *      l   line spacing; lots of output separates results with an extra line
+ *      j   threads; optarg is how many workers convert stdin in parallel
+ *      i   input file; optarg is read instead of stdin
+ *      O   output file; optarg is written instead of stdout
+ *      f   file dump; optarg has all its bytes printed as bits, like xxd -b
+ *      r   reverse mode; read binary (or -x, -X, -o) numbers, print decimal
+ *      F   field delimiter; optarg is the character -k fields are split on
+ *      k   fields; optarg lists the fields of each line to convert
  *      h   help
  */
-static const char *optString = "vdbxXaAoslhteE";
+static const char *optString = "vdbxXaAoslhteErj:i:O:f:F:k:";
 
 
 
@@ -89,6 +159,8 @@ void print_help( FILE *fp )
     fprintf(fp, "\nOptions:\n");
     fprintf(fp, "  -h or --help\tPrint this help text\n");
     fprintf(fp, "  --version\tPrint version and author info\n");
+    fprintf(fp, "  --buffer-size=N\n\t\tCollect N bytes of output per write ");
+    fprintf(fp, "(K, M, G suffixes;\n\t\tdefault 1M)\n");
     fprintf(fp, "  -\t\tRead from stdin (absence of args will also work)\n");
     fprintf(fp, "  -v\t\tPrint number type before number (verbosity)\n");
     fprintf(fp, "  -b\t\tPrint binary (default)\n");
@@ -102,9 +174,57 @@ void print_help( FILE *fp )
     fprintf(fp, "  -E\t\tPrint binary numbers as big-endian (default)\n" );
     fprintf(fp, "  -t\t\tSwitch on 'text conversion' mode\n");
     fprintf(fp, "  -l\t\tPrint a line between sections of output\n");
+    fprintf(fp, "  -r\t\tReverse: read binary numbers (hex with -x or -X, ");
+    fprintf(fp, "octal with -o)\n\t\tand print them in decimal\n");
+    fprintf(fp, "  -j N\t\tConvert stdin with N worker threads\n");
+    fprintf(fp, "  -i FILE\tRead FILE instead of stdin\n");
+    fprintf(fp, "  -O FILE\tWrite to FILE instead of stdout\n");
+    fprintf(fp, "  -f FILE\tDump every byte of FILE as bits, 6 to a row ");
+    fprintf(fp, "(with -v,\n\t\toffsets and characters too, like xxd -b; ");
+    fprintf(fp, "with -s, a\n\t\tspace between bytes)\n");
+    fprintf(fp, "  -k FIELDS\tConvert only these fields of each line ");
+    fprintf(fp, "(like 2 or 1,3-5\n\t\tor 4-) and pass the rest ");
+    fprintf(fp, "through as it is\n");
+    fprintf(fp, "  -F DELIM\tSplit -k fields on DELIM, one character ");
+    fprintf(fp, "(default tab)\n");
+    fprintf(fp, "  --uring\tRead -i and write -O files through io_uring, ");
+    fprintf(fp, "several\n\t\tblocks at a time, while converting\n");
+    fprintf(fp, "  --width=N\tPrint every number as N bits (1 to 64), ");
+    fprintf(fp, "zero-padded, so\n\t\tall records are the same length; ");
+    fprintf(fp, "a bigger number is an\n\t\terror\n");
+    fprintf(fp, "  --raw=FORMAT\n\t\tRead binary records instead of text: ");
+    fprintf(fp, "u32le, u32be, u64le\n\t\tor u64be (unsigned, 32 or 64 ");
+    fprintf(fp, "bits, little or big endian)\n");
+    fprintf(fp, "  --type=TYPE\tPrint every number as TYPE: i8, u8, i16, ");
+    fprintf(fp, "u16, i32, u32,\n\t\ti64, u64, i128 or u128 (two's ");
+    fprintf(fp, "complement, all bits)\n");
+    fprintf(fp, "  --ieee=FORMAT\tPrint the bits of every number as an ");
+    fprintf(fp, "f16, f32 or f64\n\t\tfloat (with -s, as sign, exponent ");
+    fprintf(fp, "and mantissa)\n");
+    fprintf(fp, "  --format=LAYOUT\n\t\tOne line per number, a column ");
+    fprintf(fp, "per output type: tsv,\n\t\tcsv or ndjson\n");
+    fprintf(fp, "  --range START END [STEP]\n\t\tConvert every STEPth ");
+    fprintf(fp, "number from START to END\n");
+    fprintf(fp, "  --cache[=SIZE]\tKeep up to SIZE bytes of records (1M if ");
+    fprintf(fp, "not given) per\n\t\tthread, for input that repeats ");
+    fprintf(fp, "itself\n");
+    fprintf(fp, "  --serve SOCKET\tStay running and convert for --client ");
+    fprintf(fp, "runs on the Unix\n\t\tsocket SOCKET\n");
+    fprintf(fp, "  --client SOCKET\n\t\tHave the --serve at SOCKET do ");
+    fprintf(fp, "the converting (with\n\t\t--stats, report the time per ");
+    fprintf(fp, "request instead)\n");
+    fprintf(fp, "  --stats[=json]\n\t\tPrint where the time went to stderr ");
+    fprintf(fp, "when done, as a\n\t\ttable or as JSON\n");
+    fprintf(fp, "  --bitstats\tPrint no numbers, only a summary of their ");
+    fprintf(fp, "bits: lengths,\n\t\tset bits per position, ones, ");
+    fprintf(fp, "smallest and biggest\n");
     fprintf(fp, "  -s\t\tPrint in 4-character sections, space-separated\n");
     fprintf(fp, "\t\t(in text conversion mode, this will instead print 4");
     fprintf(fp, " spaces \n\t\tbetween each converted character)\n");
+    fprintf(fp, "  --group=N\tPrint in sections of N digits (1 to 64) ");
+    fprintf(fp, "instead of 4\n");
+    fprintf(fp, "  --sep=STR\tPut STR (1 to 4 bytes) between sections ");
+    fprintf(fp, "instead of a\n\t\tspace\n");
 }
 
 
@@ -115,466 +235,1694 @@ void print_version(void)
 }
 
 
-/*  ---------------------   power_of    --------------------------------
+/*  ----------------------  parse_size  ----------------------------------
  *
- *  multiply [multiple] to the power of [power]
+ *  read a byte count like 65536, 64K, 8M or 1G into [size].  Returns 1 if
+ *  [string] isn't one.
  */
-double power_of( double multiple, int power )
+int parse_size( const char *string, size_t *size )
 {
-    /*  If we're multiplying to the power of zero */
-    if( power == 0 )
-        return(1);
+    char *end = NULL;
+    unsigned long long value = 0;
+    int shifts = 0;
+
+    if( ! isdigit( (unsigned char)*string ) )
+        return( 1 );
+
+    errno = 0;
+    value = strtoull( string, &end, 10 );
+    if( errno == ERANGE || value > SIZE_MAX )
+        return( 1 );
+
+    switch( toupper( (unsigned char)*end ) )
+    {
+        case 'G':   ++shifts;   //  Fall through
+        case 'M':   ++shifts;   //  Fall through
+        case 'K':   ++shifts;   ++end;  break;
+        default:    break;
+    }
 
-    double current = multiple;
+    if( *end != '\0' )
+        return( 1 );
 
-    /*  For loop; make my number, GROW!!!! */
-    int temp = 0;
-    for( temp = 1; temp < power; ++temp )
-        current *= multiple;
+    /*  A size that doesn't fit is no good, not whatever it wraps around to */
+    for( ; shifts > 0; --shifts )
+    {
+        if( value > ( SIZE_MAX >> 10 ) )
+            return( 1 );
+        value <<= 10;
+    }
 
-    /*  Return finished number */
-    return( current );
+    *size = (size_t)value;
+    return( 0 );
 }
 
 
-/*  ----------------    get_array_size  -----------------------------------
+/*  ----------------------  parse_raw_format  ----------------------------
  *
- *  we get the number of bits used for our binary number
+ *  set rawWidth and rawBigEndian from a --raw name like u32le.  Returns 1 if
+ *  [name] isn't one we know.
  */
-int get_array_size( double *userNumber )
+int parse_raw_format( const char *name )
 {
-    int arraySize = 0;          //  Size of our character array
-    double temp = *userNumber;  //  We use this so that we don't kill userNumber
-
-    while( (int)temp != 0 )     //  Make sure to cast as an int
+    static const struct
+    {
+        const char *name;
+        int width;
+        int bigEndian;
+    } formats[] = {
+        { "u32le", 4, 0 },
+        { "u32be", 4, 1 },
+        { "u64le", 8, 0 },
+        { "u64be", 8, 1 }
+    };
+    size_t i = 0;
+
+    for( i = 0; i < sizeof( formats ) / sizeof( formats[0] ); ++i )
     {
-        temp = temp / 2;
-        ++arraySize;
+        if( strcmp( name, formats[i].name ) == 0 )
+        {
+            rawWidth = formats[i].width;
+            rawBigEndian = formats[i].bigEndian;
+            return(0);
+        }
     }
 
-    return( arraySize );
+    return(1);
+}
+
+
+/*  Set typedKernel and typeName from a --type name; 1 if [name] isn't one */
+int parse_type( const char *name )
+{
+    int type = d2b_type_named( name );
+
+    if( type == 0 )
+        return(1);
+
+    typedKernel = d2b_typed( type );
+    typeName = name;
+    return(0);
+}
+
+
+/*  Set ieeeFormat from an --ieee name; returns 1 if [name] isn't one */
+int parse_ieee( const char *name )
+{
+    ieeeFormat = d2b_ieee_named( name );
+
+    return( ieeeFormat == 0 );
+}
+
+
+/*  Set the layout from a --format name; returns 1 if [name] isn't one */
+int parse_layout( const char *name )
+{
+    int layout = d2b_layout_named( name );
+
+    if( layout < 0 )
+        return(1);
+
+    userOptions.layout = layout;
+    return(0);
 }
 
 
-/*  ----------------------  print_number_string ----------------------------
+/*  ----------------------  parse_bound  ---------------------------------
  *
- *  print a number string, formatted as necessary
+ *  read a --range number, which has to be a plain integer that fits in 64
+ *  bits.  Returns 1 if [string] isn't one.
  */
-void print_number_string( char *s, int arraySize )
+int parse_bound( const char *string, uint64_t *value )
 {
-    int i = 0;
-    int spaces = 0;
+    double real = 0;
+
+    if( string[0] == '\0' || string[ strspn( string, "0123456789" ) ] != '\0' )
+        return(1);
+
+    return( d2b_parse( string, value, &real ) != D2B_NUMBER );
+}
+
+
+/*  ----------------------  parse_fields  --------------------------------
+ *
+ *  set fieldSet from a -k list like 2, 1,3-5 or 4- (fields count from 1).
+ *  Returns 1 if [list] isn't one.
+ */
+int parse_fields( const char *list )
+{
+    const char *p = list;
 
-    /*  If we're printing in sections */
-    if( sections != 0 )
+    memset( &fieldSet, 0, sizeof( fieldSet ) );
+
+    while( *p != '\0' )
     {
-        /*  Pad with as many zeroes as we need to get sections of 4 chars */
-        for( i = 0; i < 4 - ( arraySize % 4); ++i )
+        char *end = NULL;
+        unsigned long from = 0;
+        unsigned long to = 0;
+
+        if( ! isdigit( (unsigned char)*p ) )
+            return(1);
+        from = to = strtoul( p, &end, 10 );
+        if( from == 0 )
+            return(1);
+
+        if( *end == '-' && ( end[1] == ',' || end[1] == '\0' ) )
         {
-            putchar('0');
-            ++spaces;
+            /*  An open range: this field and every one after it */
+            if( fieldSet.openFrom == 0 || from < fieldSet.openFrom )
+                fieldSet.openFrom = from;
+            ++end;
         }
-        /*  When we hit our 'sections' limit, print a space */
-        for( i = 0; i < arraySize; ++i )
+        else
         {
-            if( spaces == 4 )
+            if( *end == '-' )
             {
-                putchar(' ');
-                spaces = 0;
+                if( ! isdigit( (unsigned char)end[1] ) )
+                    return(1);
+                to = strtoul( end + 1, &end, 10 );
             }
+            if( to < from || to > FIELD_LIMIT )
+                return(1);
 
-            putchar(s[i]);
-            ++spaces;
+            for( ; from <= to; ++from )
+                fieldSet.mask |= 1ULL << ( from - 1 );
+            if( to > fieldSet.last )
+                fieldSet.last = to;
         }
 
-        printf("\n");   //  Print a newline at the end for readability
+        p = end;
+        if( *p == ',' && p[1] != '\0' )
+            ++p;
+        else if( *p != '\0' )
+            return(1);
     }
+
+    return( fieldSet.mask == 0 && fieldSet.openFrom == 0 );
+}
+
+
+/*  Set fieldDelimiter from -F's one character (or \t); 1 if it isn't one */
+int parse_delimiter( const char *delimiter )
+{
+    if( strcmp( delimiter, "\\t" ) == 0 )
+        fieldDelimiter = '\t';
+    else if( delimiter[0] != '\0' && delimiter[1] == '\0' &&
+            delimiter[0] != '\n' )
+        fieldDelimiter = (unsigned char)delimiter[0];
     else
-    {
-        /*  Print our damn number string dammit!!!!!!!!!!!! ARRRARAGH */
-        for( i = 0; i < arraySize ; ++i)
-        {
-            putchar(s[i]);
-        }
+        return(1);
 
-        printf("\n");
-    }
+    return(0);
+}
 
+
+/*  Frees a thread's --cache when it ends */
+void free_cache( void *cache )
+{
+    d2b_cache_free( cache );
 }
 
 
+void make_cache_key( void )
+{
+    pthread_key_create( &cacheKey, free_cache );
+}
 
 
-/*  ---------------------   create_binary_string     -----------------------
+/*  ----------------------  thread_cache  --------------------------------
  *
- *  takes decimal value [userNumber] and creates a string of binary numbers
- *  that equal it; after this, we send that string to the print_number_string
- *  function
+ *  the calling thread's record cache, made on first use, or NULL without
+ *  --cache (or without the memory for one)
  */
-char* create_binary_string( char *s, int arraySize, double *userNumber )
+struct d2b_cache *thread_cache( const struct d2b_options *options )
 {
-    memset( s, '\0', arraySize);
+    if( threadCache == NULL && cacheSize > 0 )
+    {
+        pthread_once( &cacheOnce, make_cache_key );
+        threadCache = d2b_cache_new( options, cacheSize );
+        pthread_setspecific( cacheKey, threadCache );
+    }
+
+    return( threadCache );
+}
 
-    int i = 0;                      //  Index in the string
-    int multiple = arraySize - 1;   //  We'll use this for multiplication
 
-    /*
-     * Go through the string and, where appropriate, add a 1 or 0
-     */
+/*  Add this thread's --cache hits and misses to [stats] */
+void cache_counts( struct stats *stats )
+{
+    uint64_t hits = 0;
+    uint64_t misses = 0;
 
-    //  If we're going big-endian
-    if( bigEndian == 1 )
+    if( threadCache != NULL )
     {
-        for( i = 0; i < arraySize+1; ++i )
-        {
-            /*  If our result is too high, we go further to the right */
-            if( power_of( 2.0f, multiple) > *userNumber ) { s[i] = '0'; } 
+        d2b_cache_counts( threadCache, &hits, &misses );
+        stats->cacheHits += hits;
+        stats->cacheMisses += misses;
+    }
+}
 
-            /*  Otherwise, we fill in the 'blanks' with 1s */
-            else { s[i] = '1'; *userNumber -= power_of( 2.0f, multiple ); }
 
-            --multiple;     //  Move to the right
-        }
-    }
+/*  Registered with atexit so that every way out sends the last of our output */
+void flush_stdout(void)
+{
+    output_flush( &stdOutput );
+}
 
-    //  Otherwise, if little-endian
-    else
-    {
-        for( i = ( arraySize - 1 ); i >= 0; --i )
-        {
-            /*  If our result is too high, we go further to the right */
-            if( power_of( 2.0f, multiple) > *userNumber ) { s[i] = '0'; }
 
-            /*  Otherwise, we fill in the 'blanks' with 1s */
-            else { s[i] = '1'; *userNumber -= power_of( 2.0f, multiple ); } 
+/*  Registered with atexit for --stats, before flush_stdout so it runs after */
+void report_stats(void)
+{
+    cache_counts( &runStats );
+    runStats.bytesOut += stdOutput.written;
+    runStats.nanos[STAGE_WRITE] += stdOutput.writeNanos;
+
+    stats_report( stderr, &runStats, monotonic_ns() - startNanos,
+            ( statsMode == 2 ) );
+}
 
-            --multiple;     //  Move to the right
-        }
-    }
 
-    /*
-     * Here I trim the string of leading zeroes, as I'm too lazy to fix the
-     * program so that there are no leading zeroes to begin with
-     */
-    if( *userNumber != 0 )      //  Make sure user didn't actually give us a 0
+/*
+ *  With a fixed width, a number we couldn't convert still gets a record (of
+ *  spaces), so that record n is still at the same place in the output
+ */
+void blank_record( struct output *out, const struct d2b_options *options )
+{
+    size_t size = d2b_record_size( options );
+
+    if( size > 0 )
     {
-        while( s[0] == '0' ) { ++s; }
+        char *p = output_reserve( out, size );
+
+        memset( p, ' ', size - 1 );
+        p[size - 1] = '\n';
+        output_commit( out, size );
     }
+}
 
-    /*  Send to print_number_string function */
-    return( s );
+
+/*  [string] needs more bits than --width gives it: refuse it, as above */
+int too_wide( struct output *out, const struct d2b_options *options,
+        const char *string, struct stats *stats )
+{
+    fprintf(stderr, "ERROR:  '%s' doesn't fit in %d bits\n", string,
+            options->width );
+    blank_record( out, options );
+    tooWide = 1;
+
+    if( stats != NULL )
+        ++stats->rejected;
+    return(1);
 }
 
 
+/*  Room the input column needs for [string]; none without --format */
+size_t input_room( const struct d2b_options *options, const char *string )
+{
+    if( options->layout == D2B_LAYOUT_LINES )
+        return( 0 );
+
+    return( d2b_input_max( strlen( string ) ) );
+}
+
 
-/*  Print a string from a number passed to it */
-int string_printer( double *userNumber )
+/*  With --format, start the record at [p] with [string], the number read */
+size_t put_input( const struct d2b_options *options, const char *string,
+        char *p )
 {
+    if( options->layout == D2B_LAYOUT_LINES )
+        return( 0 );
 
-    /*  Determines array size for our string */
-    int arraySize = get_array_size( userNumber );
+    return( d2b_format_input( options, string, strlen( string ), 0, p ) );
+}
 
-    /*  Make sure we have an array size to work with */
-    if( arraySize < 1 )
-    {
-        if( *userNumber < 0 )
-        {
-            printf("What is this, a joke!?\n");
-            return(1);
-        }
 
-        else if( *userNumber == 0 )
-            arraySize = 1;
-    }
+/*  --stats: a record parsed at [parsed] after starting at [start] is done */
+void record_done( struct stats *stats, uint64_t start, uint64_t parsed )
+{
+    uint64_t now = monotonic_ns();
+
+    stats->nanos[STAGE_FORMAT] += now - parsed;
+    stats_latency( stats, now - start );
+}
+
 
-    /*
-     * Create a string pointer, and then allocate a number of bytes to it
-     * according to the value given by the previous function
-     */
-    char *s = malloc( arraySize );
-    if( s == NULL )
+/*  ----------------------  typed_token  ----------------------------------
+ *
+ *  convert_token for --type: the kernel parses and formats in one go, so
+ *  with [stats] all of it counts as formatting
+ */
+int typed_token( struct output *out, const struct d2b_options *options,
+        const char *string, struct stats *stats )
+{
+    uint64_t start = ( stats != NULL ) ? monotonic_ns() : 0;
+    size_t length = 0;
+    char *p = output_reserve( out, D2B_RECORD_MAX +
+            input_room( options, string ) );
+    size_t skip = put_input( options, string, p );
+    int kind = typedKernel( options, string, p + skip, &length );
+
+    if( kind != D2B_NUMBER )
     {
-        mem_error("Main:  Allocating memory to string buffer");
+        if( kind == D2B_RANGE )
+            fprintf(stderr, "ERROR:  '%s' doesn't fit in %s\n", string,
+                    typeName );
+        else
+            fprintf(stderr, "ERROR:  '%s' is not a whole number\n", string );
+
+        if( stats != NULL )
+            ++stats->rejected;
         return(1);
     }
 
+    output_commit( out, skip + length );
 
-    if( dec2dec == 1 )      //  Decimal output (for whatever reason)
-    {
-        if( verbose == 1 )
-            printf("DEC\t");
+    if( stats != NULL )
+        record_done( stats, start, start );
 
-        sprintf( s, "%s%d", s, (unsigned int)*userNumber );
-        print_number_string( s, strlen(s) );
-        memset( s, '\0', arraySize + 1 );   //  Clean up string
-    }
+    return(0);
+}
 
-    if( dec2hex == 1 )      //  Regular hex (non-capital)
-    {
-        if( verbose == 1 )
-            printf("HEX\t");
 
-        sprintf( s, "%s%x", s, (unsigned int)*userNumber);
-        print_number_string( s, strlen(s) );
-        memset( s, '\0', arraySize + 1 );   //  Clean up string
+/*  --ieee numbers waiting to be rounded and printed all together */
+struct ieee_batch
+{
+    double values[IEEE_BATCH];
+    uint64_t bits[IEEE_BATCH];
+    size_t count;
+    size_t limit;               //  1 when someone is typing them in
+    const char *inputs[IEEE_BATCH];     //  With --format, the numbers as
+    size_t inputLengths[IEEE_BATCH];    //  given, kept in [text]
+    char text[IEEE_BATCH * 32];
+    size_t used;
+};
+
+
+/*  ----------------------  ieee_flush  ----------------------------------
+ *
+ *  print every number in [batch] and empty it.  [pCount] counts the records
+ *  printed, for -l.
+ */
+void ieee_flush( struct output *out, const struct d2b_options *options,
+        struct ieee_batch *batch, size_t *pCount, struct stats *stats )
+{
+    uint64_t start = ( stats != NULL ) ? monotonic_ns() : 0;
+    size_t i = 0;
 
-    }
+    d2b_ieee_bits( ieeeFormat, batch->values, batch->bits, batch->count );
 
-    if( hexCaps == 1 )      //  Regular hex (captial letters)
+    for( i = 0; i < batch->count; ++i )
     {
-        if( verbose == 1 )
-            printf("HEX\t");
-
-        sprintf( s,"%s%X", s, (unsigned int)*userNumber);
-        print_number_string( s, strlen(s) );
-        memset( s, '\0', arraySize+1 );   //  Clean up string
+        int columns = ( options->layout != D2B_LAYOUT_LINES );
+        char *p = output_reserve( out, D2B_RECORD_MAX + 1 + ( columns ?
+                    d2b_input_max( batch->inputLengths[i] ) : 0 ) );
+        size_t skip = ( options->lineSpacing == 1 && *pCount > 0 );
+
+        if( skip == 1 )
+            *p = '\n';
+        if( columns )
+            skip += d2b_format_input( options, batch->inputs[i],
+                    batch->inputLengths[i], 0, p + skip );
+        output_commit( out, skip + d2b_format_ieee( options, ieeeFormat,
+                    batch->bits[i], p + skip ) );
+        ++*pCount;
     }
 
-    if( dec2pHex == 1 )     //  SUPER HEX (non-caps)
+    if( stats != NULL )
     {
-        if( verbose == 1 )
-            printf("0xHEX\t");
-
-        sprintf( s, "%s%a", s, *userNumber );
-        print_number_string( s, strlen(s) );
-        memset( s, '\0', arraySize + 1 );
+        stats->nanos[STAGE_FORMAT] += monotonic_ns() - start;
+        stats->records += batch->count;
     }
 
-    if( phexCaps == 1 )     //  SUPER HEX (caps)
-    {
-        if( verbose == 1 )
-            printf("0xHEX\t");
+    batch->count = 0;
+    batch->used = 0;
+}
 
-        sprintf( s, "%s%A", s, *userNumber );
-        print_number_string( s, strlen(s) );
-        memset( s, '\0', arraySize + 1 );
-    }
 
-    if( dec2oct == 1 )  //  Octal
-    {
-        if( verbose == 1 )
-            printf("OCT\t");
+/*  ----------------------  ieee_token  ----------------------------------
+ *
+ *  --ieee: read the number in [string] into [batch], printing the batch
+ *  once it's full.  Returns 1 if [string] isn't a number.
+ */
+int ieee_token( struct output *out, const struct d2b_options *options,
+        struct ieee_batch *batch, const char *string, size_t *pCount,
+        struct stats *stats )
+{
+    uint64_t start = ( stats != NULL ) ? monotonic_ns() : 0;
+    double value = 0;
 
-        sprintf( s, "%s%o", s, (unsigned int)*userNumber );
-        print_number_string( s, strlen(s) );
-        memset( s, '\0', arraySize + 1 );
+    if( d2b_parse_real( string, &value ) != D2B_NUMBER )
+    {
+        fprintf(stderr, "ERROR:  '%s' is not a number\n", string );
+        if( stats != NULL )
+            ++stats->rejected;
+        return(1);
     }
 
+    if( stats != NULL )
+        stats->nanos[STAGE_PARSE] += monotonic_ns() - start;
 
-    /*  We bail if dec2bin is 0 */
-    if( dec2bin == 0 )
-        return(0);
-
+    /*  The token won't last until the batch is printed, so keep a copy */
+    if( options->layout != D2B_LAYOUT_LINES )
+    {
+        size_t length = strlen( string );
 
-    /*  If verbose, print BIN */
-    if( verbose == 1 )
-        printf("BIN\t");
+        if( batch->used + length > sizeof( batch->text ) )
+            ieee_flush( out, options, batch, pCount, stats );
 
-    /*  Create a binary string, then print it */
-    s = create_binary_string( s, arraySize, userNumber );
-    print_number_string( s, arraySize );
+        if( length <= sizeof( batch->text ) )
+        {
+            memcpy( batch->text + batch->used, string, length );
+            batch->inputs[batch->count] = batch->text + batch->used;
+            batch->used += length;
+        }
+        else    //  Too long to keep, so it goes out on its own, right now
+        {
+            batch->inputs[batch->count] = string;
+            batch->used = sizeof( batch->text );
+        }
+        batch->inputLengths[batch->count] = length;
+    }
 
-    /*  Free memory, null pointer */
-    free( s );
-    s = NULL;
+    batch->values[batch->count++] = value;
+    if( batch->count >= batch->limit || batch->used == sizeof( batch->text ) )
+        ieee_flush( out, options, batch, pCount, stats );
 
     return(0);
 }
 
 
-void text_to_number_finisher( char *tmpString )
+/*  The record for [value], through the --cache if there is one */
+size_t format_u64( const struct d2b_options *options, uint64_t value,
+        double real, char *out, struct stats *stats )
 {
-    printf( "%s", tmpString);
+    struct d2b_cache *cache = thread_cache( options );
+    struct d2b_timing *timing = ( stats != NULL ) ? &stats->radix : NULL;
 
-    /*  Check if the user wants to print lines between each char */
-    if( lineSpacing == 1 )
-    {
-        printf("\n");
-    }
-    else if( sections != 0 )    //  User wants 'sections' instead
-    {
-        int sCount;     //  Second counter.  Yeah, I suck at names.
-        for( sCount = 0; sCount < sections; ++sCount )
-            printf(" ");
-    }
+    if( cache != NULL )
+        return( d2b_cache_format( cache, value, real, out, timing ) );
 
-    memset( tmpString, '\0', 8 );   //  Null out the string
+    return( d2b_format_u64_timed( options, value, real, out, timing ) );
 }
 
 
-int text_to_number( const char *string )
+/*  ----------------------  convert_token ---------------------------------
+ *
+ *  read one number from [string] and print its record.  Returns 1 if the
+ *  number was no good or we hit an error.  With [stats], the parse and the
+ *  formatting are timed.
+ */
+int convert_token( struct output *out, const struct d2b_options *options,
+        const char *string, struct stats *stats )
 {
-    int counter = 0;    //  Generic counter
-    double userNumber;  //  Our user number (converted from ascii char )
-    int pCount = 0;     //  Number of strings printed
+    uint64_t userNumber = 0;
+    double realNumber = 0;
+    size_t length = 0;
+    size_t skip = 0;
+    uint64_t start = 0;
+    uint64_t parsed = 0;
+    int kind = 0;
+    char *p = NULL;
 
-    /*  Create our string pointer, allocate memory to it */
-    char *tmpString;
-    tmpString = malloc( 8 );
-    if( tmpString == NULL )
+    if( typedKernel != NULL )
+        return( typed_token( out, options, string, stats ) );
+
+    if( stats != NULL )
+        start = monotonic_ns();
+
+    kind = d2b_parse( string, &userNumber, &realNumber );
+
+    if( stats != NULL )
     {
-        mem_error("In:  text_to_number");
-        return( 1 );
+        parsed = monotonic_ns();
+        stats->nanos[STAGE_PARSE] += parsed - start;
+        if( kind == D2B_NEGATIVE || kind == D2B_INVALID ||
+                kind == D2B_RANGE || kind == D2B_HUGE )
+            ++stats->rejected;
     }
-    memset( tmpString, '\0', 8 );   //  Null out the string
 
-    for( counter = 0; counter < strlen( string ); ++counter )
+    switch( kind )
     {
-        /*
-         * If our 'character' isn't ASCII, we skip it.
-         */
-        if( isascii( string[counter] ) )
-        {
-            if( pCount > 0 && lineSpacing != 0 && totalConversions > 1 )
+        case D2B_NEGATIVE:
+            if( options->width == 0 && options->layout == D2B_LAYOUT_LINES )
+                output_puts( out, "What is this, a joke!?\n" );
+            else
             {
-                printf("\n");
+                fprintf(stderr, "What is this, a joke!?\n");
+                blank_record( out, options );
             }
-
-            /*  Get the value of the character, convert it to a binary string */
-            userNumber = string[counter];
-
-            if( dec2bin == 1 )
+            return(1);
+        case D2B_INVALID:
+            fprintf(stderr, "ERROR:  '%s' is not a number\n", string );
+            blank_record( out, options );
+            return(1);
+        case D2B_RANGE:
+            fprintf(stderr, "ERROR:  '%s' is past 2^64 and not a whole "
+                    "number\n", string );
+            blank_record( out, options );
+            return(1);
+        case D2B_HUGE:
+            fprintf(stderr, "ERROR:  '%s' would be more than %d digits "
+                    "long\n", string, D2B_EXPANDED_MAX );
+            blank_record( out, options );
+            return(1);
+        case D2B_BIG:       //  Too big for 64 bits
+            if( options->width > 0 )
+                return( too_wide( out, options, string, stats ) );
+
+            p = output_reserve( out, d2b_big_max( d2b_big_digits( string ) ) +
+                    input_room( options, string ) );
+            skip = put_input( options, string, p );
+            length = d2b_format_big( options, string, realNumber, p + skip );
+            if( length == D2B_FAILED )
             {
-                if( verbose == 1 ) printf( "%c  BIN    ", string[counter] );
-
-                double uNumber = userNumber;
-                tmpString = create_binary_string( tmpString, 8, &uNumber );
-                tmpString[8] = '\0';    //  Cut the extra 0 off the end
-                text_to_number_finisher( tmpString );
+                mem_error("In:  convert_token");
+                return(1);
             }
+            output_commit( out, skip + length );
+            break;
+        default:
+            if( d2b_fits_width( options, userNumber ) == 0 )
+                return( too_wide( out, options, string, stats ) );
+
+            p = output_reserve( out, D2B_RECORD_MAX +
+                    input_room( options, string ) );
+            skip = put_input( options, string, p );
+            output_commit( out, skip + format_u64( options, userNumber,
+                        realNumber, p + skip, stats ) );
+            break;
+    }
 
-            if( dec2hex == 1 )
-            {
-                if( verbose == 1 ) printf( "%c  HEX    ", string[counter] );
+    if( stats != NULL )
+        record_done( stats, start, parsed );
 
-                sprintf( tmpString, "%x", (unsigned int)userNumber );
-                text_to_number_finisher( tmpString );
-            }
+    return(0);
+}
 
-            if( hexCaps == 1 )
-            {
-                if( verbose == 1 ) printf( "%c  HEX    ", string[counter] );
 
-                sprintf( tmpString, "%X", (unsigned int)userNumber );
-                text_to_number_finisher( tmpString );
-            }
+/*  ----------------------  bitstats_token  -------------------------------
+ *
+ *  convert_token for --bitstats: count the number in [string] in [bits]
+ *  instead of printing it.  Returns 1 if the number was no good.
+ */
+int bitstats_token( struct bitstats *bits, const char *string,
+        struct stats *stats )
+{
+    uint64_t value = 0;
+    double real = 0;
+    uint64_t start = ( stats != NULL ) ? monotonic_ns() : 0;
+    int kind = d2b_parse( string, &value, &real );
 
-            if( dec2pHex == 1 )
-            {
-                if( verbose == 1 ) printf( "%c  0xHEX  ", string[counter] );
+    if( stats != NULL )
+        stats->nanos[STAGE_PARSE] += monotonic_ns() - start;
 
-                sprintf( tmpString, "%a", userNumber );
-                text_to_number_finisher( tmpString );
-            }
+    if( kind == D2B_NUMBER )
+    {
+        bitstats_add( bits, value );
+        if( stats != NULL )
+            ++stats->records;
+        return(0);
+    }
 
-            if( phexCaps == 1 )
-            {
-                if( verbose == 1 ) printf( "%c  0xHEX  ", string[counter] );
+    if( kind == D2B_NEGATIVE )
+        fprintf(stderr, "What is this, a joke!?\n");
+    else if( kind == D2B_BIG )
+        fprintf(stderr, "ERROR:  '%s' is over 64 bits\n", string );
+    else if( kind == D2B_RANGE )
+        fprintf(stderr, "ERROR:  '%s' is past 2^64 and not a whole number\n",
+                string );
+    else if( kind == D2B_HUGE )
+        fprintf(stderr, "ERROR:  '%s' would be more than %d digits long\n",
+                string, D2B_EXPANDED_MAX );
+    else
+        fprintf(stderr, "ERROR:  '%s' is not a number\n", string );
 
-                sprintf( tmpString, "%A", userNumber );
-                text_to_number_finisher( tmpString );
-            }
+    ++bits->rejected;
+    if( stats != NULL )
+        ++stats->rejected;
+    return(1);
+}
 
-            if( dec2oct == 1 )
-            {
-                if( verbose == 1 ) printf( "%c  OCT    ", string[counter] );
 
-                sprintf( tmpString, "%o", (unsigned int)userNumber );
-                text_to_number_finisher( tmpString );
-            }
+/*  ----------------------  reverse_record  -------------------------------
+ *
+ *  reverse mode: print the binary, hex or octal number in [token] in
+ *  decimal.  With -s or -v a record is a whole line; a label naming some
+ *  other output type means the line is skipped (so every number comes back
+ *  once), and the spaces (or --sep) of -s are squeezed out.  [pCount]
+ *  counts the records printed, for -l.  Returns 1 if the number was no
+ *  good or we hit an error.
+ */
+int reverse_record( struct output *out, const struct d2b_options *options,
+        struct token *token, size_t *pCount, struct stats *stats )
+{
+    static const char *labels[D2B_RADIX_COUNT] = {
+        [D2B_RADIX_HEX] = "HEX", [D2B_RADIX_OCTAL] = "OCT",
+        [D2B_RADIX_BINARY] = "BIN" };
+    static const char *names[D2B_RADIX_COUNT] = {
+        [D2B_RADIX_HEX] = "hex", [D2B_RADIX_OCTAL] = "octal",
+        [D2B_RADIX_BINARY] = "binary" };
+    char *digits = token->data;
+    size_t length = token->length;
+    uint64_t start = 0;
+    size_t written = 0;
+
+    if( stats != NULL )
+        start = monotonic_ns();
+
+    if( reverseLines == 1 )
+    {
+        char *tab = memchr( digits, '\t', length );
+        char *from = digits;
+        char *to = digits;
 
-            if( dec2dec == 1 )
-            {
-                if( verbose == 1 ) printf( "%c  DEC    ", string[counter] );
+        /*  Verbose output has a label up to the tab */
+        if( tab != NULL )
+        {
+            *tab = '\0';
+            if( strcmp( digits, labels[reverseRadix] ) != 0 )
+                return(0);
+            from = tab + 1;
+        }
 
-                sprintf( tmpString, "%d", (unsigned int)userNumber );
-                text_to_number_finisher( tmpString );
-            }
+        for( ; from < token->data + token->length; ++from )
+        {
+            if( ! isspace( (unsigned char)*from ) && ( *from == '\0' ||
+                        strchr( options->separator, *from ) == NULL ) )
+                *to++ = *from;
+        }
+        *to = '\0';
 
+        length = to - digits;
+        if( length == 0 )
+            return(0);
+    }
 
+    if( options->lineSpacing == 1 && *pCount > 0 )
+        output_putc( out, '\n' );
 
-            ++pCount;   //  Increment our print counter
-        }
+    written = d2b_format_reverse( options, reverseRadix, digits,
+            output_reserve( out, d2b_reverse_max( length ) ) );
+    if( written == D2B_FAILED )
+    {
+        mem_error("In:  reverse_record");
+        return(1);
+    }
+    if( written == 0 )
+    {
+        fprintf(stderr, "ERROR:  '%s' is not a %s number\n", digits,
+                names[reverseRadix] );
+        if( stats != NULL )
+            ++stats->rejected;
+        return(1);
     }
 
-    free( tmpString );
-    tmpString = NULL;
+    output_commit( out, written );
+    ++*pCount;
 
-    return( 0 );
+    if( stats != NULL )
+    {
+        uint64_t took = monotonic_ns() - start;
+
+        stats->nanos[STAGE_PARSE] += took;
+        stats_latency( stats, took );
+    }
+
+    return(0);
 }
 
 
-/*
- * This function exists so that people can just pipe numbers to the program
- * and have it work on them
+/*  ----------------------  text_to_number  ------------------------------
+ *
+ *  convert [length] characters of text, a slice at a time so the output
+ *  buffer never has to hold more than a slice's worth.  [pCount] counts the
+ *  characters printed so far and carries over between calls, for text that
+ *  arrives in pieces.  With [stats], each character is a record, but only
+ *  the slices are timed.
  */
-void string_send_stdin(void)
+void text_to_number( struct output *out, const struct d2b_options *options,
+        const char *string, size_t length, size_t *pCount,
+        struct stats *stats )
 {
-    char *theNumber = NULL;     //  Used for strtok
-    char line[256];
-    double userNumber = 0;
-    int pCount = 0;
+    const size_t slice = 64 * 1024;
+    size_t before = *pCount;
+    uint64_t start = 0;
 
-    while( fgets(line, 256, stdin) != NULL )
+    if( stats != NULL )
+        start = monotonic_ns();
+
+    while( length > 0 )
     {
-        /*
-         * We'll use strtok to tokenize the string, number by number, using the
-         * space character as a delimiter
-         */
-        theNumber = strtok(line, " ");
-        while( theNumber != NULL )
-        {
-            /*  If the user wants slightly prettier output */
-            if( lineSpacing == 1 && pCount > 0 )
-            {
-                printf("\n");
-            }
+        size_t n = ( length < slice ) ? length : slice;
+        char *p = output_reserve( out, d2b_text_max( options, n ) );
 
-            if( textMode == 1 )
-            {
-                char tempString[256];
-                char *t = tempString;
+        output_commit( out, d2b_format_text( options, string, n, pCount, p ) );
+        string += n;
+        length -= n;
+    }
 
-                if( pCount > 0 )
-                {
-                    sprintf( tempString, " %s", theNumber );
-                    text_to_number( t );
-                }
-                else
-                    text_to_number( theNumber );
-            }
-            else
-            {
-                userNumber = atof( theNumber );
-                string_printer( &userNumber );
-            }
+    if( stats != NULL )
+    {
+        stats->nanos[STAGE_FORMAT] += monotonic_ns() - start;
+        stats->records += *pCount - before;
+    }
+}
 
-            theNumber = strtok(NULL, " ");  //  Re-run strtok, grab next number
 
-            ++pCount;
-        }
+/*  One raw record, in whichever byte order it was written */
+uint64_t raw_value( const unsigned char *p )
+{
+    const int swap = ( rawBigEndian != ( __BYTE_ORDER__ ==
+                __ORDER_BIG_ENDIAN__ ) );
+    uint32_t half = 0;
+    uint64_t whole = 0;
+
+    if( rawWidth == 4 )
+    {
+        memcpy( &half, p, 4 );
+        return( swap ? __builtin_bswap32( half ) : half );
     }
 
-    /*  If we're using text conversion mode, we do one last readability check */
-    if( textMode == 1 && lineSpacing == 0 && pCount > 0 )
-        printf("\n");
+    memcpy( &whole, p, 8 );
+    return( swap ? __builtin_bswap64( whole ) : whole );
 }
 
 
-
-/*  ============================    MAIN    ==================================*/
-int main( int argc, char *argv[] )
+/*  ----------------------  raw_to_number  ------------------------------
+ *
+ *  convert the whole records in [length] bytes of raw input, straight to
+ *  the number formatter.  Returns the bytes used; anything left over is the
+ *  start of a record that hasn't all arrived yet.
+ */
+size_t raw_to_number( struct output *out, const struct d2b_options *options,
+        const unsigned char *data, size_t length, size_t *pCount,
+        struct stats *stats )
 {
+    size_t used = 0;
 
-    if( argc >= 2 )
+    for( used = 0; used + rawWidth <= length; used += rawWidth )
     {
-        if( strcmp( "-h", argv[1] ) == 0 || strcmp( "--help", argv[1] ) == 0 )
+        uint64_t start = 0;
+        uint64_t parsed = 0;
+
+        if( stats != NULL )
+            start = monotonic_ns();
+
+        uint64_t value = raw_value( data + used );
+
+        if( stats != NULL )
         {
-            print_help(stdout);
-            return(0);
+            parsed = monotonic_ns();
+            stats->nanos[STAGE_PARSE] += parsed - start;
         }
 
-        if( strcmp( "--version", argv[1]) == 0 )
+        if( options->lineSpacing == 1 && *pCount > 0 )
+            output_putc( out, '\n' );
+
+        /*  Raw records have no text of their own; decimal stands in */
+        char digits[24];
+        int length = snprintf( digits, sizeof( digits ), "%llu",
+                (unsigned long long)value );
+
+        if( d2b_fits_width( options, value ) == 0 )
+        {
+            too_wide( out, options, digits, stats );
+            ++*pCount;
+            continue;
+        }
+
+        char *p = output_reserve( out, D2B_RECORD_MAX + d2b_input_max( 20 ) );
+        size_t skip = 0;
+
+        if( options->layout != D2B_LAYOUT_LINES )
+            skip = d2b_format_input( options, digits, length, 0, p );
+
+        output_commit( out, skip + format_u64( options, value, (double)value,
+                    p + skip, stats ) );
+        ++*pCount;
+
+        if( stats != NULL )
+            record_done( stats, start, parsed );
+    }
+
+    return( used );
+}
+
+
+/*  raw_to_number for --bitstats: count the whole records into [bits] */
+size_t raw_to_bitstats( struct bitstats *bits, const unsigned char *data,
+        size_t length, struct stats *stats )
+{
+    size_t used = 0;
+
+    for( used = 0; used + rawWidth <= length; used += rawWidth )
+        bitstats_add( bits, raw_value( data + used ) );
+
+    if( stats != NULL )
+        stats->records += used / rawWidth;
+
+    return( used );
+}
+
+
+/*  read() the input, or take what io_uring has read ahead of us */
+ssize_t input_read( void *data, size_t n )
+{
+    if( inputRing != NULL )
+        return( uring_read( inputRing, data, n ) );
+
+    return( read( inputFd, data, n ) );
+}
+
+
+/*  ----------------------  raw_send  -----------------------------------
+ *
+ *  string_send_stdin for --raw: read big blocks, convert every whole record
+ *  in them and keep the odd bytes at the end for the next block
+ */
+int raw_send( struct output *out, const struct d2b_options *options,
+        struct stats *stats )
+{
+    unsigned char *block = malloc( READ_BLOCK_SIZE );
+    size_t have = 0;
+    size_t used = 0;
+    size_t pCount = 0;
+    ssize_t got = 0;
+    uint64_t start = 0;
+
+    if( block == NULL )
+    {
+        mem_error("In:  raw_send");
+        return(1);
+    }
+
+    for( ;; )
+    {
+        if( isatty( out->fd ) )
+            output_flush( out );
+
+        start = monotonic_ns();
+        got = input_read( block + have, READ_BLOCK_SIZE - have );
+        runStats.nanos[STAGE_READ] += monotonic_ns() - start;
+        if( got < 0 && errno == EINTR )
+            continue;
+        if( got <= 0 )
+            break;
+
+        have += got;
+        runStats.bytesIn += got;
+        if( bitstatsMode == 1 )
+            used = raw_to_bitstats( &runBits, block, have, stats );
+        else
+            used = raw_to_number( out, options, block, have, &pCount, stats );
+        memmove( block, block + used, have - used );
+        have -= used;
+    }
+
+    free( block );
+
+    if( got < 0 )
+    {
+        fprintf(stderr, "ERROR:  Reading input: %s\n", strerror( errno ) );
+        return(1);
+    }
+    if( have > 0 )
+        rawLeftover = 1;
+
+    return(0);
+}
+
+
+/*  ----------------------  range_send  ----------------------------------
+ *
+ *  --range: every record from [start] to [end], [step] apart, counted up
+ *  digit by digit rather than converted one by one.  The first number too
+ *  wide for --width is refused and the rest, all wider still, never come.
+ */
+int range_send( struct output *out, const struct d2b_options *options,
+        uint64_t start, uint64_t end, uint64_t step, struct stats *stats )
+{
+    struct d2b_range range;
+    uint64_t began = ( stats != NULL ) ? monotonic_ns() : 0;
+    size_t pCount = 0;
+    size_t length = 0;
+
+    d2b_range_init( &range, options, start, end, step );
+
+    for( ;; )
+    {
+        char *p = output_reserve( out, D2B_RECORD_MAX + 1 );
+        int gap = ( options->lineSpacing == 1 && pCount > 0 );
+
+        if( gap == 1 )
+            *p = '\n';
+
+        length = d2b_range_next( &range, p + gap );
+        if( length == 0 )
+            break;
+
+        output_commit( out, length + gap );
+        ++pCount;
+    }
+
+    if( range.tooWide == 1 )
+    {
+        char digits[24];
+
+        snprintf( digits, sizeof( digits ), "%llu",
+                (unsigned long long)range.value );
+        if( options->lineSpacing == 1 && pCount > 0 )
+            output_putc( out, '\n' );
+        too_wide( out, options, digits, stats );
+    }
+
+    if( stats != NULL )
+    {
+        stats->records += pCount;
+        stats->nanos[STAGE_FORMAT] += monotonic_ns() - began;
+    }
+
+    return( range.tooWide );
+}
+
+
+/*  range_send for --bitstats: count the range into [bits] */
+void range_bitstats( struct bitstats *bits, uint64_t start, uint64_t end,
+        uint64_t step, struct stats *stats )
+{
+    uint64_t value = start;
+
+    if( start > end )
+        return;
+
+    for( ;; )
+    {
+        bitstats_add( bits, value );
+        if( stats != NULL )
+            ++stats->records;
+        if( end - value < step )
+            break;
+        value += step;
+    }
+}
+
+
+/*  Whether -k picked field [number] */
+static inline int field_selected( size_t number )
+{
+    if( fieldSet.openFrom != 0 && number >= fieldSet.openFrom )
+        return(1);
+
+    return( number <= FIELD_LIMIT &&
+            ( ( fieldSet.mask >> ( number - 1 ) ) & 1 ) != 0 );
+}
+
+
+/*  isspace, without the locale */
+static inline int field_space( char c )
+{
+    return( c == ' ' || ( c >= '\t' && c <= '\r' ) );
+}
+
+
+/*  ----------------------  field_number  --------------------------------
+ *
+ *  trim the spaces from around a field (they stay where they are, as does
+ *  the \r of a \r\n) and say whether what's left could be a number: a
+ *  digit or a point, after a sign if there is one, or with --ieee, inf or
+ *  nan.  Most fields that aren't numbers are turned away here, unparsed.
+ */
+static inline int field_number( char **field, size_t *length )
+{
+    char *p = *field;
+    size_t n = *length;
+
+    while( n > 0 && field_space( *p ) )
+    {
+        ++p;
+        --n;
+    }
+    while( n > 0 && field_space( p[n - 1] ) )
+        --n;
+
+    *field = p;
+    *length = n;
+    if( n == 0 || n > FIELD_MAX )
+        return(0);
+
+    if( n > 1 && ( *p == '+' || *p == '-' ) )
+        ++p;
+
+    return( ( *p >= '0' && *p <= '9' ) || *p == '.' ||
+            ( ieeeFormat != 0 && ( *p == 'i' || *p == 'I' ||
+                                   *p == 'n' || *p == 'N' ) ) );
+}
+
+
+/*  ----------------------  field_record  --------------------------------
+ *
+ *  -k: replace the [length] byte field at [field], trimmed by field_number,
+ *  with its record, laid out to fit in the line: each output type is a
+ *  field of its own and the last newline goes.  The input from [*span] up
+ *  to the field goes out first, untouched, and [*span] moves past the
+ *  field.  Returns 1 if the field isn't a number after all, in which case
+ *  it's left to go out as it is.
+ */
+int field_record( struct output *out, const struct d2b_options *options,
+        char *field, size_t length, char **span, struct stats *stats )
+{
+    char string[FIELD_MAX + 1];
+    uint64_t start = ( stats != NULL ) ? monotonic_ns() : 0;
+    uint64_t value = 0;
+    uint64_t bits = 0;
+    double real = 0;
+    int kind = D2B_NUMBER;
+    size_t written = 0;
+    size_t i = 0;
+    char *p = NULL;
+
+    memcpy( string, field, length );
+    string[length] = '\0';
+
+    /*  --type kernels read the number as they write it, so no need */
+    if( ieeeFormat != 0 )
+        kind = d2b_parse_real( string, &real );
+    else if( typedKernel == NULL )
+        kind = d2b_parse( string, &value, &real );
+
+    if( kind != D2B_NUMBER && kind != D2B_BIG )
+    {
+        if( stats != NULL )
+            ++stats->rejected;
+        return(1);
+    }
+
+    /*  No record to blank out in a line; the field stays as it was */
+    if( kind == D2B_BIG ? options->width > 0 :
+            d2b_fits_width( options, value ) == 0 )
+    {
+        fprintf(stderr, "ERROR:  '%s' doesn't fit in %d bits\n", string,
+                options->width );
+        tooWide = 1;
+        if( stats != NULL )
+            ++stats->rejected;
+        return(1);
+    }
+
+    output_pass( out, *span, field - *span );
+    *span = field;
+
+    if( typedKernel != NULL )
+    {
+        p = output_reserve( out, D2B_RECORD_MAX );
+        if( typedKernel( options, string, p, &written ) != D2B_NUMBER )
+        {
+            if( stats != NULL )
+                ++stats->rejected;
+            return(1);
+        }
+    }
+    else if( ieeeFormat != 0 )
+    {
+        d2b_ieee_bits( ieeeFormat, &real, &bits, 1 );
+        p = output_reserve( out, D2B_RECORD_MAX );
+        written = d2b_format_ieee( options, ieeeFormat, bits, p );
+    }
+    else if( kind == D2B_BIG )
+    {
+        p = output_reserve( out, d2b_big_max( d2b_big_digits( string ) ) );
+        written = d2b_format_big( options, string, real, p );
+        if( written == D2B_FAILED )
+        {
+            mem_error("In:  field_record");
+            return(1);
+        }
+    }
+    else
+    {
+        p = output_reserve( out, D2B_RECORD_MAX );
+        written = format_u64( options, value, real, p, stats );
+    }
+
+    /*  A line per output type becomes a field per output type */
+    for( i = 0; i + 1 < written; ++i )
+    {
+        if( p[i] == '\n' )
+            p[i] = fieldDelimiter;
+    }
+    output_commit( out, written - 1 );
+    *span = field + length;
+
+    if( stats != NULL )
+        record_done( stats, start, start );
+
+    return(0);
+}
+
+
+/*  Convert a picked field if it looks like a number; see field_record */
+static inline void field_try( struct output *out,
+        const struct d2b_options *options, char *field, size_t length,
+        char **span, struct stats *stats )
+{
+    if( field_number( &field, &length ) == 1 )
+        field_record( out, options, field, length, span, stats );
+    else if( stats != NULL )
+        ++stats->rejected;
+}
+
+
+/*  ----------------------  fields_to_number  ----------------------------
+ *
+ *  -k: convert the picked fields of the lines in [length] bytes of input
+ *  and pass everything else through.  Nothing else is copied: it goes out
+ *  in spans, from one converted field to the next, and a line is only
+ *  looked at up to the last field picked.  The last line needn't end with
+ *  a newline.
+ */
+void fields_to_number( struct output *out, const struct d2b_options *options,
+        char *data, size_t length, struct stats *stats )
+{
+    char *end = data + length;
+    char *span = data;
+    char *field = data;
+    char *block = data;
+    size_t number = 1;
+
+    while( block < end )
+    {
+        unsigned newlines = 0;
+        unsigned stops = field_stops( block, end, fieldDelimiter, &newlines );
+        char *next = block + 16;
+
+        while( stops != 0 )
+        {
+            int at = __builtin_ctz( stops );
+            char *stop = block + at;
+
+            stops &= stops - 1;
+            if( stop > field && field_selected( number ) )
+                field_try( out, options, field, stop - field, &span, stats );
+            field = stop + 1;
+
+            if( ( ( newlines >> at ) & 1 ) != 0 )
+            {
+                number = 1;
+                continue;
+            }
+            if( ++number <= fieldSet.last || fieldSet.openFrom != 0 )
+                continue;
+
+            /*  Past the last field picked, so on to the next line */
+            unsigned later = newlines & stops;
+
+            if( later != 0 )
+            {
+                stops &= ~( ( later & -later ) - 1 );
+                continue;
+            }
+
+            char *newline = memchr( stop, '\n', end - stop );
+
+            field = ( newline != NULL ) ? newline + 1 : end;
+            number = 1;
+            next = field;
+            break;
+        }
+
+        block = next;
+    }
+
+    /*  The last line, if it has no newline */
+    if( end > field && field_selected( number ) )
+        field_try( out, options, field, end - field, &span, stats );
+
+    output_pass( out, span, end - span );
+}
+
+
+/*  ----------------------  fields_send  ---------------------------------
+ *
+ *  string_send_stdin for -k: read big blocks and hand over the whole lines
+ *  in them, keeping the start of a line that hasn't all arrived yet
+ */
+int fields_send( struct output *out, const struct d2b_options *options,
+        struct stats *stats )
+{
+    size_t capacity = READ_BLOCK_SIZE;
+    char *block = malloc( capacity );
+    size_t have = 0;
+    size_t lines = 0;
+    ssize_t got = 0;
+    uint64_t start = 0;
+
+    if( block == NULL )
+    {
+        mem_error("In:  fields_send");
+        return(1);
+    }
+
+    for( ;; )
+    {
+        if( isatty( out->fd ) )
+            output_flush( out );
+
+        /*  A line longer than the block needs a bigger one */
+        if( have == capacity )
+        {
+            char *grown = realloc( block, capacity * 2 );
+
+            if( grown == NULL )
+            {
+                free( block );
+                mem_error("In:  fields_send");
+                return(1);
+            }
+            block = grown;
+            capacity *= 2;
+        }
+
+        start = monotonic_ns();
+        got = input_read( block + have, capacity - have );
+        runStats.nanos[STAGE_READ] += monotonic_ns() - start;
+        if( got < 0 && errno == EINTR )
+            continue;
+        if( got <= 0 )
+            break;
+
+        have += got;
+        runStats.bytesIn += got;
+        lines = last_newline_end( block, have );
+        fields_to_number( out, options, block, lines, stats );
+        memmove( block, block + lines, have - lines );
+        have -= lines;
+    }
+
+    if( got == 0 && have > 0 )
+        fields_to_number( out, options, block, have, stats );
+    free( block );
+
+    if( got < 0 )
+    {
+        fprintf(stderr, "ERROR:  Reading input: %s\n", strerror( errno ) );
+        return(1);
+    }
+
+    return(0);
+}
+
+
+/*  Stdin reader hook: someone at a terminal wants their answer first */
+void flush_before_read( void *context )
+{
+    output_flush( (struct output *)context );
+}
+
+
+/*  convert_chunk for --bitstats: count a chunk, then add it to the rest */
+void bitstats_chunk( char *data, size_t length, struct stats *stats )
+{
+    struct bitstats bits;
+    struct token token;
+    char *cursor = data;
+
+    bitstats_init( &bits );
+
+    if( rawWidth != 0 )
+    {
+        if( raw_to_bitstats( &bits, (const unsigned char *)data, length,
+                    stats ) < length )
+            rawLeftover = 1;
+    }
+    else
+    {
+        while( buffer_next_token( &cursor, data + length, &token ) == 1 )
+            bitstats_token( &bits, token.data, stats );
+    }
+
+    bitstats_merge( &runBits, &bits );
+}
+
+
+/*  ----------------------  convert_chunk ---------------------------------
+ *
+ *  pipeline converter: one chunk of stdin, as string_send_stdin would do it.
+ *  Every item gets its -l newline up front, first one included; the pipeline
+ *  drops the very first byte of the output to make up for that.
+ */
+size_t convert_chunk( struct output *out, char *data, size_t length,
+        void *context )
+{
+    const struct d2b_options *options = context;
+    size_t pCount = 1;
+    struct token token;
+    char *cursor = data;
+    struct stats chunkStats;
+    struct stats *stats = NULL;
+    uint64_t start = 0;
+    struct ieee_batch batch;
+
+    batch.count = 0;
+    batch.used = 0;
+    batch.limit = IEEE_BATCH;
+
+    /*  Each worker keeps its own counts and adds them in once per chunk */
+    if( statsMode != 0 )
+    {
+        stats_init( &chunkStats );
+        stats = &chunkStats;
+    }
+
+    if( bitstatsMode == 1 )
+        bitstats_chunk( data, length, stats );
+    else if( textMode == 1 )
+        text_to_number( out, options, data, length, &pCount, stats );
+    else if( fieldMode == 1 )
+        fields_to_number( out, options, data, length, stats );
+    else if( rawWidth != 0 )
+    {
+        /*  Chunks are a multiple of any record size; only the last is off */
+        if( raw_to_number( out, options, (const unsigned char *)data, length,
+                    &pCount, stats ) < length )
+            rawLeftover = 1;
+    }
+    else
+    {
+        int (*next)( char **, char *, struct token * ) =
+            ( reverseLines == 1 ) ? buffer_next_line : buffer_next_token;
+
+        for( ;; )
+        {
+            if( stats != NULL )
+                start = monotonic_ns();
+            if( next( &cursor, data + length, &token ) != 1 )
+                break;
+            if( stats != NULL )
+                stats->nanos[STAGE_TOKENIZE] += monotonic_ns() - start;
+
+            if( reverseMode == 1 )
+            {
+                reverse_record( out, options, &token, &pCount, stats );
+                continue;
+            }
+            if( ieeeFormat != 0 )
+            {
+                ieee_token( out, options, &batch, token.data, &pCount, stats );
+                continue;
+            }
+
+            if( options->lineSpacing == 1 )
+                output_putc( out, '\n' );
+
+            convert_token( out, options, token.data, stats );
+            ++pCount;
+        }
+
+        ieee_flush( out, options, &batch, &pCount, stats );
+    }
+
+    if( stats != NULL )
+    {
+        cache_counts( stats );
+        stats_merge( &runStats, stats );
+    }
+
+    return( pCount - 1 );
+}
+
+
+/*  Pipeline counter: how many records a chunk will turn into */
+size_t count_chunk( const char *data, size_t length, void *context )
+{
+    (void)context;
+
+    if( rawWidth != 0 )
+        return( length / rawWidth );
+
+    return( count_tokens( data, length ) );
+}
+
+
+/*  ----------------------  place_records  -------------------------------
+ *
+ *  set [job] up to have the workers pwrite fixed-width records straight to
+ *  their place in the output file.  When the input is a file of raw records
+ *  we know how big the output will be, so the space is allocated up front.
+ */
+void place_records( struct pipeline_job *job, struct output *out,
+        const struct d2b_options *options )
+{
+    struct stat info;
+
+    job->positionalFd = out->fd;
+    job->itemSize = d2b_record_size( options ) + options->lineSpacing;
+    job->count = count_chunk;
+
+    if( rawWidth != 0 && fstat( inputFd, &info ) == 0 &&
+            S_ISREG( info.st_mode ) && info.st_size >= rawWidth )
+    {
+        size_t records = info.st_size / rawWidth;
+
+        /*  Only a speed-up, so a filesystem that can't do it is no matter */
+        posix_fallocate( out->fd, 0, records * job->itemSize -
+                options->lineSpacing );
+    }
+}
+
+
+/*  ----------------------  string_send_threaded  -------------------------
+ *
+ *  string_send_stdin, spread over [threads] workers.  Output is identical.
+ */
+int string_send_threaded( struct output *out,
+        const struct d2b_options *options )
+{
+    struct pipeline_job job;
+    struct pipeline_totals totals;
+
+    job.threads = threads;
+    job.chunkSize = PIPELINE_CHUNK_SIZE;
+    job.splitTokens = ( textMode == 0 && rawWidth == 0 &&
+            reverseLines == 0 && fieldMode == 0 );
+    job.splitLines = ( reverseLines == 1 || fieldMode == 1 );
+    job.dropFirstByte = ( options->lineSpacing == 1 &&
+            ( textMode == 0 || d2b_conversions( options ) > 1 ) );
+    job.convert = convert_chunk;
+    job.context = (void *)options;
+    job.positionalFd = -1;
+
+    /*  Fixed-width records to a file need no writing in order */
+    if( outputFile == 1 && d2b_record_size( options ) > 0 && fieldMode == 0 )
+    {
+        output_flush( out );
+        place_records( &job, out, options );
+    }
+
+    if( pipeline_run( inputFd, out, &job, &totals ) == 1 )
+        return(1);
+
+    runStats.bytesIn += totals.bytesRead;
+    runStats.nanos[STAGE_READ] += totals.readNanos;
+    runStats.bytesOut += totals.bytesPlaced;
+    runStats.nanos[STAGE_WRITE] += totals.placeNanos;
+
+    if( textMode == 1 && options->lineSpacing == 0 && totals.items > 0 &&
+            options->layout == D2B_LAYOUT_LINES )
+        output_putc( out, '\n' );
+
+    return(0);
+}
+
+
+/*  ----------------------  use_uring  ----------------------------------
+ *
+ *  --uring: -i and -O files converted on one thread have their reads and
+ *  writes go on io_uring, so the disk keeps going while we convert (-j has
+ *  threads of its own for that).  Whatever io_uring can't have stays on
+ *  read and write, with the same output.
+ */
+void use_uring( struct output *out )
+{
+    struct stat info;
+
+    if( inputFd != STDIN_FILENO && fstat( inputFd, &info ) == 0 &&
+            S_ISREG( info.st_mode ) )
+        inputRing = uring_reader_open( inputFd, READ_BLOCK_SIZE );
+
+    if( outputFile == 1 && fstat( out->fd, &info ) == 0 &&
+            S_ISREG( info.st_mode ) )
+        output_use_uring( out );
+}
+
+
+/*
+ * This function exists so that people can just pipe numbers to the program
+ * and have it work on them.  Input is read a block at a time; in text mode
+ * every byte is converted, otherwise it's split into whitespace-separated
+ * numbers, however long the lines get.
+ */
+int string_send_stdin( struct output *out, const struct d2b_options *options )
+{
+    struct reader in;
+    struct token token;
+    int status = 0;
+    size_t pCount = 0;
+    struct stats *stats = ( statsMode != 0 ) ? &runStats : NULL;
+    uint64_t start = 0;
+    uint64_t reading = 0;
+    int (*next)( struct reader *, struct token * ) =
+        ( reverseLines == 1 ) ? reader_next_line : reader_next_token;
+    struct ieee_batch batch;
+
+    /*  Someone typing numbers in wants each one back before the next */
+    batch.count = 0;
+    batch.used = 0;
+    batch.limit = isatty( inputFd ) ? 1 : IEEE_BATCH;
+
+    if( threads > 1 )
+        return( string_send_threaded( out, options ) );
+    if( rawWidth != 0 )
+        return( raw_send( out, options, stats ) );
+    if( fieldMode == 1 )
+        return( fields_send( out, options, stats ) );
+
+    if( reader_init( &in, inputFd, READ_BLOCK_SIZE ) == 1 )
+    {
+        mem_error("In:  string_send_stdin");
+        return(1);
+    }
+    in.ring = inputRing;
+
+    if( isatty( out->fd ) )
+    {
+        in.before_read = flush_before_read;
+        in.context = out;
+    }
+
+    if( textMode == 1 )
+    {
+        while( ( status = reader_next_block( &in, &token ) ) == 1 )
+            text_to_number( out, options, token.data, token.length,
+                    &pCount, stats );
+    }
+    else
+    {
+        for( ;; )
+        {
+            /*  Tokenizing is whatever reader_next_token spent not reading */
+            if( stats != NULL )
+            {
+                start = monotonic_ns();
+                reading = in.readNanos;
+            }
+            if( ( status = next( &in, &token ) ) != 1 )
+                break;
+            if( stats != NULL )
+                stats->nanos[STAGE_TOKENIZE] += monotonic_ns() - start -
+                    ( in.readNanos - reading );
+
+            if( bitstatsMode == 1 )
+            {
+                bitstats_token( &runBits, token.data, stats );
+                continue;
+            }
+            if( reverseMode == 1 )
+            {
+                reverse_record( out, options, &token, &pCount, stats );
+                continue;
+            }
+            if( ieeeFormat != 0 )
+            {
+                ieee_token( out, options, &batch, token.data, &pCount, stats );
+                continue;
+            }
+
+            /*  If the user wants slightly prettier output */
+            if( options->lineSpacing == 1 && pCount > 0 )
+            {
+                output_putc( out, '\n' );
+            }
+
+            convert_token( out, options, token.data, stats );
+            ++pCount;
+        }
+
+        ieee_flush( out, options, &batch, &pCount, stats );
+    }
+
+    runStats.bytesIn += in.bytesRead;
+    runStats.nanos[STAGE_READ] += in.readNanos;
+    reader_free( &in );
+
+    if( status < 0 )
+    {
+        fprintf(stderr, "ERROR:  Reading input: %s\n", strerror( errno ) );
+        return(1);
+    }
+
+    /*  If we're using text conversion mode, we do one last readability check */
+    if( textMode == 1 && options->lineSpacing == 0 && pCount > 0 &&
+            options->layout == D2B_LAYOUT_LINES )
+        output_putc( out, '\n' );
+
+    return(0);
+}
+
+
+
+/*  ----------------------  run_client  ----------------------------------
+ *
+ *  if --client SOCKET (or --client=SOCKET) is among the options, send the
+ *  rest of the command line to that server and return the exit status it
+ *  comes back with.  Returns -1 if there's no --client.
+ */
+int run_client( int argc, char *argv[] )
+{
+    int i = 0;
+
+    for( i = 1; i < argc && strcmp( argv[i], "--" ) != 0; ++i )
+    {
+        const char *path = NULL;
+        int skip = 1;
+
+        if( strcmp( argv[i], "--client" ) == 0 && i + 1 < argc )
+        {
+            path = argv[i + 1];
+            skip = 2;
+        }
+        else if( strncmp( argv[i], "--client=", 9 ) == 0 )
+            path = argv[i] + 9;
+        else
+            continue;
+
+        /*  Everything else goes to the server, in order */
+        memmove( argv + i, argv + i + skip, ( argc - i - skip ) *
+                sizeof( *argv ) );
+        return( serve_client( path, argc - 1 - skip, argv + 1 ) );
+    }
+
+    return( -1 );
+}
+
+
+
+/*  ============================    MAIN    ==================================*/
+int main( int argc, char *argv[] )
+{
+    int clientStatus = run_client( argc, argv );
+
+    if( clientStatus >= 0 )
+        return( clientStatus );
+
+    if( argc >= 2 )
+    {
+        if( strcmp( "-h", argv[1] ) == 0 || strcmp( "--help", argv[1] ) == 0 )
+        {
+            print_help(stdout);
+            return(0);
+        }
+
+        if( strcmp( "--version", argv[1]) == 0 )
         {
             print_version();
             return(0);
@@ -582,63 +1930,98 @@ int main( int argc, char *argv[] )
     }
 
     /*  Init variables */
+    startNanos = monotonic_ns();
     int opt = 0;
+    int optionCount = 0;
+    size_t flushSize = DEFAULT_FLUSH_SIZE;
 
-    verbose = 0;
-    dec2dec = 0;
-    dec2bin = 0;
-    dec2hex = 0;
-    dec2pHex = 0;
-    dec2oct = 0;
-    hexCaps = 0;
-    phexCaps = 0;
-    sections = 0;
-    lineSpacing = 0;
+    d2b_options_init( &userOptions );
     textMode = 0;
-    totalConversions = 0;
-    bigEndian = 1;
+    rawWidth = 0;
+    inputFd = STDIN_FILENO;
+    outputFile = 0;
+    statsMode = 0;
+    reverseMode = 0;
+    dumpPath = NULL;
+    cacheSize = 0;
+    rangeMode = 0;
+    typedKernel = NULL;
+    ieeeFormat = 0;
+    serveSocket = NULL;
+    fieldMode = 0;
+    fieldDelimiter = -1;
+    uringMode = 0;
+    groupMode = 0;
+    bitstatsMode = 0;
+    stats_init( &runStats );
+    bitstats_init( &runBits );
+    int outputFd = STDOUT_FILENO;
+    threads = 0;
 
     /*  Do the optString thing */
-    opt = getopt( argc, argv, optString );
+    opt = getopt_long( argc, argv, optString, longOptions, NULL );
     while( opt != -1 )
     {
         /*  Check and see if we got a wise-aleck */
-        if( ! isalpha(opt) )
+        if( opt == '?' || opt == ':' )
         {
             return(1);
         }
 
+        ++optionCount;
         switch( opt )
         {
             case 'v':   //  Verbosity
-                verbose = 1;
+                userOptions.verbose = 1;
                 break;
             case 'd':   //  Decimal output on
-                dec2dec = 1;
+                userOptions.decimal = 1;
                 break;
             case 'b':   //  Binary on (default)
-                dec2bin = 1;
+                userOptions.binary = 1;
                 break;
             case 'a':   //  Precise hex w/out casting
-                dec2pHex = 1;
+                userOptions.preciseHex = 1;
                 break;
             case 'A':   //  Precise hex w/out casting (using captial letters)
-                phexCaps = 1;
+                userOptions.preciseHexCaps = 1;
                 break;
-            case 'x':   //  Hex, cast to unsigned int
-                dec2hex = 1;
+            case 'x':   //  Hex, all 64 bits
+                userOptions.hex = 1;
                 break;
-            case 'X':   //  Hex, cast to unsigned int, with captial letters
-                hexCaps = 1;
+            case 'X':   //  Hex, all 64 bits, with captial letters
+                userOptions.hexCaps = 1;
                 break;
             case 'o':   //  Octal
-                dec2oct = 1;
+                userOptions.octal = 1;
                 break;
             case 's':   //  Print output in sections of 4 separated by spaces
-                sections = 4;
+                if( userOptions.sections == 0 )
+                    userOptions.sections = 4;
+                break;
+            case OPT_GROUP: //  Sections of some other size
+                userOptions.sections = atoi( optarg );
+                if( userOptions.sections < 1 ||
+                        userOptions.sections > D2B_GROUP_MAX )
+                {
+                    fprintf(stderr, "ERROR:  --group takes 1 to %d digits\n",
+                            D2B_GROUP_MAX );
+                    return(1);
+                }
+                groupMode = 1;
+                break;
+            case OPT_SEP:   //  Something other than a space between sections
+                if( d2b_set_separator( &userOptions, optarg ) == 1 )
+                {
+                    fprintf(stderr, "ERROR:  --sep takes 1 to %d bytes, no ",
+                            D2B_SEPARATOR_MAX );
+                    fprintf(stderr, "letters, digits, quotes or backslashes\n");
+                    return(1);
+                }
+                groupMode = 1;
                 break;
             case 'l':   //  If more than one number received, print extra lines
-                lineSpacing = 1;
+                userOptions.lineSpacing = 1;
                 break;
             case 'h':   //  Print help
                 print_help(stdout);
@@ -647,11 +2030,155 @@ int main( int argc, char *argv[] )
             case 't':   //  Turn on textmode conversion
                 textMode = 1;
                 break;
+            case 'r':   //  Reverse: binary, hex or octal back to decimal
+                reverseMode = 1;
+                break;
+            case 'f':   //  Dump a file as bits
+                dumpPath = optarg;
+                break;
+            case OPT_RANGE: //  Count from START to END
+                rangeMode = 1;
+                break;
+            case OPT_CACHE: //  Remember records of numbers seen before
+                cacheSize = CACHE_DEFAULT_SIZE;
+                if( optarg != NULL && ( parse_size( optarg, &cacheSize ) == 1 ||
+                            cacheSize == 0 ) )
+                {
+                    fprintf(stderr, "ERROR:  Bad cache size '%s'\n", optarg);
+                    return(1);
+                }
+                break;
+            case 'k':   //  Convert these fields of each line
+                if( parse_fields( optarg ) == 1 )
+                {
+                    fprintf(stderr, "ERROR:  Bad field list '%s'; use ",
+                            optarg );
+                    fprintf(stderr, "fields 1 to %d, like 2, 1,3-5 or 4-\n",
+                            FIELD_LIMIT );
+                    return(1);
+                }
+                fieldMode = 1;
+                break;
+            case 'F':   //  What the fields are split on
+                if( parse_delimiter( optarg ) == 1 )
+                {
+                    fprintf(stderr, "ERROR:  -F takes one character ");
+                    fprintf(stderr, "(or \\t), not '%s'\n", optarg );
+                    return(1);
+                }
+                break;
+            case OPT_SERVE: //  Stay up and convert for clients
+                serveSocket = optarg;
+                break;
+            case OPT_URING: //  Overlap file I/O with converting
+                uringMode = 1;
+                break;
+            case OPT_BITSTATS:  //  Count the bits instead of printing them
+                bitstatsMode = 1;
+                break;
+            case OPT_FORMAT:    //  Columns instead of lines
+                if( parse_layout( optarg ) == 1 )
+                {
+                    fprintf(stderr, "ERROR:  --format is one of tsv, csv ");
+                    fprintf(stderr, "or ndjson\n");
+                    return(1);
+                }
+                break;
+            case OPT_IEEE:  //  Floating-point bit patterns
+                if( parse_ieee( optarg ) == 1 )
+                {
+                    fprintf(stderr, "ERROR:  --ieee is one of f16, f32 ");
+                    fprintf(stderr, "or f64\n");
+                    return(1);
+                }
+                break;
+            case OPT_TYPE:  //  Fixed-width integers, signed or not
+                if( parse_type( optarg ) == 1 )
+                {
+                    fprintf(stderr, "ERROR:  --type is one of i8, u8, i16, ");
+                    fprintf(stderr, "u16, i32, u32, i64, u64, i128 or u128\n");
+                    return(1);
+                }
+                break;
             case 'e':   //  little endian
-                bigEndian=0;
+                userOptions.bigEndian = 0;
                 break;
             case 'E':   //  big endian
-                bigEndian=1;
+                userOptions.bigEndian = 1;
+                break;
+            case 'j':   //  Worker threads
+                threads = atoi( optarg );
+                if( threads < 1 || threads > PIPELINE_MAX_THREADS )
+                {
+                    fprintf(stderr, "ERROR:  -j takes 1 to %d threads\n",
+                            PIPELINE_MAX_THREADS );
+                    return(1);
+                }
+                break;
+            case 'i':   //  Input file instead of stdin
+                if( inputFd != STDIN_FILENO )
+                    close( inputFd );
+                inputFd = open( optarg, O_RDONLY );
+                if( inputFd < 0 )
+                {
+                    fprintf(stderr, "ERROR:  Could not open '%s': %s\n",
+                            optarg, strerror( errno ) );
+                    return(1);
+                }
+                break;
+            case 'O':   //  Output file instead of stdout
+                if( outputFd != STDOUT_FILENO )
+                    close( outputFd );
+                outputFd = open( optarg, O_RDWR | O_CREAT | O_TRUNC, 0666 );
+                if( outputFd < 0 )
+                {
+                    fprintf(stderr, "ERROR:  Could not open '%s': %s\n",
+                            optarg, strerror( errno ) );
+                    return(1);
+                }
+                outputFile = 1;
+                break;
+            case OPT_WIDTH: //  Fixed-width output
+                userOptions.width = atoi( optarg );
+                if( userOptions.width < 1 ||
+                        userOptions.width > MAX_WIDTH )
+                {
+                    fprintf(stderr, "ERROR:  --width takes 1 to %d bits\n",
+                            MAX_WIDTH );
+                    return(1);
+                }
+                break;
+            case OPT_RAW:   //  Fixed-width binary records
+                if( parse_raw_format( optarg ) == 1 )
+                {
+                    fprintf(stderr, "ERROR:  Unknown raw format '%s'\n",
+                            optarg );
+                    fprintf(stderr, "Use u32le, u32be, u64le or u64be\n");
+                    return(1);
+                }
+                break;
+            case OPT_STATS: //  Report where the time went
+                if( optarg == NULL )
+                    statsMode = 1;
+                else if( strcmp( optarg, "json" ) == 0 )
+                    statsMode = 2;
+                else
+                {
+                    fprintf(stderr, "ERROR:  --stats takes no format or ");
+                    fprintf(stderr, "'json', not '%s'\n", optarg );
+                    return(1);
+                }
+                break;
+            case OPT_VERSION:
+                print_version();
+                return(0);
+                break;
+            case OPT_BUFFER_SIZE:   //  How much output to collect per write
+                if( parse_size( optarg, &flushSize ) == 1 || flushSize == 0 )
+                {
+                    fprintf(stderr, "ERROR:  Bad buffer size '%s'\n", optarg);
+                    return(1);
+                }
                 break;
 
             default:
@@ -659,7 +2186,20 @@ int main( int argc, char *argv[] )
                 break;
         }
 
-        opt = getopt( argc, argv, optString );
+        opt = getopt_long( argc, argv, optString, longOptions, NULL );
+    }
+
+    /*  A server takes its options from each request instead */
+    if( serveSocket != NULL )
+    {
+        if( optionCount > 1 || optind < argc )
+        {
+            fprintf(stderr, "ERROR:  --serve takes a socket and nothing ");
+            fprintf(stderr, "else; options come with each request\n");
+            return(1);
+        }
+
+        return( serve_run( serveSocket ) );
     }
 
     /*  Once outside the loop, deal with argc and argv */
@@ -667,38 +2207,286 @@ int main( int argc, char *argv[] )
     argc -= (optind - 1);
 
     /*  If no options specified, the default is to print binary */
-    if( dec2bin == 0 && dec2hex == 0 && dec2oct == 0 && dec2pHex == 0 &&
-            hexCaps == 0 && phexCaps == 0 && dec2dec == 0 )
+    if( d2b_conversions( &userOptions ) == 0 )
+    {
+        userOptions.binary = 1;
+    }
+
+    /*  Everything we print goes through one big buffer, flushed at exit */
+    if( output_init( &stdOutput, outputFd, flushSize ) == 1 )
+    {
+        mem_error("Main:  Allocating the output buffer");
+        return(1);
+    }
+    if( statsMode != 0 )
+        atexit( report_stats );
+    atexit( flush_stdout );
+
+    if( rawWidth != 0 && textMode == 1 )
+    {
+        fprintf(stderr, "ERROR:  --raw and -t don't mix\n");
+        return(1);
+    }
+    if( userOptions.width > 0 && ( textMode == 1 ||
+                userOptions.preciseHex == 1 ||
+                userOptions.preciseHexCaps == 1 ) )
+    {
+        fprintf(stderr, "ERROR:  --width doesn't work with -t, -a or -A\n");
+        return(1);
+    }
+    if( typedKernel != NULL && ( textMode == 1 || reverseMode == 1 ||
+                rawWidth != 0 || dumpPath != NULL || rangeMode == 1 ||
+                userOptions.width > 0 ) )
+    {
+        fprintf(stderr, "ERROR:  --type doesn't mix with -t, -r, -f, --raw, ");
+        fprintf(stderr, "--range or --width\n");
+        return(1);
+    }
+    if( ieeeFormat != 0 && ( textMode == 1 || reverseMode == 1 ||
+                rawWidth != 0 || dumpPath != NULL || rangeMode == 1 ||
+                userOptions.width > 0 || typedKernel != NULL ) )
+    {
+        fprintf(stderr, "ERROR:  --ieee doesn't mix with -t, -r, -f, --raw, ");
+        fprintf(stderr, "--range, --width or --type\n");
+        return(1);
+    }
+    if( groupMode == 1 && ( textMode == 1 || dumpPath != NULL ) )
+    {
+        fprintf(stderr, "ERROR:  --group and --sep don't mix with -t or -f\n");
+        return(1);
+    }
+    if( groupMode == 1 && userOptions.sections == 0 )
+        userOptions.sections = 4;
+    if( fieldDelimiter >= 0 && fieldMode == 0 )
+    {
+        fprintf(stderr, "ERROR:  -F is for splitting -k fields\n");
+        return(1);
+    }
+    if( fieldMode == 1 && ( textMode == 1 || reverseMode == 1 ||
+                rawWidth != 0 || dumpPath != NULL || rangeMode == 1 ||
+                userOptions.lineSpacing == 1 ||
+                userOptions.layout != D2B_LAYOUT_LINES ) )
+    {
+        fprintf(stderr, "ERROR:  -k doesn't mix with -t, -r, -f, -l, --raw, ");
+        fprintf(stderr, "--range or --format\n");
+        return(1);
+    }
+    if( fieldMode == 1 && fieldDelimiter < 0 )
+        fieldDelimiter = '\t';
+    if( userOptions.layout != D2B_LAYOUT_LINES && ( reverseMode == 1 ||
+                dumpPath != NULL ) )
+    {
+        fprintf(stderr, "ERROR:  --format doesn't mix with -r or -f\n");
+        return(1);
+    }
+    if( bitstatsMode == 1 && ( textMode == 1 || reverseMode == 1 ||
+                dumpPath != NULL || fieldMode == 1 || typedKernel != NULL ||
+                ieeeFormat != 0 || userOptions.width > 0 || cacheSize > 0 ||
+                userOptions.layout != D2B_LAYOUT_LINES ) )
+    {
+        fprintf(stderr, "ERROR:  --bitstats doesn't mix with -t, -r, -f, -k, ");
+        fprintf(stderr, "--type, --ieee, --width, --format or --cache\n");
+        return(1);
+    }
+
+    /*  Reverse mode reads one type of number, picked like an output type */
+    if( reverseMode == 1 )
+    {
+        if( textMode == 1 || rawWidth != 0 || userOptions.width > 0 ||
+                userOptions.decimal == 1 || userOptions.preciseHex == 1 ||
+                userOptions.preciseHexCaps == 1 ||
+                d2b_conversions( &userOptions ) > 1 )
+        {
+            fprintf(stderr, "ERROR:  -r reads one of -b, -x, -X or -o, and ");
+            fprintf(stderr, "doesn't mix with -t, --raw or --width\n");
+            return(1);
+        }
+
+        if( userOptions.hex == 1 || userOptions.hexCaps == 1 )
+            reverseRadix = D2B_RADIX_HEX;
+        else if( userOptions.octal == 1 )
+            reverseRadix = D2B_RADIX_OCTAL;
+        else
+            reverseRadix = D2B_RADIX_BINARY;
+
+        reverseLines = ( userOptions.sections != 0 ||
+                userOptions.verbose == 1 );
+    }
+
+    /*  Columns are a line per number, with nothing for -l to space out */
+    if( userOptions.layout != D2B_LAYOUT_LINES )
+    {
+        userOptions.lineSpacing = 0;
+        output_commit( &stdOutput, d2b_format_header( &userOptions,
+                    output_reserve( &stdOutput, D2B_RECORD_MAX ) ) );
+    }
+
+    /*  The options are settled now, so this thread's cache can be made */
+    if( cacheSize > 0 && thread_cache( &userOptions ) == NULL )
+    {
+        fprintf(stderr, "ERROR:  No room for a --cache of %zu bytes\n",
+                cacheSize );
+        return(1);
+    }
+
+    /*  A range is numbers we make up ourselves, so no input goes with it */
+    if( rangeMode == 1 )
     {
-        dec2bin = 1;
+        uint64_t bounds[3] = { 0, 0, 1 };
+        int i = 0;
+
+        if( argc < 3 || argc > 4 || textMode == 1 || reverseMode == 1 ||
+                rawWidth != 0 || dumpPath != NULL || inputFd != STDIN_FILENO )
+        {
+            fprintf(stderr, "ERROR:  --range takes START END [STEP] and no ");
+            fprintf(stderr, "-t, -r, -f, -i or --raw\n");
+            return(1);
+        }
+
+        for( i = 1; i < argc; ++i )
+        {
+            if( parse_bound( argv[i], &bounds[i - 1] ) == 1 )
+            {
+                fprintf(stderr, "ERROR:  '%s' is no good for --range; ",
+                        argv[i] );
+                fprintf(stderr, "use whole numbers below 2^64\n");
+                return(1);
+            }
+        }
+        if( bounds[2] == 0 )
+        {
+            fprintf(stderr, "ERROR:  A --range STEP of 0 never gets there\n");
+            return(1);
+        }
+
+        if( bitstatsMode == 1 )
+        {
+            range_bitstats( &runBits, bounds[0], bounds[1], bounds[2],
+                    ( statsMode != 0 ) ? &runStats : NULL );
+            bitstats_report( &stdOutput, &runBits );
+            return(0);
+        }
+
+        return( range_send( &stdOutput, &userOptions, bounds[0], bounds[1],
+                    bounds[2], ( statsMode != 0 ) ? &runStats : NULL ) );
     }
 
+    /*  A file dump is binary and nothing else, with the bytes as they come */
+    if( dumpPath != NULL )
+    {
+        if( argc > 1 || d2b_conversions( &userOptions ) > 1 ||
+                userOptions.binary == 0 || textMode == 1 ||
+                reverseMode == 1 || rawWidth != 0 ||
+                userOptions.width > 0 || userOptions.lineSpacing == 1 ||
+                inputFd != STDIN_FILENO )
+        {
+            fprintf(stderr, "ERROR:  -f only mixes with -v, -s, -e, -E, ");
+            fprintf(stderr, "-j and -O\n");
+            return(1);
+        }
 
-    /*  Here, we find the total number of conversions... for reasons */
-    totalConversions = ( dec2bin + dec2dec + dec2hex + dec2pHex + dec2oct +
-            hexCaps + phexCaps );
+        return( dump_file( dumpPath, &stdOutput, &userOptions, threads,
+                    outputFile, ( statsMode != 0 ) ? &runStats : NULL ) );
+    }
 
-    /*  Check if the user's trying to use stdin */
+    /*  Check if the user's trying to use stdin (or -i, or --raw) */
     if( argc <= 1 || strcmp( "-", argv[1] ) == 0 )
     {
-        string_send_stdin();
-        return(0);
+        int status = 0;
+
+        if( uringMode == 1 && threads <= 1 )
+            use_uring( &stdOutput );
+
+        status = string_send_stdin( &stdOutput, &userOptions );
+        uring_reader_close( inputRing );
+        inputRing = NULL;
+
+        if( bitstatsMode == 1 && status == 0 )
+            bitstats_report( &stdOutput, &runBits );
+
+        if( rawLeftover == 1 )
+        {
+            fprintf(stderr, "ERROR:  Input ends partway through a record\n");
+            return(1);
+        }
+        return( tooWide == 1 ? 1 : status );
+    }
+    if( rawWidth != 0 || inputFd != STDIN_FILENO || fieldMode == 1 )
+    {
+        fprintf(stderr, "ERROR:  Numbers on the command line can't be mixed ");
+        fprintf(stderr, "with -i, -k or --raw\n");
+        return(1);
     }
 
     int pCount = 0;     //  Used to count the number of sections printed
+    struct stats *stats = ( statsMode != 0 ) ? &runStats : NULL;
+
+    /*  Bit statistics skip the numbers that are no good and count the rest */
+    if( bitstatsMode == 1 )
+    {
+        for( ; argc > 1; ++argv, --argc )
+        {
+            runStats.bytesIn += strlen( argv[1] );
+            bitstats_token( &runBits, argv[1], stats );
+        }
+        bitstats_report( &stdOutput, &runBits );
+
+        return( runBits.rejected > 0 );
+    }
+
     while( argc > 1 )
     {
+        runStats.bytesIn += strlen( argv[1] );
+
+        /*  Reverse mode has its own counting, for -l */
+        if( reverseMode == 1 )
+        {
+            struct token token = { argv[1], strlen( argv[1] ) };
+            size_t printed = pCount;
+
+            if( reverse_record( &stdOutput, &userOptions, &token, &printed,
+                        stats ) == 1 )
+                return(1);
+
+            pCount = printed;
+            ++argv;
+            --argc;
+            continue;
+        }
+
+        /*  So does --ieee, a batch of the whole command line at a time */
+        if( ieeeFormat != 0 )
+        {
+            struct ieee_batch batch;
+            size_t printed = pCount;
+
+            batch.count = 0;
+            batch.used = 0;
+            batch.limit = IEEE_BATCH;
+            while( argc > 1 && ieee_token( &stdOutput, &userOptions, &batch,
+                        argv[1], &printed, stats ) == 0 )
+            {
+                ++argv;
+                --argc;
+            }
+            ieee_flush( &stdOutput, &userOptions, &batch, &printed, stats );
+
+            return( argc > 1 );
+        }
+
         /*  If the user wants slightly prettier output */
-        if( lineSpacing == 1 && pCount > 0 )
+        if( userOptions.lineSpacing == 1 && pCount > 0 )
         {
-            printf("\n");
+            output_putc( &stdOutput, '\n' );
         }
 
         /*  Convert a string to a number */
         if( textMode == 1 )
         {
-            if( ( text_to_number( argv[1] )) == 1 )
-                return( 1 );
+            size_t printed = 0;
+
+            text_to_number( &stdOutput, &userOptions, argv[1],
+                    strlen( argv[1] ), &printed, stats );
 
             ++pCount;
             ++argv;
@@ -709,14 +2497,15 @@ int main( int argc, char *argv[] )
              * enable line prettification, we still end the output with a
              * newline character.
              */
-            if( lineSpacing == 0 && pCount > 0 )
-                printf("\n");
+            if( userOptions.lineSpacing == 0 && pCount > 0 &&
+                    userOptions.layout == D2B_LAYOUT_LINES )
+                output_putc( &stdOutput, '\n' );
 
             continue;
         }
 
-        double userNumber = atof(argv[1]);  //  Create a new double from argv[1]
-        if( string_printer( &userNumber ) == 1 )    //  Send to string_printer
+        /*  Convert argv[1], refusing negatives */
+        if( convert_token( &stdOutput, &userOptions, argv[1], stats ) == 1 )
             return(1);
 
         /*  Our various counters and lists */
@@ -0,0 +1,282 @@
+/*******************************************************************************
+ * dump.c       |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      Bit dumps of whole files; see dump.h
+ *
+ *  Notes:
+ *      Files that can't be mapped (pipes, /proc) are read into memory
+ *      instead, and dumped just the same.
+ *
+ *      Threads are started for each batch and joined before it goes out.
+ *      A batch is tens of thousands of rows, so starting them is lost in
+ *      the noise, and there's no queue to get wrong.
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "dump.h"
+#include "pipeline.h"
+
+/*  Input bytes per batch when the output is a stream */
+#define DUMP_BATCH ( D2B_DUMP_ROW * 64 * 1024 )
+
+/*  One thread's share of a range */
+struct dump_slice
+{
+    const struct d2b_options *options;
+    const unsigned char *data;
+    size_t size;
+    size_t from;
+    size_t to;
+    char *out;
+};
+
+
+static void *dump_thread( void *argument )
+{
+    struct dump_slice *slice = argument;
+
+    d2b_format_dump( slice->options, slice->data, slice->size, slice->from,
+            slice->to, slice->out );
+    return( NULL );
+}
+
+
+/*  ----------------------  dump_range  ----------------------------------
+ *
+ *  dump bytes [from] to [to] of the file into [out], split into whole rows
+ *  over [threads] threads.  Each slice's place in [out] is the size of the
+ *  dump up to where it starts.
+ */
+static int dump_range( const struct d2b_options *options,
+        const unsigned char *data, size_t size, size_t from, size_t to,
+        char *out, int threads )
+{
+    struct dump_slice slices[PIPELINE_MAX_THREADS];
+    pthread_t ids[PIPELINE_MAX_THREADS];
+    size_t rows = ( to - from + D2B_DUMP_ROW - 1 ) / D2B_DUMP_ROW;
+    size_t base = d2b_dump_size( options, size, from );
+    int started = 0;
+    int status = 0;
+    int i = 0;
+
+    if( threads < 1 )
+        threads = 1;
+    if( (size_t)threads > rows )
+        threads = ( rows > 0 ) ? (int)rows : 1;
+
+    for( i = 0; i < threads; ++i )
+    {
+        struct dump_slice *slice = &slices[i];
+
+        slice->options = options;
+        slice->data = data;
+        slice->size = size;
+        slice->from = from + rows * i / threads * D2B_DUMP_ROW;
+        slice->to = from + rows * ( i + 1 ) / threads * D2B_DUMP_ROW;
+        if( slice->to > to )
+            slice->to = to;
+        slice->out = out + d2b_dump_size( options, size, slice->from ) - base;
+    }
+
+    /*  The last slice is ours */
+    for( i = 0; i < threads - 1; ++i )
+    {
+        if( pthread_create( &ids[i], NULL, dump_thread, &slices[i] ) != 0 )
+        {
+            fprintf(stderr, "ERROR:  Could not start a thread\n");
+            status = 1;
+            break;
+        }
+        ++started;
+    }
+
+    if( status == 0 )
+        dump_thread( &slices[threads - 1] );
+
+    for( i = 0; i < started; ++i )
+        pthread_join( ids[i], NULL );
+
+    return( status );
+}
+
+
+/*  ----------------------  dump_to_file  --------------------------------
+ *
+ *  the output is a regular file: size it, map it and let the threads fill
+ *  it in place.  Returns -1 if it can't be mapped, for the caller to fall
+ *  back on streaming.
+ */
+static int dump_to_file( struct output *out,
+        const struct d2b_options *options, const unsigned char *data,
+        size_t size, int threads, struct stats *stats )
+{
+    size_t total = d2b_dump_size( options, size, size );
+    struct stat info;
+    off_t start = 0;
+    int status = 0;
+
+    if( fstat( out->fd, &info ) != 0 || ! S_ISREG( info.st_mode ) )
+        return( -1 );
+
+    /*  Anything already buffered goes first; the dump follows it */
+    if( output_flush( out ) == 1 )
+        return( 1 );
+    start = lseek( out->fd, 0, SEEK_CUR );
+    if( start < 0 || ftruncate( out->fd, start + total ) != 0 )
+        return( -1 );
+
+    /*  Mappings start on a page; the dump may not */
+    off_t page = start & ~(off_t)( sysconf( _SC_PAGESIZE ) - 1 );
+    char *map = mmap( NULL, total + ( start - page ), PROT_READ | PROT_WRITE,
+            MAP_SHARED, out->fd, page );
+    if( map == MAP_FAILED )
+        return( -1 );
+
+    status = dump_range( options, data, size, 0, size, map + ( start - page ),
+            threads );
+
+    munmap( map, total + ( start - page ) );
+    lseek( out->fd, start + total, SEEK_SET );
+
+    if( stats != NULL )
+        stats->bytesOut += total;
+
+    return( status );
+}
+
+
+/*  Stream the dump through [out], a batch of rows at a time */
+static int dump_to_stream( struct output *out,
+        const struct d2b_options *options, const unsigned char *data,
+        size_t size, int threads )
+{
+    size_t from = 0;
+
+    for( from = 0; from < size; from += DUMP_BATCH )
+    {
+        size_t to = ( size - from < DUMP_BATCH ) ? size : from + DUMP_BATCH;
+        size_t length = d2b_dump_size( options, size, to ) -
+            d2b_dump_size( options, size, from );
+
+        if( dump_range( options, data, size, from, to,
+                    output_reserve( out, length ), threads ) == 1 )
+            return( 1 );
+        output_commit( out, length );
+    }
+
+    return( 0 );
+}
+
+
+/*  ----------------------  read_whole  ----------------------------------
+ *
+ *  read everything [fd] has into a buffer of our own, for files that can't
+ *  be mapped: pipes, and the likes of /proc/cpuinfo that say they're empty.
+ *  Returns NULL with errno set if the read or the memory fails.
+ */
+static unsigned char *read_whole( int fd, size_t *size )
+{
+    size_t room = 64 * 1024;
+    unsigned char *data = malloc( room );
+    unsigned char *bigger = NULL;
+    ssize_t got = 0;
+
+    *size = 0;
+    while( data != NULL )
+    {
+        if( *size == room )
+        {
+            room *= 2;
+            bigger = realloc( data, room );
+            if( bigger == NULL )
+                break;
+            data = bigger;
+        }
+
+        got = read( fd, data + *size, room - *size );
+        if( got == 0 )
+            return( data );
+        if( got > 0 )
+            *size += (size_t)got;
+        else if( errno != EINTR )
+            break;
+    }
+
+    free( data );
+    return( NULL );
+}
+
+
+int dump_file( const char *path, struct output *out,
+        const struct d2b_options *options, int threads, int inPlace,
+        struct stats *stats )
+{
+    struct stat info;
+    uint64_t start = monotonic_ns();
+    int status = -1;
+    int fd = open( path, O_RDONLY );
+
+    if( fd < 0 || fstat( fd, &info ) != 0 )
+    {
+        fprintf(stderr, "ERROR:  Could not open '%s': %s\n", path,
+                strerror( errno ) );
+        if( fd >= 0 )
+            close( fd );
+        return( 1 );
+    }
+
+    size_t size = (size_t)info.st_size;
+    const unsigned char *data = MAP_FAILED;
+    unsigned char *copy = NULL;
+
+    if( S_ISREG( info.st_mode ) && size > 0 )
+        data = mmap( NULL, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    else
+    {
+        copy = read_whole( fd, &size );
+        if( copy != NULL )
+            data = copy;
+    }
+    close( fd );
+    if( data == MAP_FAILED )
+    {
+        fprintf(stderr, "ERROR:  Could not read '%s': %s\n", path,
+                strerror( errno ) );
+        return( 1 );
+    }
+    if( size == 0 )
+    {
+        free( copy );
+        return( 0 );
+    }
+    if( copy == NULL )
+        madvise( (void *)data, size, MADV_SEQUENTIAL );
+
+    if( inPlace == 1 )
+        status = dump_to_file( out, options, data, size, threads, stats );
+    if( status < 0 )
+        status = dump_to_stream( out, options, data, size, threads );
+
+    if( copy == NULL )
+        munmap( (void *)data, size );
+    free( copy );
+
+    if( stats != NULL )
+    {
+        stats->bytesIn += size;
+        stats->records += size;
+        stats->nanos[STAGE_FORMAT] += monotonic_ns() - start;
+    }
+
+    return( status );
+}
@@ -0,0 +1,33 @@
+/*******************************************************************************
+ * dump.h       |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      -f: every byte of a file as bits, in rows like xxd -b.  The file is
+ *      mapped rather than read where it can be, and its rows are split into
+ *      one range per thread.  Every row's length is known before it's
+ *      written, so each thread dumps straight into its own part of the
+ *      output: the mapped output file with -O, or the output buffer a batch
+ *      at a time.
+ ******************************************************************************/
+#ifndef DEC2BIN_DUMP_H
+#define DEC2BIN_DUMP_H
+
+#include <stddef.h>
+
+#include "libdec2bin.h"
+#include "output.h"
+#include "stats.h"
+
+/*
+ *  Dump the file at [path] to [out] with [threads] threads (0 or 1 for
+ *  none).  [inPlace] says out->fd is a file of our own (-O) that can be
+ *  sized and mapped; never a stdout someone else may share.  [stats], if
+ *  not NULL, gets the bytes and the time.  Returns 0 on success, 1 if
+ *  something went wrong (a message has been printed).
+ */
+int dump_file( const char *path, struct output *out,
+        const struct d2b_options *options, int threads, int inPlace,
+        struct stats *stats );
+
+#endif
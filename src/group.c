@@ -0,0 +1,383 @@
+/*******************************************************************************
+ * group.c      |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      Digit grouping; see group.h
+ *
+ *  Notes:
+ *      Think of every number as padded out with zeros to whole groups, so
+ *      the grouped string is a repeat of the same unit (a group, then a
+ *      separator) with the padding left off the front when it isn't
+ *      wanted.  Where a byte of output comes from then depends only on the
+ *      group size and how far into a unit it is.
+ *
+ *      With a one-byte separator and groups under 16 (-s, bytes, thousands)
+ *      the SSSE3 kernel writes the output 16 bytes at a time, each from one
+ *      load of the digits and one shuffle picked by how far into a unit the
+ *      16 bytes start; the lanes for the separator, and for padding, are
+ *      filled in after.  The last 16 bytes overlap the ones before, rather
+ *      than stopping short, so every store is whole; only output shorter
+ *      than 16 bytes spills past its end.  Nothing is read from before or
+ *      past the digits.
+ *
+ *      Other groups and separators, and DEC2BIN_KERNEL=scalar or =sse2 in
+ *      the environment (as for bitexpand), go a unit at a time: the
+ *      separator as a 4-byte word and the group as 16-byte copies, each
+ *      spilling into the unit after it while at least 16 more digits are to
+ *      come, then the last few exactly.
+ ******************************************************************************/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "group.h"
+
+#if defined(__x86_64__)
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+
+/*  Zeros to pad a first group with */
+static const char zeros[64] =
+    "00000000000000000000000000000000" "00000000000000000000000000000000";
+
+
+/*
+ *  [n] bytes from [in] to [out], as fixed-size copies that overlap at the
+ *  end rather than a call to memcpy for a length it can't know
+ */
+static inline void copy_short( char *out, const char *in, size_t n )
+{
+    size_t k = 0;
+
+    if( n >= 16 )
+    {
+        for( k = 0; k + 16 < n; k += 16 )
+            memcpy( out + k, in + k, 16 );
+        memcpy( out + n - 16, in + n - 16, 16 );
+    }
+    else if( n >= 8 )
+    {
+        memcpy( out, in, 8 );
+        memcpy( out + n - 8, in + n - 8, 8 );
+    }
+    else if( n >= 4 )
+    {
+        memcpy( out, in, 4 );
+        memcpy( out + n - 4, in + n - 4, 4 );
+    }
+    else if( n > 0 )
+    {
+        out[0] = in[0];
+        out[n / 2] = in[n / 2];
+        out[n - 1] = in[n - 1];
+    }
+}
+
+
+/*  ------------------  group_scalar    ---------------------------
+ *
+ *  the first group (padded or not), then a unit at a time
+ */
+static size_t group_scalar( char *out, const char *digits, size_t n,
+        int group, const char *separator, int length, int pad )
+{
+    const size_t span = ( group + 15 ) & ~15;
+    const char *end = digits + n;
+    size_t units = ( n - 1 ) / group;
+    size_t first = n - units * group;
+    uint32_t word = 0;
+    char *p = out;
+    size_t k = 0;
+
+    memcpy( &word, separator, length );
+
+    if( pad == 1 )
+    {
+        copy_short( p, zeros, group - first );
+        p += group - first;
+    }
+    copy_short( p, digits, first );
+    p += first;
+    digits += first;
+
+    for( ; units > 0 && digits + span <= end; --units )
+    {
+        memcpy( p, &word, 4 );
+        for( k = 0; k < span; k += 16 )
+            memcpy( p + length + k, digits + k, 16 );
+        p += length + group;
+        digits += group;
+    }
+
+    /*  The last few, exactly */
+    for( ; units > 0; --units )
+    {
+        copy_short( p, separator, length );
+        copy_short( p + length, digits, group );
+        p += length + group;
+        digits += group;
+    }
+
+    return( p - out );
+}
+
+
+#ifdef HAVE_X86_KERNELS
+
+/*
+ *  For each group size under 16 and each place [phase] in a unit that 16
+ *  bytes of output can start at: where each of their lanes takes its digit
+ *  from, counting from the first digit they hold (-128 for the separator),
+ *  which lanes are the separator, which digit of its unit that first one
+ *  is, and how many units on (and at what phase) the next 16 bytes start
+ */
+static __m128i shuffles[16][16];
+static __m128i separatorLanes[16][16];
+static unsigned char firstDigit[16][16];
+static unsigned char unitsOn[16][16];
+static unsigned char nextPhase[16][16];
+
+/*  Where load_short's lanes for [n] digits come from */
+static __m128i shortLanes[16];
+
+/*  2^32 / d, rounded up: x * it >> 32 is x / d for x under 2^24, d <= 16 */
+static uint64_t reciprocals[17];
+
+
+/*  Fill in the tables above */
+static void build_shuffles( void )
+{
+    char lanes[16];
+    char marks[16];
+    int group = 0;
+    int phase = 0;
+    int count = 0;
+    int j = 0;
+
+    for( group = 1; group < 16; ++group )
+    {
+        for( phase = 0; phase <= group; ++phase )
+        {
+            int base = ( phase < group ) ? phase : group;
+
+            for( j = 0; j < 16; ++j )
+            {
+                int unit = ( phase + j ) / ( group + 1 );
+                int position = ( phase + j ) % ( group + 1 );
+
+                lanes[j] = ( position == group ) ? -128 :
+                    unit * group + position - base;
+                marks[j] = ( position == group ) ? -1 : 0;
+            }
+
+            memcpy( &shuffles[group][phase], lanes, 16 );
+            memcpy( &separatorLanes[group][phase], marks, 16 );
+            firstDigit[group][phase] = base;
+            unitsOn[group][phase] = ( phase + 16 ) / ( group + 1 );
+            nextPhase[group][phase] = ( phase + 16 ) % ( group + 1 );
+        }
+    }
+
+    for( j = 1; j <= 16; ++j )
+        reciprocals[j] = ( ( 1ULL << 32 ) + j - 1 ) / j;
+
+    for( count = 0; count < 16; ++count )
+    {
+        int half = ( count >= 8 ) ? 8 : 4;
+
+        for( j = 0; j < 16; ++j )
+        {
+            lanes[j] = j;
+            if( count >= 4 && j >= half )
+                lanes[j] = ( j < count ) ? j + 2 * half - count : -128;
+        }
+        memcpy( &shortLanes[count], lanes, 16 );
+    }
+}
+
+
+/*  [x] / [d], without dividing when it can be helped */
+static inline size_t divide_small( size_t x, int d )
+{
+    if( x < ( 1 << 24 ) )
+        return( ( x * reciprocals[d] ) >> 32 );
+
+    return( x / d );
+}
+
+
+/*
+ *  The 16 bytes of output starting [phase] bytes into a unit, from the
+ *  digits in [source], the first of them [shift] lanes along
+ */
+__attribute__((target("ssse3")))
+static inline __m128i group_block( __m128i source, int group, int phase,
+        ptrdiff_t shift, __m128i separator )
+{
+    __m128i marks = separatorLanes[group][phase];
+    __m128i lanes = _mm_adds_epi8( shuffles[group][phase],
+            _mm_set1_epi8( (char)shift ) );
+    __m128i fill = _mm_or_si128( _mm_and_si128( marks, separator ),
+            _mm_andnot_si128( marks, _mm_set1_epi8( '0' ) ) );
+
+    /*  Lanes that took nothing are the separator's, or padding */
+    return( _mm_or_si128( _mm_shuffle_epi8( source, lanes ), _mm_and_si128(
+                    _mm_cmplt_epi8( lanes, _mm_setzero_si128() ), fill ) ) );
+}
+
+
+/*
+ *  Fewer than 16 digits, into the first lanes of a vector: the first and
+ *  last 8 (or 4) of them, put back in order by shortLanes[n]
+ */
+__attribute__((target("ssse3")))
+static inline __m128i load_short( const char *digits, size_t n )
+{
+    uint64_t low = 0;
+    uint64_t high = 0;
+    uint32_t front = 0;
+    uint32_t back = 0;
+
+    if( n >= 8 )
+    {
+        memcpy( &low, digits, 8 );
+        memcpy( &high, digits + n - 8, 8 );
+    }
+    else if( n >= 4 )
+    {
+        memcpy( &front, digits, 4 );
+        memcpy( &back, digits + n - 4, 4 );
+        low = front | (uint64_t)back << 32;
+    }
+    else
+        low = (unsigned char)digits[0] |
+            (uint64_t)(unsigned char)digits[n / 2] << 8 |
+            (uint64_t)(unsigned char)digits[n - 1] << 16;
+
+    return( _mm_shuffle_epi8( _mm_set_epi64x( high, low ), shortLanes[n] ) );
+}
+
+
+/*
+ *  The 16 bytes of output starting [phase] bytes into unit [unit], from the
+ *  [n] digits at [digits] behind [lead] zeros of padding (or from [few], if
+ *  there aren't 16 of them): 16 of the digits that are there, with the
+ *  lanes shifted to make up for where they start
+ */
+__attribute__((target("ssse3")))
+static inline __m128i group_at( const char *digits, size_t n, __m128i few,
+        size_t lead, int group, size_t unit, int phase, __m128i separator )
+{
+    ptrdiff_t start = (ptrdiff_t)( unit * group + firstDigit[group][phase] ) -
+        (ptrdiff_t)lead;
+    ptrdiff_t from = 0;
+
+    if( n < 16 )
+        return( group_block( few, group, phase, start, separator ) );
+
+    if( start > 0 )
+        from = ( start < (ptrdiff_t)n - 16 ) ? start : (ptrdiff_t)n - 16;
+
+    return( group_block( _mm_loadu_si128( (const __m128i *)( digits +
+                        from ) ), group, phase, start - from, separator ) );
+}
+
+
+/*  ------------------  group_ssse3 ---------------------------
+ *
+ *  group_scalar for one-byte separators and groups under 16, 16 bytes of
+ *  output at a time
+ */
+__attribute__((target("ssse3")))
+static size_t group_ssse3( char *out, const char *digits, size_t n,
+        int group, const char *separator, int length, int pad )
+{
+    const __m128i between = _mm_set1_epi8( *separator );
+    __m128i few = _mm_setzero_si128();
+    size_t units = 0;
+    size_t lead = 0;
+    size_t skip = 0;
+    size_t total = 0;
+    size_t unit = 0;
+    size_t o = 0;
+    int phase = 0;
+
+    if( length != 1 || group >= 16 )
+        return( group_scalar( out, digits, n, group, separator, length,
+                    pad ) );
+
+    units = divide_small( n + group - 1, group );
+    lead = units * group - n;
+    skip = ( pad == 1 ) ? 0 : lead;
+    total = units * ( group + 1 ) - 1 - skip;
+
+    if( n < 16 )
+        few = load_short( digits, n );
+
+    /*  From the end of the padding we're leaving off */
+    phase = skip;
+    for( o = 0; o + 16 <= total; o += 16 )
+    {
+        _mm_storeu_si128( (__m128i *)( out + o ), group_at( digits, n, few,
+                    lead, group, unit, phase, between ) );
+        unit += unitsOn[group][phase];
+        phase = nextPhase[group][phase];
+    }
+
+    if( o == total )
+        return( total );
+
+    /*  The last 16 bytes, over the end of the ones before; or, when there
+     *  aren't 16, all of them and some spill */
+    o = ( total >= 16 ) ? total - 16 : 0;
+    unit = divide_small( o + skip, group + 1 );
+    phase = o + skip - unit * ( group + 1 );
+    _mm_storeu_si128( (__m128i *)( out + o ), group_at( digits, n, few,
+                lead, group, unit, phase, between ) );
+
+    return( total );
+}
+
+#endif
+
+
+/*  ------------------  kernel selection    ---------------------------
+ *
+ *  done once, before main, like bitexpand's
+ */
+typedef size_t (*group_kernel)( char *, const char *, size_t, int,
+        const char *, int, int );
+
+static group_kernel groupKernel = group_scalar;
+
+__attribute__((constructor))
+static void select_group_kernel( void )
+{
+#ifdef HAVE_X86_KERNELS
+    const char *limit = getenv( "DEC2BIN_KERNEL" );
+
+    if( limit != NULL && ( strcmp( limit, "scalar" ) == 0 ||
+                strcmp( limit, "sse2" ) == 0 ) )
+        return;
+
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "ssse3" ) )
+    {
+        build_shuffles();
+        groupKernel = group_ssse3;
+    }
+#endif
+}
+
+
+size_t group_digits( char *out, const char *digits, size_t n, int group,
+        const char *separator, int length, int pad )
+{
+    if( n == 0 )
+        return( 0 );
+
+    return( groupKernel( out, digits, n, group, separator, length, pad ) );
+}
@@ -0,0 +1,34 @@
+/*******************************************************************************
+ * group.h      |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      Digit grouping for -s, --group and --sep: a digit string laid out in
+ *      groups of N, counted from its last digit, with a separator between
+ *      groups.  Nothing is decided per character.  Groups are copied at a
+ *      fixed stride, a vector at a time, and with an SSSE3 CPU and a
+ *      one-byte separator a shuffle lays out several groups per store.
+ ******************************************************************************/
+#ifndef DEC2BIN_GROUP_H
+#define DEC2BIN_GROUP_H
+
+#include <stddef.h>
+
+/*  Longest separator group_digits takes */
+#define GROUP_MAX_SEPARATOR 4
+
+/*  How far past its output group_digits may write */
+#define GROUP_SPILL 16
+
+
+/*
+ *  Write the [n] digits at [digits] to [out] in groups of [group] (1 to 64),
+ *  with the [length] bytes of [separator] (1 to GROUP_MAX_SEPARATOR) between
+ *  them.  With [pad], the first group is filled out with leading zeros.
+ *  Returns the length of the grouped digits; up to GROUP_SPILL bytes after
+ *  them may be written over too.
+ */
+size_t group_digits( char *out, const char *digits, size_t n, int group,
+        const char *separator, int length, int pad );
+
+#endif
@@ -0,0 +1,137 @@
+/*******************************************************************************
+ * ieee.c       |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      IEEE-754 bit patterns; see ieee.h
+ *
+ *  Notes:
+ *      Halves are rounded straight from the double's bits.  Going through
+ *      a float first would round twice, which now and then lands one unit
+ *      off; F16C only converts from floats, so it's no help here.
+ ******************************************************************************/
+#include <stdint.h>
+#include <string.h>
+
+#include "ieee.h"
+
+#if defined(__x86_64__)
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+
+/*  ----------------------  half_bits  -----------------------------------
+ *
+ *  [value] rounded to half precision.  The 53-bit significand is shifted
+ *  down to the 11 bits a half keeps (more, below the smallest normal), and
+ *  a carry out of the top just bumps the exponent, as it should.
+ */
+static uint16_t half_bits( double value )
+{
+    uint64_t d = 0;
+    uint64_t significand = 0;
+    uint64_t rest = 0;
+    uint64_t halfway = 0;
+    uint16_t sign = 0;
+    int exponent = 0;
+    int shift = 0;
+    uint64_t q = 0;
+
+    memcpy( &d, &value, sizeof( d ) );
+    sign = (uint16_t)( ( d >> 48 ) & 0x8000 );
+    exponent = (int)( ( d >> 52 ) & 0x7ff );
+    significand = d & ( ( 1ULL << 52 ) - 1 );
+
+    if( exponent == 0x7ff )     //  Infinity, or a NaN kept quiet
+        return( sign | 0x7c00 | ( ( significand != 0 ) ? 0x200 |
+                    ( significand >> 42 ) : 0 ) );
+    if( exponent == 0 )         //  Double subnormals are far below a half's
+        return( sign );
+
+    exponent -= 1023;
+    if( exponent > 15 )
+        return( sign | 0x7c00 );
+
+    significand |= 1ULL << 52;
+    shift = 42 + ( ( exponent < -14 ) ? -14 - exponent : 0 );
+    if( shift > 63 )
+        return( sign );
+
+    q = significand >> shift;
+    rest = significand & ( ( 1ULL << shift ) - 1 );
+    halfway = 1ULL << ( shift - 1 );
+    if( rest > halfway || ( rest == halfway && ( q & 1 ) ) )
+        ++q;
+
+    if( exponent >= -14 )
+        q += (uint64_t)( exponent + 14 ) << 10;
+    if( q >= 0x7c00 )
+        return( sign | 0x7c00 );
+
+    return( sign | (uint16_t)q );
+}
+
+
+double half_value( uint16_t bits )
+{
+    uint64_t d = (uint64_t)( bits & 0x8000 ) << 48;
+    uint64_t mantissa = bits & 0x3ff;
+    int exponent = ( bits >> 10 ) & 0x1f;
+    double value = 0;
+
+    if( exponent == 0 )         //  Zero or subnormal: mantissa * 2^-24
+    {
+        value = (double)mantissa * 5.9604644775390625e-08;
+        return( ( bits & 0x8000 ) ? -value : value );
+    }
+
+    if( exponent == 0x1f )
+        d |= 0x7ffULL << 52;
+    else
+        d |= (uint64_t)( exponent - 15 + 1023 ) << 52;
+    d |= mantissa << 42;
+
+    memcpy( &value, &d, sizeof( value ) );
+    return( value );
+}
+
+
+void ieee_bits( int bits, const double *values, uint64_t *out, size_t count )
+{
+    size_t i = 0;
+
+    if( bits == 64 )
+    {
+        memcpy( out, values, count * sizeof( *out ) );
+        return;
+    }
+
+    if( bits == 16 )
+    {
+        for( i = 0; i < count; ++i )
+            out[i] = half_bits( values[i] );
+        return;
+    }
+
+#ifdef HAVE_X86_KERNELS
+    /*  Two doubles to two floats, widened to two 64-bit patterns */
+    for( ; i + 2 <= count; i += 2 )
+    {
+        __m128 pair = _mm_cvtpd_ps( _mm_loadu_pd( values + i ) );
+        __m128i wide = _mm_unpacklo_epi32( _mm_castps_si128( pair ),
+                _mm_setzero_si128() );
+
+        _mm_storeu_si128( (__m128i *)( out + i ), wide );
+    }
+#endif
+
+    for( ; i < count; ++i )
+    {
+        float single = (float)values[i];
+        uint32_t pattern = 0;
+
+        memcpy( &pattern, &single, sizeof( pattern ) );
+        out[i] = pattern;
+    }
+}
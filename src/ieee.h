@@ -0,0 +1,25 @@
+/*******************************************************************************
+ * ieee.h       |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      IEEE-754 bit patterns for --ieee.  Doubles are rounded to half,
+ *      single or double precision a whole array at a time, two to a vector
+ *      for singles, and handed back as unsigned integers.
+ ******************************************************************************/
+#ifndef DEC2BIN_IEEE_H
+#define DEC2BIN_IEEE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ *  The bit patterns of [count] doubles from [values], rounded to the
+ *  nearest (ties to even) number of [bits] bits (16, 32 or 64), into [out]
+ */
+void ieee_bits( int bits, const double *values, uint64_t *out, size_t count );
+
+/*  The value of the half-precision bit pattern [bits], as a double */
+double half_value( uint16_t bits );
+
+#endif
@@ -0,0 +1,2060 @@
+/*******************************************************************************
+ * libdec2bin.c |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      Record formatting and batch conversion; see libdec2bin.h
+ *
+ *  Notes:
+ *      Nothing in here keeps state between calls.  The only things shared
+ *      are the kernels: bitexpand.c (text), parse.c (integers and -r digits)
+ *      and group.c (--group) each pick theirs in a constructor, from the CPU
+ *      and DEC2BIN_KERNEL, when the library loads, and keep it in a global
+ *      that is only read after that.  So does bitstats.c in the program.
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+
+#include "libdec2bin.h"
+#include "convert.h"
+#include "bignum.h"
+#include "bitexpand.h"
+#include "parse.h"
+#include "ieee.h"
+#include "group.h"
+
+/*  Longest label plus value text mode prints for one character */
+#define TEXT_FIELD_MAX 42
+
+/*  Longest dump row: a 16-digit offset, spaced bits and the characters */
+#define DUMP_ROW_MAX ( 16 + 2 + D2B_DUMP_ROW * 9 + 2 + D2B_DUMP_ROW + 1 )
+
+
+void d2b_options_init( struct d2b_options *options )
+{
+    memset( options, 0, sizeof( *options ) );
+    options->bigEndian = 1;
+}
+
+
+int d2b_conversions( const struct d2b_options *options )
+{
+    return( options->binary + options->decimal + options->hex +
+            options->hexCaps + options->preciseHex + options->preciseHexCaps +
+            options->octal );
+}
+
+
+/*  Copy [n] bytes to [p] and step past them */
+static char *put( char *p, const char *s, size_t n )
+{
+    memcpy( p, s, n );
+    return( p + n );
+}
+
+
+/*  What goes between groups of digits: options->separator, or a space */
+static const char *separator_of( const struct d2b_options *options,
+        int *length )
+{
+    if( options->separator[0] == '\0' )
+    {
+        *length = 1;
+        return( " " );
+    }
+
+    *length = strnlen( options->separator, D2B_SEPARATOR_MAX );
+    return( options->separator );
+}
+
+
+/*  A CSV field with a comma between its groups has to be quoted */
+static int quote_groups( const struct d2b_options *options,
+        const char *separator, int length )
+{
+    return( options->layout == D2B_LAYOUT_CSV &&
+            memchr( separator, ',', length ) != NULL );
+}
+
+
+/*  A newline at the end for readability, or the end of a JSON string */
+static char *put_number_end( const struct d2b_options *options, char *p )
+{
+    if( options->layout == D2B_LAYOUT_LINES )
+        *p++ = '\n';
+    else if( options->layout == D2B_LAYOUT_NDJSON )
+        *p++ = '"';
+
+    return( p );
+}
+
+
+/*  ----------------------  put_number  ----------------------------------
+ *
+ *  one line of a record: the number string, in groups if asked for.
+ *  Binary, hex and octal fill their first group out with zeros; decimal
+ *  doesn't (its sign stays in front), and the precise hexes aren't digit
+ *  strings, so they're never grouped.  Grouping can scribble a little past
+ *  the digits, which every record has the room for.
+ */
+static char *put_number( const struct d2b_options *options, char *p,
+        int radix, const char *s, size_t arraySize )
+{
+    const char *separator = NULL;
+    int length = 0;
+    int quoted = 0;
+
+    if( options->sections <= 0 || radix == D2B_RADIX_PRECISE_HEX ||
+            radix == D2B_RADIX_PRECISE_HEX_CAPS )
+        return( put_number_end( options, put( p, s, arraySize ) ) );
+
+    separator = separator_of( options, &length );
+    quoted = quote_groups( options, separator, length );
+
+    if( quoted == 1 )
+        *p++ = '"';
+    if( arraySize > 0 && s[0] == '-' )
+    {
+        *p++ = *s++;
+        --arraySize;
+    }
+    p += group_digits( p, s, arraySize, options->sections, separator,
+            length, ( radix != D2B_RADIX_DECIMAL ) );
+    if( quoted == 1 )
+        *p++ = '"';
+
+    return( put_number_end( options, p ) );
+}
+
+
+/*  Each output type's -v label and its column name in --format */
+static const char *labels[D2B_RADIX_COUNT] = {
+    "DEC\t", "HEX\t", "HEX\t", "0xHEX\t", "0xHEX\t", "OCT\t", "BIN\t"
+};
+static const char *columns[D2B_RADIX_COUNT] = {
+    "decimal", "hex", "hex_caps", "precise_hex", "precise_hex_caps", "octal",
+    "binary"
+};
+
+
+/*
+ *  Verbose number mode labels each line with its output type; in columns,
+ *  this starts the type's field instead
+ */
+static char *put_label( const struct d2b_options *options, char *p,
+        int radix )
+{
+    switch( options->layout )
+    {
+        case D2B_LAYOUT_TSV:
+            *p++ = '\t';
+            break;
+        case D2B_LAYOUT_CSV:
+            *p++ = ',';
+            break;
+        case D2B_LAYOUT_NDJSON:
+            *p++ = ',';
+            *p++ = '"';
+            p = put( p, columns[radix], strlen( columns[radix] ) );
+            p = put( p, "\":\"", 3 );
+            break;
+        default:
+            if( options->verbose == 1 )
+                p = put( p, labels[radix], strlen( labels[radix] ) );
+            break;
+    }
+
+    return( p );
+}
+
+
+/*  The end of a record in columns; lines have already ended */
+static char *put_end( const struct d2b_options *options, char *p )
+{
+    if( options->layout == D2B_LAYOUT_NDJSON )
+        *p++ = '}';
+    if( options->layout != D2B_LAYOUT_LINES )
+        *p++ = '\n';
+
+    return( p );
+}
+
+
+/*  One character of the input column, escaped as [layout] needs */
+static char *put_escaped( int layout, char *p, char c )
+{
+    static const char hexDigits[] = "0123456789abcdef";
+
+    if( layout == D2B_LAYOUT_TSV )
+    {
+        switch( c )
+        {
+            case '\t':  return( put( p, "\\t", 2 ) );
+            case '\n':  return( put( p, "\\n", 2 ) );
+            case '\r':  return( put( p, "\\r", 2 ) );
+            case '\\':  return( put( p, "\\\\", 2 ) );
+        }
+    }
+    else if( layout == D2B_LAYOUT_CSV )
+    {
+        if( c == '"' )
+            return( put( p, "\"\"", 2 ) );
+    }
+    else if( c == '"' || c == '\\' )
+    {
+        *p++ = '\\';
+    }
+    else if( (unsigned char)c < 0x20 )
+    {
+        p = put( p, "\\u00", 4 );
+        *p++ = hexDigits[ ( c >> 4 ) & 15 ];
+        *p++ = hexDigits[ c & 15 ];
+        return( p );
+    }
+
+    *p++ = c;
+    return( p );
+}
+
+
+size_t d2b_input_max( size_t length )
+{
+    return( 6 * length + 16 );
+}
+
+
+/*  ----------------------  d2b_format_input  ----------------------------
+ *
+ *  the first column.  CSV only quotes a field that has a comma, quote or
+ *  line break in it, as RFC 4180 has it.
+ */
+size_t d2b_format_input( const struct d2b_options *options, const char *input,
+        size_t length, int escape, char *out )
+{
+    char *p = out;
+    int quoted = 0;
+    size_t i = 0;
+
+    if( options->layout == D2B_LAYOUT_NDJSON )
+        p = put( p, "{\"input\":\"", 10 );
+    else if( options->layout == D2B_LAYOUT_CSV && escape == 1 )
+    {
+        for( i = 0; i < length && quoted == 0; ++i )
+            quoted = ( input[i] == ',' || input[i] == '"' ||
+                    input[i] == '\n' || input[i] == '\r' );
+        if( quoted == 1 )
+            *p++ = '"';
+    }
+
+    if( escape == 1 )
+        for( i = 0; i < length; ++i )
+            p = put_escaped( options->layout, p, input[i] );
+    else
+        p = put( p, input, length );
+
+    if( options->layout == D2B_LAYOUT_NDJSON || quoted == 1 )
+        *p++ = '"';
+
+    return( p - out );
+}
+
+
+size_t d2b_format_header( const struct d2b_options *options, char *out )
+{
+    const int enabled[D2B_RADIX_COUNT] = {
+        options->decimal, options->hex, options->hexCaps,
+        options->preciseHex, options->preciseHexCaps, options->octal,
+        options->binary };
+    char *p = out;
+    int radix = 0;
+
+    if( options->layout != D2B_LAYOUT_TSV && options->layout != D2B_LAYOUT_CSV )
+        return( 0 );
+
+    p = put( p, "input", 5 );
+    for( radix = 0; radix < D2B_RADIX_COUNT; ++radix )
+    {
+        if( enabled[radix] == 1 )
+        {
+            p = put_label( options, p, radix );
+            p = put( p, columns[radix], strlen( columns[radix] ) );
+        }
+    }
+
+    return( put_end( options, p ) - out );
+}
+
+
+/*  expand_integer's answer for a number past D2B_EXPANDED_MAX digits */
+#define EXPANDED_TOO_LONG ( (size_t)-1 )
+
+
+/*  ----------------------  expand_integer  -------------------------------
+ *
+ *  the digits of a whole number written with a decimal point or exponent
+ *  (1.5e20, 18446744073709551616.0), leading zeros dropped, into [out] if
+ *  it isn't NULL.  Returns how many there are, 0 if [string] isn't a whole
+ *  number in that form, or EXPANDED_TOO_LONG if it would need more than
+ *  D2B_EXPANDED_MAX.
+ */
+static size_t expand_integer( const char *string, char *out )
+{
+    const char *whole = string;
+    const char *fraction = NULL;
+    size_t wholeLength = 0;
+    size_t fractionLength = 0;
+    size_t count = 0;
+    size_t index = 0;
+    long shift = 0;
+    long exponent = 0;
+    int negative = 0;
+    int expDigits = 0;
+    int tooLong = 0;
+    const char *p = NULL;
+
+    while( isspace( (unsigned char)*whole ) )
+        ++whole;
+    if( *whole == '+' )
+        ++whole;
+
+    while( isdigit( (unsigned char)whole[wholeLength] ) )
+        ++wholeLength;
+    p = whole + wholeLength;
+    if( *p == '.' )
+    {
+        fraction = ++p;
+        while( isdigit( (unsigned char)fraction[fractionLength] ) )
+            ++fractionLength;
+        p += fractionLength;
+    }
+    if( wholeLength + fractionLength == 0 )
+        return(0);
+
+    if( *p == 'e' || *p == 'E' )
+    {
+        ++p;
+        if( *p == '+' || *p == '-' )
+            negative = ( *p++ == '-' );
+        if( ! isdigit( (unsigned char)*p ) )
+            return(0);
+        while( *p == '0' )
+            ++p;
+        for( ; isdigit( (unsigned char)*p ); ++p )
+        {
+            if( ++expDigits > 9 )       //  Far past D2B_EXPANDED_MAX
+                tooLong = 1;
+            else
+                exponent = exponent * 10 + ( *p - '0' );
+        }
+    }
+    if( *p != '\0' && ! isspace( (unsigned char)*p ) )
+        return(0);
+
+    /*  Ten exponent digits: far too many digits, or shifted all away */
+    if( tooLong == 1 )
+        return( negative == 1 ? 0 : EXPANDED_TOO_LONG );
+
+    /*  The mantissa's digits are whole and fraction run together */
+    shift = ( negative == 1 ? -exponent : exponent ) - (long)fractionLength;
+    count = wholeLength + fractionLength;
+    if( shift < 0 )
+    {
+        /*  Whatever falls off the end has to be zeros */
+        for( ; shift < 0 && count > 0; ++shift, --count )
+        {
+            if( ( count > wholeLength ? fraction[count - wholeLength - 1] :
+                        whole[count - 1] ) != '0' )
+                return(0);
+        }
+    }
+
+    /*  Leading zeros count for nothing */
+    while( index < count && ( index < wholeLength ? whole[index] :
+                fraction[index - wholeLength] ) == '0' )
+        ++index;
+    if( index == count )
+        return(0);                  //  0, which never needs a bignum
+
+    if( count - index + (size_t)shift > D2B_EXPANDED_MAX )
+        return( EXPANDED_TOO_LONG );
+
+    if( out != NULL )
+    {
+        for( ; index < count; ++index )
+            *out++ = ( index < wholeLength ) ? whole[index] :
+                fraction[index - wholeLength];
+        memset( out, '0', shift );
+    }
+
+    return( count - index + shift );
+}
+
+
+int d2b_parse( const char *string, uint64_t *value, double *real )
+{
+    const char *digits = string;
+    char *end = NULL;
+    uint64_t number = 0;
+    size_t length = 0;
+    int overflow = 0;
+
+    /*  Leading whitespace and a plus sign have always been let through */
+    while( isspace( (unsigned char)*digits ) )
+        ++digits;
+    if( *digits == '+' )
+        ++digits;
+
+    /*  Plain integers, by far the most common, never see a double */
+    length = parse_decimal( digits, &number, &overflow );
+    if( length > 0 && ( digits[length] == '\0' ||
+                isspace( (unsigned char)digits[length] ) ) )
+    {
+        if( overflow == 1 )
+        {
+            *real = strtod( string, NULL );
+            return( D2B_BIG );
+        }
+
+        *value = number;
+        *real = (double)number;
+        return( D2B_NUMBER );
+    }
+
+    /*  Not a plain integer (1.5, 2e9 and so on), so go with the double */
+    *real = strtod( string, &end );
+    if( end == string || *real != *real ||
+            ( *end != '\0' && ! isspace( (unsigned char)*end ) ) )
+        return( D2B_INVALID );
+    if( *real < 0 )
+        return( D2B_NEGATIVE );
+
+    /*
+     *  Past 2^64 the double can't be trusted to the last digit, so a whole
+     *  number goes the bignum's way, digits and all.  Anything else
+     *  (18446744073709551616.5, inf) has no integer to convert.
+     */
+    if( *real >= 18446744073709551616.0 )
+    {
+        char expanded[MAX_DECIMAL_DIGITS + 1];
+
+        length = expand_integer( string, NULL );
+        if( length == 0 )
+            return( D2B_RANGE );
+        if( length == EXPANDED_TOO_LONG )
+            return( D2B_HUGE );
+        if( length > MAX_DECIMAL_DIGITS )
+            return( D2B_BIG );
+
+        /*  The double rounded up; the digits may still fit */
+        expand_integer( string, expanded );
+        expanded[length] = '\0';
+        parse_decimal( expanded, &number, &overflow );
+        if( overflow == 1 )
+            return( D2B_BIG );
+        *value = number;
+        return( D2B_NUMBER );
+    }
+
+    *value = (uint64_t)*real;
+    return( D2B_NUMBER );
+}
+
+
+int d2b_parse_real( const char *string, double *value )
+{
+    char *end = NULL;
+    double number = 0;
+    size_t length = parse_real( string, &number );
+
+    /*  Exponents, long fractions, inf, nan and hex floats */
+    if( length == 0 || ( string[length] != '\0' &&
+                ! isspace( (unsigned char)string[length] ) ) )
+    {
+        number = strtod( string, &end );
+        if( end == string || ( *end != '\0' &&
+                    ! isspace( (unsigned char)*end ) ) )
+            return( D2B_INVALID );
+    }
+
+    *value = number;
+    return( D2B_NUMBER );
+}
+
+
+/*  Monotonic nanoseconds, for d2b_format_u64_timed */
+static uint64_t clock_ns( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return( (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec );
+}
+
+
+/*
+ *  If we're being timed, add the time since *mark to the convert or format
+ *  total of [radix] and start the next lap
+ */
+static void lap( struct d2b_timing *timing, int radix, int formatting,
+        uint64_t *mark )
+{
+    if( timing != NULL )
+    {
+        uint64_t now = clock_ns();
+
+        if( formatting == 0 )
+            timing->convertNanos[radix] += now - *mark;
+        else
+        {
+            timing->formatNanos[radix] += now - *mark;
+            ++timing->count[radix];
+        }
+        *mark = now;
+    }
+}
+
+
+size_t d2b_format_u64( const struct d2b_options *options, uint64_t value,
+        double real, char *out )
+{
+    return( d2b_format_u64_timed( options, value, real, out, NULL ) );
+}
+
+
+/*  ----------------------  d2b_format_u64_timed  ------------------------
+ *
+ *  every output type is spelled out from the whole 64-bit value by the
+ *  table-driven writers in convert.c, one after another in the same scratch
+ *  buffer, and laid out straight into the record.
+ *
+ *  With a width, every radix is zero-padded to the digits the widest
+ *  number of that many bits needs, so all records come out the same length.
+ *  A number that needs more bits is the caller's to refuse (d2b_fits_width);
+ *  past here it only keeps the record from growing.
+ */
+size_t d2b_format_u64_timed( const struct d2b_options *options,
+        uint64_t value, double real, char *out, struct d2b_timing *timing )
+{
+    char s[MAX_BINARY_DIGITS + 8];  //  Binary is the longest we print
+    char *p = out;
+    int n = 0;
+    uint64_t mark = ( timing != NULL ) ? clock_ns() : 0;
+    int width = options->width;
+    int hexDigits = 0;
+    int octDigits = 0;
+    int decDigits = 0;
+
+    if( width > 0 )
+    {
+        if( width < MAX_BINARY_DIGITS )
+            value &= ( 1ULL << width ) - 1;
+        hexDigits = ( width + 3 ) / 4;
+        octDigits = ( width + 2 ) / 3;
+        decDigits = width * 30103 / 100000 + 1;     //  Digits in 2^width - 1
+    }
+
+    if( options->decimal == 1 )     //  Decimal output (for whatever reason)
+    {
+        n = u64_to_decimal( s, value, decDigits );
+        lap( timing, D2B_RADIX_DECIMAL, 0, &mark );
+        p = put_label( options, p, D2B_RADIX_DECIMAL );
+        p = put_number( options, p, D2B_RADIX_DECIMAL, s, n );
+        lap( timing, D2B_RADIX_DECIMAL, 1, &mark );
+    }
+
+    if( options->hex == 1 )         //  Regular hex (non-capital)
+    {
+        n = u64_to_hex( s, value, hexDigits, 0 );
+        lap( timing, D2B_RADIX_HEX, 0, &mark );
+        p = put_label( options, p, D2B_RADIX_HEX );
+        p = put_number( options, p, D2B_RADIX_HEX, s, n );
+        lap( timing, D2B_RADIX_HEX, 1, &mark );
+    }
+
+    if( options->hexCaps == 1 )     //  Regular hex (captial letters)
+    {
+        n = u64_to_hex( s, value, hexDigits, 1 );
+        lap( timing, D2B_RADIX_HEX_CAPS, 0, &mark );
+        p = put_label( options, p, D2B_RADIX_HEX_CAPS );
+        p = put_number( options, p, D2B_RADIX_HEX_CAPS, s, n );
+        lap( timing, D2B_RADIX_HEX_CAPS, 1, &mark );
+    }
+
+    if( options->preciseHex == 1 )  //  SUPER HEX (non-caps)
+    {
+        n = snprintf( s, sizeof( s ), "%a", real );
+        lap( timing, D2B_RADIX_PRECISE_HEX, 0, &mark );
+        p = put_label( options, p, D2B_RADIX_PRECISE_HEX );
+        p = put_number( options, p, D2B_RADIX_PRECISE_HEX, s, n );
+        lap( timing, D2B_RADIX_PRECISE_HEX, 1, &mark );
+    }
+
+    if( options->preciseHexCaps == 1 )  //  SUPER HEX (caps)
+    {
+        n = snprintf( s, sizeof( s ), "%A", real );
+        lap( timing, D2B_RADIX_PRECISE_HEX_CAPS, 0, &mark );
+        p = put_label( options, p, D2B_RADIX_PRECISE_HEX_CAPS );
+        p = put_number( options, p, D2B_RADIX_PRECISE_HEX_CAPS, s, n );
+        lap( timing, D2B_RADIX_PRECISE_HEX_CAPS, 1, &mark );
+    }
+
+    if( options->octal == 1 )       //  Octal
+    {
+        n = u64_to_octal( s, value, octDigits );
+        lap( timing, D2B_RADIX_OCTAL, 0, &mark );
+        p = put_label( options, p, D2B_RADIX_OCTAL );
+        p = put_number( options, p, D2B_RADIX_OCTAL, s, n );
+        lap( timing, D2B_RADIX_OCTAL, 1, &mark );
+    }
+
+    if( options->binary == 1 )
+    {
+        n = u64_to_binary( s, value, width, options->bigEndian );
+        lap( timing, D2B_RADIX_BINARY, 0, &mark );
+        p = put_label( options, p, D2B_RADIX_BINARY );
+        p = put_number( options, p, D2B_RADIX_BINARY, s, n );
+        lap( timing, D2B_RADIX_BINARY, 1, &mark );
+    }
+
+    return( put_end( options, p ) - out );
+}
+
+
+int d2b_fits_width( const struct d2b_options *options, uint64_t value )
+{
+    return( options->width == 0 || options->width >= MAX_BINARY_DIGITS ||
+            ( value >> options->width ) == 0 );
+}
+
+
+size_t d2b_record_size( const struct d2b_options *options )
+{
+    char record[D2B_RECORD_MAX];
+
+    if( options->width == 0 || options->preciseHex == 1 ||
+            options->preciseHexCaps == 1 ||
+            options->layout != D2B_LAYOUT_LINES )
+        return( 0 );
+
+    return( d2b_format_u64( options, 0, 0, record ) );
+}
+
+
+/*
+ *  A digit is a bit over 3.3 bits, and a line in groups of one can have a
+ *  whole separator after every digit, plus a padded first group, quotes,
+ *  label and all
+ */
+size_t d2b_big_max( size_t length )
+{
+    return( 7 * ( ( 1 + D2B_SEPARATOR_MAX ) * ( 4 * length + 64 ) + 16 +
+                D2B_GROUP_MAX ) );
+}
+
+
+size_t d2b_big_digits( const char *string )
+{
+    const char *digits = string;
+    size_t length = 0;
+
+    while( isspace( (unsigned char)*digits ) || *digits == '+' )
+        ++digits;
+    while( isdigit( (unsigned char)digits[length] ) )
+        ++length;
+
+    if( digits[length] == '\0' || isspace( (unsigned char)digits[length] ) )
+        return( length );
+    return( expand_integer( string, NULL ) );
+}
+
+
+/*
+ *  Cache slots start with the number whose record they hold and the
+ *  record's length; the first slot of a pair also says which of the two
+ *  goes next
+ */
+#define CACHE_HEAD 16
+#define CACHE_LENGTH 8
+#define CACHE_OLDER 12
+
+/*  Slack for the precise hexes, whose length isn't up to the number */
+#define CACHE_PRECISE_SLACK 32
+
+struct d2b_cache
+{
+    struct d2b_options options;
+    unsigned char *slots;       //  [slotCount] of [slotSize] bytes, in pairs
+    size_t slotSize;            //  Whole cache lines
+    size_t slotCount;           //  A power of two, 2 at least
+    int shift;                  //  64 minus the bits of a pair's index
+    int precise;                //  Records depend on the double, too
+    uint64_t hits;
+    uint64_t misses;
+};
+
+
+/*  ----------------------  d2b_cache_new  -------------------------------
+ *
+ *  every slot is big enough for the longest record the options make,
+ *  which is that of the biggest number (the precise hexes aside)
+ */
+struct d2b_cache *d2b_cache_new( const struct d2b_options *options,
+        size_t bytes )
+{
+    struct d2b_cache *cache = malloc( sizeof( *cache ) );
+    char record[D2B_RECORD_MAX];
+    size_t longest = 0;
+
+    if( cache == NULL )
+        return( NULL );
+
+    cache->options = *options;
+    cache->precise = ( options->preciseHex == 1 ||
+            options->preciseHexCaps == 1 );
+    longest = d2b_format_u64( options, UINT64_MAX, (double)UINT64_MAX,
+            record ) + cache->precise * 2 * CACHE_PRECISE_SLACK;
+    cache->slotSize = ( CACHE_HEAD + longest + 63 ) & ~(size_t)63;
+
+    /*  As many slots as fit, rounded down to a power of two */
+    cache->slotCount = 2;
+    cache->shift = 64;
+    while( cache->slotCount * 2 * cache->slotSize <= bytes )
+    {
+        cache->slotCount *= 2;
+        --cache->shift;
+    }
+
+    cache->slots = NULL;
+    if( cache->slotCount * cache->slotSize <= bytes )
+        cache->slots = aligned_alloc( 64, cache->slotCount *
+                cache->slotSize );
+    if( cache->slots == NULL )
+    {
+        free( cache );
+        return( NULL );
+    }
+
+    /*  A length of 0 marks an empty slot */
+    memset( cache->slots, 0, cache->slotCount * cache->slotSize );
+    cache->hits = 0;
+    cache->misses = 0;
+
+    return( cache );
+}
+
+
+void d2b_cache_free( struct d2b_cache *cache )
+{
+    if( cache != NULL )
+    {
+        free( cache->slots );
+        free( cache );
+    }
+}
+
+
+/*  ----------------------  d2b_cache_format  ----------------------------
+ *
+ *  a number can go in either slot of one pair, so two numbers that hash
+ *  alike can both stay.  A miss bumps whichever of the pair was used less
+ *  recently.
+ */
+size_t d2b_cache_format( struct d2b_cache *cache, uint64_t value,
+        double real, char *out, struct d2b_timing *timing )
+{
+    unsigned char *pair = cache->slots;
+    unsigned char *slot = NULL;
+    uint64_t held = 0;
+    uint32_t length = 0;
+    size_t n = 0;
+    int way = 0;
+
+    /*  1.5 and 1 are both 1, but their precise hexes aren't the same */
+    if( cache->precise == 1 && real != (double)value )
+        return( d2b_format_u64_timed( &cache->options, value, real, out,
+                    timing ) );
+
+    /*  Fibonacci hashing: the top bits of the product pick the pair */
+    if( cache->shift < 64 )
+        pair += ( ( value * 0x9e3779b97f4a7c15ULL ) >> cache->shift ) * 2 *
+            cache->slotSize;
+
+    for( way = 0; way < 2; ++way )
+    {
+        slot = pair + way * cache->slotSize;
+        memcpy( &held, slot, sizeof( held ) );
+        memcpy( &length, slot + CACHE_LENGTH, sizeof( length ) );
+        if( length != 0 && held == value )
+        {
+            ++cache->hits;
+            pair[CACHE_OLDER] = !way;
+            memcpy( out, slot + CACHE_HEAD, length );
+            return( length );
+        }
+    }
+
+    ++cache->misses;
+    n = d2b_format_u64_timed( &cache->options, value, real, out, timing );
+
+    if( CACHE_HEAD + n <= cache->slotSize )
+    {
+        way = pair[CACHE_OLDER];
+        slot = pair + way * cache->slotSize;
+        length = n;
+        memcpy( slot, &value, sizeof( value ) );
+        memcpy( slot + CACHE_LENGTH, &length, sizeof( length ) );
+        memcpy( slot + CACHE_HEAD, out, n );
+        pair[CACHE_OLDER] = !way;
+    }
+
+    return( n );
+}
+
+
+void d2b_cache_counts( struct d2b_cache *cache, uint64_t *hits,
+        uint64_t *misses )
+{
+    *hits = cache->hits;
+    *misses = cache->misses;
+    cache->hits = 0;
+    cache->misses = 0;
+}
+
+
+/*  ----------------------  d2b_format_big  ------------------------------
+ *
+ *  same job as d2b_format_u64, for integers past 64 bits.  The digits are
+ *  converted to limbs once and the writers read the limbs directly.
+ */
+size_t d2b_format_big( const struct d2b_options *options, const char *string,
+        double real, char *out )
+{
+    struct bignum number;
+    const char *digits = string;
+    char *expanded = NULL;
+    size_t length = 0;
+    char *p = out;
+
+    /*  A fixed width is never past 64 bits, so this can't fit one */
+    if( options->width > 0 )
+        return( D2B_FAILED );
+
+    /*  strtoull let through leading whitespace and a plus sign */
+    while( isspace( (unsigned char)*digits ) || *digits == '+' )
+        ++digits;
+    while( isdigit( (unsigned char)digits[length] ) )
+        ++length;
+
+    /*  1e20 and the like, written out in full */
+    if( digits[length] != '\0' && ! isspace( (unsigned char)digits[length] ) )
+    {
+        length = expand_integer( string, NULL );
+        expanded = malloc( length + 1 );
+        if( expanded == NULL )
+            return( D2B_FAILED );
+        expand_integer( string, expanded );
+        digits = expanded;
+    }
+
+    if( bignum_from_decimal( &number, digits, length ) == 1 )
+    {
+        free( expanded );
+        return( D2B_FAILED );
+    }
+
+
+    /*  Binary is the longest of our outputs, so it sizes the buffer */
+    char *s = malloc( bignum_bit_length( &number ) + 64 );
+    if( s == NULL )
+    {
+        free( expanded );
+        bignum_free( &number );
+        return( D2B_FAILED );
+    }
+
+    if( options->decimal == 1 )     //  The digits are already decimal
+    {
+        while( length > 1 && *digits == '0' )
+        {
+            ++digits;
+            --length;
+        }
+        p = put_label( options, p, D2B_RADIX_DECIMAL );
+        p = put_number( options, p, D2B_RADIX_DECIMAL, digits, length );
+    }
+
+    if( options->hex == 1 )
+    {
+        p = put_label( options, p, D2B_RADIX_HEX );
+        p = put_number( options, p, D2B_RADIX_HEX, s,
+                bignum_to_hex( s, &number, 0 ) );
+    }
+
+    if( options->hexCaps == 1 )
+    {
+        p = put_label( options, p, D2B_RADIX_HEX_CAPS );
+        p = put_number( options, p, D2B_RADIX_HEX_CAPS, s,
+                bignum_to_hex( s, &number, 1 ) );
+    }
+
+    if( options->preciseHex == 1 )
+    {
+        p = put_label( options, p, D2B_RADIX_PRECISE_HEX );
+        p = put_number( options, p, D2B_RADIX_PRECISE_HEX, s,
+                sprintf( s, "%a", real ) );
+    }
+
+    if( options->preciseHexCaps == 1 )
+    {
+        p = put_label( options, p, D2B_RADIX_PRECISE_HEX_CAPS );
+        p = put_number( options, p, D2B_RADIX_PRECISE_HEX_CAPS, s,
+                sprintf( s, "%A", real ) );
+    }
+
+    if( options->octal == 1 )
+    {
+        p = put_label( options, p, D2B_RADIX_OCTAL );
+        p = put_number( options, p, D2B_RADIX_OCTAL, s,
+                bignum_to_octal( s, &number ) );
+    }
+
+    if( options->binary == 1 )
+    {
+        p = put_label( options, p, D2B_RADIX_BINARY );
+        p = put_number( options, p, D2B_RADIX_BINARY, s,
+                bignum_to_binary( s, &number, options->bigEndian ) );
+    }
+
+    free( s );
+    free( expanded );
+    bignum_free( &number );
+
+    return( put_end( options, p ) - out );
+}
+
+
+/*  A hex digit is four bits, and four bits never make two decimal digits */
+size_t d2b_reverse_max( size_t length )
+{
+    return( length * 4 / 3 + MAX_DECIMAL_DIGITS + 2 );
+}
+
+
+/*  ----------------------  d2b_format_reverse  --------------------------
+ *
+ *  the way back: binary, hex or octal to decimal.  Anything that fits in
+ *  64 bits never leaves the parser; longer numbers go through a bignum.
+ */
+size_t d2b_format_reverse( const struct d2b_options *options, int radix,
+        const char *string, char *out )
+{
+    struct bignum number;
+    uint64_t value = 0;
+    size_t length = 0;
+    int overflow = 0;
+    int bits = 1;
+    int bigEndian = 1;
+    char *p = out;
+
+    if( radix == D2B_RADIX_BINARY )
+    {
+        bigEndian = options->bigEndian;
+        length = parse_binary( string, bigEndian, &value, &overflow );
+    }
+    else
+    {
+        bits = ( radix == D2B_RADIX_OCTAL ) ? 3 : 4;
+        length = parse_digits( string, bits, &value, &overflow );
+    }
+
+    if( length == 0 || string[length] != '\0' )
+        return( 0 );
+
+    if( overflow == 0 )
+        p += u64_to_decimal( p, value, 0 );
+    else
+    {
+        if( bignum_from_digits( &number, string, length, bits,
+                    bigEndian ) == 1 )
+            return( D2B_FAILED );
+
+        length = bignum_to_decimal( p, &number );
+        bignum_free( &number );
+        if( length == 0 )
+            return( D2B_FAILED );
+        p += length;
+    }
+
+    *p++ = '\n';
+    return( p - out );
+}
+
+
+size_t d2b_text_max( const struct d2b_options *options, size_t length )
+{
+    size_t perChar = d2b_conversions( options ) *
+        ( TEXT_FIELD_MAX + options->sections + 1 ) + 1;
+
+    /*  Columns have the character itself and a name for every field */
+    if( options->layout != D2B_LAYOUT_LINES )
+        perChar += d2b_input_max( 1 ) + d2b_conversions( options ) * 24;
+
+    return( length * perChar + EXPAND_SLACK );
+}
+
+
+/*  One text mode field, followed by whatever separates fields */
+static char *put_text_field( const struct d2b_options *options, char *p,
+        char c, const char *label, const char *s, size_t n )
+{
+    if( options->verbose == 1 )
+    {
+        *p++ = c;
+        p = put( p, label, strlen( label ) );
+    }
+    p = put( p, s, n );
+
+    /*  Check if the user wants to print lines between each char */
+    if( options->lineSpacing == 1 )
+        *p++ = '\n';
+    else if( options->sections != 0 )   //  User wants 'sections' instead
+    {
+        memset( p, ' ', options->sections );
+        p += options->sections;
+    }
+
+    return( p );
+}
+
+
+/*
+ *  A text mode character in columns: the character, then its value in the
+ *  same digits as lines get, in the order of the other layouts.  -s spaces
+ *  characters apart in lines, so it's no use here.
+ */
+static char *put_text_record( const struct d2b_options *options, char *p,
+        char c )
+{
+    struct d2b_options plain = *options;
+    unsigned char value = c;
+    char s[32];
+
+    plain.sections = 0;
+    p += d2b_format_input( &plain, &c, 1, 1, p );
+
+    if( options->decimal == 1 )
+    {
+        p = put_label( &plain, p, D2B_RADIX_DECIMAL );
+        p = put_number( &plain, p, D2B_RADIX_DECIMAL, s,
+                u64_to_decimal( s, value, 0 ) );
+    }
+    if( options->hex == 1 )
+    {
+        p = put_label( &plain, p, D2B_RADIX_HEX );
+        p = put_number( &plain, p, D2B_RADIX_HEX, s,
+                u64_to_hex( s, value, 0, 0 ) );
+    }
+    if( options->hexCaps == 1 )
+    {
+        p = put_label( &plain, p, D2B_RADIX_HEX_CAPS );
+        p = put_number( &plain, p, D2B_RADIX_HEX_CAPS, s,
+                u64_to_hex( s, value, 0, 1 ) );
+    }
+    if( options->preciseHex == 1 )
+    {
+        p = put_label( &plain, p, D2B_RADIX_PRECISE_HEX );
+        p = put_number( &plain, p, D2B_RADIX_PRECISE_HEX, s,
+                snprintf( s, sizeof( s ), "%a", (double)c ) );
+    }
+    if( options->preciseHexCaps == 1 )
+    {
+        p = put_label( &plain, p, D2B_RADIX_PRECISE_HEX_CAPS );
+        p = put_number( &plain, p, D2B_RADIX_PRECISE_HEX_CAPS, s,
+                snprintf( s, sizeof( s ), "%A", (double)c ) );
+    }
+    if( options->octal == 1 )
+    {
+        p = put_label( &plain, p, D2B_RADIX_OCTAL );
+        p = put_number( &plain, p, D2B_RADIX_OCTAL, s,
+                u64_to_octal( s, value, 0 ) );
+    }
+    if( options->binary == 1 )
+    {
+        p = put_label( &plain, p, D2B_RADIX_BINARY );
+        p = put_number( &plain, p, D2B_RADIX_BINARY, s,
+                u64_to_binary( s, value, 8, options->bigEndian ) );
+    }
+
+    return( put_end( &plain, p ) );
+}
+
+
+/*  ----------------------  format_bits  ---------------------------------
+ *
+ *  the common case of text mode, binary output and nothing else, done in
+ *  bulk: runs of ASCII go straight through the vector kernel
+ */
+static size_t format_bits( const struct d2b_options *options,
+        const unsigned char *text, size_t length, size_t *printed, char *out )
+{
+    char gapChar = ( options->lineSpacing == 1 ) ? '\n' : ' ';
+    int gapLength = ( options->lineSpacing == 1 ) ? 1 : options->sections;
+    char *p = out;
+
+    while( length > 0 )
+    {
+        size_t run = ascii_run( text, length );
+
+        /*  With -l, words get a blank line between them, before each space
+         *  (even one at the very start, so -j chunks need know nothing) */
+        if( options->lineSpacing == 1 && run > 0 )
+        {
+            const char *space = memchr( text + 1, ' ', run - 1 );
+
+            if( text[0] == ' ' )
+                *p++ = '\n';
+            if( space != NULL )
+                run = (const unsigned char *)space - text;
+        }
+
+        if( run > 0 )
+        {
+            p += expand_bits( p, text, run, options->bigEndian, gapChar,
+                    gapLength );
+            *printed += run;
+        }
+
+        /*  Skip whatever isn't ASCII */
+        while( run < length && text[run] >= 0x80 )
+            ++run;
+
+        text += run;
+        length -= run;
+    }
+
+    return( p - out );
+}
+
+
+size_t d2b_format_text( const struct d2b_options *options, const char *text,
+        size_t length, size_t *printed, char *out )
+{
+    int conversions = d2b_conversions( options );
+    size_t counter = 0;     //  Generic counter
+    char s[32];             //  Room for the longest of our outputs
+    char *p = out;
+
+    /*  In columns, every character is a record of its own */
+    if( options->layout != D2B_LAYOUT_LINES )
+    {
+        for( counter = 0; counter < length; ++counter )
+        {
+            if( isascii( text[counter] ) )
+            {
+                p = put_text_record( options, p, text[counter] );
+                ++*printed;
+            }
+        }
+
+        return( p - out );
+    }
+
+    /*  Plain binary has a fast path */
+    if( conversions == 1 && options->binary == 1 && options->verbose == 0 &&
+            options->sections <= EXPAND_MAX_GAP )
+        return( format_bits( options, (const unsigned char *)text, length,
+                    printed, out ) );
+
+    for( counter = 0; counter < length; ++counter )
+    {
+        char c = text[counter];
+        double real = c;    //  The character's value, for the precise hexes
+
+        /*
+         * If our 'character' isn't ASCII, we skip it.
+         */
+        if( ! isascii( c ) )
+            continue;
+
+        /*  -l puts a blank line between characters with more than one
+         *  record each, and otherwise between words, before each space */
+        if( options->lineSpacing != 0 && ( ( conversions > 1 &&
+                        *printed > 0 ) || ( conversions == 1 && c == ' ' ) ) )
+            *p++ = '\n';
+
+        if( options->binary == 1 )
+        {
+            u64_to_binary( s, (unsigned char)c, 8, options->bigEndian );
+            p = put_text_field( options, p, c, "  BIN    ", s, 8 );
+        }
+
+        if( options->hex == 1 )
+            p = put_text_field( options, p, c, "  HEX    ", s,
+                    u64_to_hex( s, (unsigned char)c, 0, 0 ) );
+
+        if( options->hexCaps == 1 )
+            p = put_text_field( options, p, c, "  HEX    ", s,
+                    u64_to_hex( s, (unsigned char)c, 0, 1 ) );
+
+        if( options->preciseHex == 1 )
+            p = put_text_field( options, p, c, "  0xHEX  ", s,
+                    snprintf( s, sizeof( s ), "%a", real ) );
+
+        if( options->preciseHexCaps == 1 )
+            p = put_text_field( options, p, c, "  0xHEX  ", s,
+                    snprintf( s, sizeof( s ), "%A", real ) );
+
+        if( options->octal == 1 )
+            p = put_text_field( options, p, c, "  OCT    ", s,
+                    u64_to_octal( s, (unsigned char)c, 0 ) );
+
+        if( options->decimal == 1 )
+            p = put_text_field( options, p, c, "  DEC    ", s,
+                    u64_to_decimal( s, (unsigned char)c, 0 ) );
+
+        ++*printed;     //  Increment our print counter
+    }
+
+    return( p - out );
+}
+
+
+/*  Radix and digits of each type a range counts in; the precise hexes aren't */
+static const struct
+{
+    int radix;
+    const char *alphabet;
+} rangeRadixes[D2B_RADIX_COUNT] = {
+    [D2B_RADIX_DECIMAL] = { 10, "0123456789" },
+    [D2B_RADIX_HEX] = { 16, "0123456789abcdef" },
+    [D2B_RADIX_HEX_CAPS] = { 16, "0123456789ABCDEF" },
+    [D2B_RADIX_OCTAL] = { 8, "01234567" },
+    [D2B_RADIX_BINARY] = { 2, "01" }
+};
+
+
+/*  Whether [range] prints [radix] at all, so its digits need keeping up */
+static int range_counts( const struct d2b_range *range, int radix )
+{
+    const struct d2b_options *options = &range->options;
+
+    switch( radix )
+    {
+        case D2B_RADIX_DECIMAL:     return( options->decimal );
+        case D2B_RADIX_HEX:         return( options->hex );
+        case D2B_RADIX_HEX_CAPS:    return( options->hexCaps );
+        case D2B_RADIX_OCTAL:       return( options->octal );
+        case D2B_RADIX_BINARY:      return( options->binary );
+        default:                    return( 0 );
+    }
+}
+
+
+/*  Where the digit of weight [w] goes in [digits]' text */
+static int digit_position( const struct d2b_range *range, int radix, int w )
+{
+    if( radix == D2B_RADIX_BINARY && range->options.bigEndian == 0 )
+        return( w );
+
+    return( 63 - w );
+}
+
+
+/*  Spell [value] out in [radix] into [digits], from nothing */
+static void digits_set( const struct d2b_range *range, int radix,
+        struct d2b_digits *digits, uint64_t value )
+{
+    const int base = rangeRadixes[radix].radix;
+    int w = 0;
+
+    memset( digits->value, 0, sizeof( digits->value ) );
+    memset( digits->text, '0', sizeof( digits->text ) );
+
+    digits->length = 0;
+    for( w = 0; value != 0; ++w )
+    {
+        digits->value[w] = value % base;
+        digits->text[digit_position( range, radix, w )] =
+            rangeRadixes[radix].alphabet[value % base];
+        value /= base;
+        digits->length = w + 1;
+    }
+
+    if( digits->length < digits->fixed )
+        digits->length = digits->fixed;
+    if( digits->length == 0 )
+        digits->length = 1;     //  Zero is still one digit
+}
+
+
+/*  Add [step]'s digits to [digits], carrying as far as it takes */
+static void digits_add( const struct d2b_range *range, int radix,
+        struct d2b_digits *digits, const struct d2b_digits *step )
+{
+    const int base = rangeRadixes[radix].radix;
+    const char *alphabet = rangeRadixes[radix].alphabet;
+    int carry = 0;
+    int w = 0;
+
+    for( w = 0; w < 64 && ( w < step->length || carry != 0 ); ++w )
+    {
+        int sum = digits->value[w] + step->value[w] + carry;
+
+        carry = ( sum >= base );
+        if( carry )
+            sum -= base;
+
+        digits->value[w] = sum;
+        digits->text[digit_position( range, radix, w )] = alphabet[sum];
+    }
+
+    /*  A leading zero in the step doesn't make the number any longer */
+    while( w > digits->length && digits->value[w - 1] == 0 )
+        --w;
+    if( w > digits->length )
+        digits->length = w;
+}
+
+
+void d2b_range_init( struct d2b_range *range,
+        const struct d2b_options *options, uint64_t start, uint64_t end,
+        uint64_t step )
+{
+    const int width = options->width;
+    int fixed[D2B_RADIX_COUNT] = { 0 };
+    int radix = 0;
+
+    memset( range, 0, sizeof( *range ) );
+    range->options = *options;
+    range->value = start;
+    range->end = end;
+    range->step = step;
+    range->done = ( start > end || step == 0 );
+    if( range->done == 0 && d2b_fits_width( options, start ) == 0 )
+    {
+        range->done = 1;
+        range->tooWide = 1;
+    }
+
+    if( width > 0 )
+    {
+        fixed[D2B_RADIX_DECIMAL] = width * 30103 / 100000 + 1;
+        fixed[D2B_RADIX_HEX] = ( width + 3 ) / 4;
+        fixed[D2B_RADIX_HEX_CAPS] = ( width + 3 ) / 4;
+        fixed[D2B_RADIX_OCTAL] = ( width + 2 ) / 3;
+        fixed[D2B_RADIX_BINARY] = width;
+    }
+
+    for( radix = 0; radix < D2B_RADIX_COUNT; ++radix )
+    {
+        if( range_counts( range, radix ) == 0 )
+            continue;
+
+        range->digits[radix].fixed = fixed[radix];
+        digits_set( range, radix, &range->digits[radix], start );
+        digits_set( range, radix, &range->stepDigits[radix], step );
+    }
+}
+
+
+/*  One counted line of a range record */
+static char *put_digits( const struct d2b_range *range, char *p, int radix )
+{
+    const struct d2b_digits *digits = &range->digits[radix];
+    const char *text = digits->text;
+
+    if( digit_position( range, radix, 0 ) == 63 )
+        text += 64 - digits->length;
+
+    p = put_label( &range->options, p, radix );
+    return( put_number( &range->options, p, radix, text, digits->length ) );
+}
+
+
+/*  ----------------------  d2b_range_next  ------------------------------
+ *
+ *  the record, in d2b_format_u64's order, then the step.  The range stops
+ *  short of 2^64 and of the width, so the digits never wrap around.
+ */
+size_t d2b_range_next( struct d2b_range *range, char *out )
+{
+    const struct d2b_options *options = &range->options;
+    char s[64];
+    char *p = out;
+    uint64_t next = 0;
+    int radix = 0;
+
+    if( range->done == 1 )
+        return( 0 );
+
+    /*  In columns, the number itself comes first */
+    if( options->layout != D2B_LAYOUT_LINES )
+        p += d2b_format_input( options, s, u64_to_decimal( s, range->value,
+                    0 ), 0, p );
+
+    if( options->decimal == 1 )
+        p = put_digits( range, p, D2B_RADIX_DECIMAL );
+    if( options->hex == 1 )
+        p = put_digits( range, p, D2B_RADIX_HEX );
+    if( options->hexCaps == 1 )
+        p = put_digits( range, p, D2B_RADIX_HEX_CAPS );
+    if( options->preciseHex == 1 )
+    {
+        p = put_label( options, p, D2B_RADIX_PRECISE_HEX );
+        p = put_number( options, p, D2B_RADIX_PRECISE_HEX, s,
+                snprintf( s, sizeof( s ), "%a", (double)range->value ) );
+    }
+    if( options->preciseHexCaps == 1 )
+    {
+        p = put_label( options, p, D2B_RADIX_PRECISE_HEX_CAPS );
+        p = put_number( options, p, D2B_RADIX_PRECISE_HEX_CAPS, s,
+                snprintf( s, sizeof( s ), "%A", (double)range->value ) );
+    }
+    if( options->octal == 1 )
+        p = put_digits( range, p, D2B_RADIX_OCTAL );
+    if( options->binary == 1 )
+        p = put_digits( range, p, D2B_RADIX_BINARY );
+    p = put_end( options, p );
+
+    if( __builtin_add_overflow( range->value, range->step, &next ) ||
+            next > range->end )
+    {
+        range->done = 1;
+        return( p - out );
+    }
+
+    range->value = next;
+    if( d2b_fits_width( options, next ) == 0 )
+    {
+        range->done = 1;
+        range->tooWide = 1;
+        return( p - out );
+    }
+
+    for( radix = 0; radix < D2B_RADIX_COUNT; ++radix )
+    {
+        if( range_counts( range, radix ) != 0 )
+            digits_add( range, radix, &range->digits[radix],
+                    &range->stepDigits[radix] );
+    }
+
+    return( p - out );
+}
+
+
+/*  ----------------------------------------------------------------------
+ *  --type: integers of one exact width, signed or not.  The same inline
+ *  routine is stamped out once per type below, so every kernel has its
+ *  width and signedness as constants and the compiler unrolls its byte
+ *  loops; which one runs is picked once, by d2b_typed.
+ */
+typedef unsigned __int128 typed_value;
+
+#define ALWAYS_INLINE static inline __attribute__((always_inline))
+
+
+/*
+ *  Read [string] as an integer with an optional sign, into the two's
+ *  complement bit pattern of a [bits]-bit type (zero-extended) and the
+ *  magnitude.  Returns D2B_NUMBER, D2B_INVALID or D2B_RANGE.
+ */
+ALWAYS_INLINE int read_typed( const char *string, const int bits,
+        const int isSigned, typed_value *pattern, typed_value *magnitude,
+        int *negative )
+{
+    const char *digits = string;
+    typed_value number = 0;
+    typed_value limit = 0;
+    uint64_t low = 0;
+    size_t length = 0;
+    int overflow = 0;
+
+    while( isspace( (unsigned char)*digits ) )
+        ++digits;
+    *negative = ( *digits == '-' );
+    if( *digits == '-' || *digits == '+' )
+        ++digits;
+
+    length = parse_decimal( digits, &low, &overflow );
+    if( length == 0 || ( digits[length] != '\0' &&
+                ! isspace( (unsigned char)digits[length] ) ) )
+        return( D2B_INVALID );
+
+    number = low;
+    if( overflow == 1 )
+    {
+        size_t i = 0;
+
+        if( bits <= 64 )
+            return( D2B_RANGE );
+
+        /*  Past 64 bits, which only the 128-bit types get to */
+        for( i = 0, number = 0; i < length; ++i )
+        {
+            typed_value digit = digits[i] - '0';
+
+            if( number > ( ~(typed_value)0 - digit ) / 10 )
+                return( D2B_RANGE );
+            number = number * 10 + digit;
+        }
+    }
+
+    /*  The biggest magnitude the type holds with this sign */
+    if( isSigned )
+        limit = ( (typed_value)1 << ( bits - 1 ) ) - ( *negative == 0 );
+    else if( *negative == 1 )
+        limit = 0;
+    else
+        limit = ( bits == 128 ) ? ~(typed_value)0 :
+            ( (typed_value)1 << ( bits & 127 ) ) - 1;
+
+    if( number > limit )
+        return( D2B_RANGE );
+
+    *negative &= ( number != 0 );      //  -0 is just 0
+    *magnitude = number;
+    *pattern = ( *negative == 1 ) ? -number : number;
+    if( bits < 128 )
+        *pattern &= ( (typed_value)1 << ( bits & 127 ) ) - 1;
+
+    return( D2B_NUMBER );
+}
+
+
+/*  Byte [i] of [value], counting from the least significant */
+ALWAYS_INLINE unsigned typed_byte( typed_value value, int i )
+{
+    if( i < 8 )
+        return( ( (uint64_t)value >> ( i * 8 ) ) & 0xff );
+
+    return( ( (uint64_t)( value >> 64 ) >> ( ( i - 8 ) * 8 ) ) & 0xff );
+}
+
+
+/*  All [bits] bits of [value], a byte at a time */
+ALWAYS_INLINE int typed_binary( char *s, typed_value value, const int bits,
+        int bigEndian )
+{
+    const int bytes = bits / 8;
+    int i = 0;
+
+    if( bigEndian == 1 )
+        for( i = 0; i < bytes; ++i )
+            memcpy( s + i * 8, bigEndianBits[ typed_byte( value,
+                        bytes - 1 - i ) ], 8 );
+    else
+        for( i = 0; i < bytes; ++i )
+            memcpy( s + i * 8, littleEndianBits[ typed_byte( value, i ) ], 8 );
+
+    return( bits );
+}
+
+
+/*  All [bits] / 4 hex digits of [value], a byte at a time */
+ALWAYS_INLINE int typed_hex( char *s, typed_value value, const int bits,
+        int caps )
+{
+    const char (*table)[2] = hexPairs[ caps != 0 ];
+    const int bytes = bits / 8;
+    int i = 0;
+
+    for( i = 0; i < bytes; ++i )
+        memcpy( s + i * 2, table[ typed_byte( value, bytes - 1 - i ) ], 2 );
+
+    return( bits / 4 );
+}
+
+
+/*  Enough octal digits for [bits] bits of [value], nine bits at a time */
+ALWAYS_INLINE int typed_octal( char *s, typed_value value, const int bits )
+{
+    const int triplets = ( bits + 8 ) / 9;
+    const int length = ( bits + 2 ) / 3;
+    char digits[45];    //  15 triplets hold 128 bits
+    int i = 0;
+
+    for( i = 0; i < triplets; ++i )
+        memcpy( digits + ( triplets - 1 - i ) * 3,
+                octalTriplets[ (unsigned)( value >> ( i * 9 ) ) & 511 ], 3 );
+
+    memcpy( s, digits + triplets * 3 - length, length );
+    return( length );
+}
+
+
+/*  [magnitude] in decimal, 19 digits (under 2^64) at a time */
+ALWAYS_INLINE int typed_decimal( char *s, typed_value magnitude,
+        const int bits )
+{
+    const uint64_t chunk = 10000000000000000000ULL;     //  10^19
+    uint64_t parts[3];
+    int count = 0;
+    int n = 0;
+
+    if( bits <= 64 || ( magnitude >> 64 ) == 0 )
+        return( u64_to_decimal( s, (uint64_t)magnitude, 0 ) );
+
+    do
+    {
+        parts[count++] = (uint64_t)( magnitude % chunk );
+        magnitude /= chunk;
+    }
+    while( magnitude > 0 );
+
+    n = u64_to_decimal( s, parts[--count], 0 );
+    while( count > 0 )
+        n += u64_to_decimal( s + n, parts[--count], 19 );
+
+    return( n );
+}
+
+
+/*
+ *  A binary IEEE-754 pattern split into its sign, exponent and mantissa,
+ *  which come in the opposite order when little-endian; the separator goes
+ *  between them
+ */
+static char *put_fields( const struct d2b_options *options, char *p,
+        const char *s, int bits, int exponentBits )
+{
+    int first = ( options->bigEndian == 1 ) ? 1 : bits - 1 - exponentBits;
+    int length = 0;
+    const char *separator = separator_of( options, &length );
+    int quoted = quote_groups( options, separator, length );
+
+    if( quoted == 1 )
+        *p++ = '"';
+    p = put( p, s, first );
+    p = put( p, separator, length );
+    p = put( p, s + first, exponentBits );
+    p = put( p, separator, length );
+    p = put( p, s + first + exponentBits, bits - first - exponentBits );
+    if( quoted == 1 )
+        *p++ = '"';
+
+    return( put_number_end( options, p ) );
+}
+
+
+/*  ----------------------  put_typed  -----------------------------------
+ *
+ *  the record for a [bits]-bit integer: decimal as [magnitude], with a
+ *  minus sign if [negative], the precise hexes as [real], and hex, octal
+ *  and binary as every bit of [pattern].  Output types come in the order
+ *  d2b_format_u64 uses.  A float's pattern has [exponentBits] set, and -s
+ *  splits its binary into fields instead of groups of four.
+ */
+ALWAYS_INLINE char *put_typed( const struct d2b_options *options, char *p,
+        typed_value pattern, typed_value magnitude, int negative, double real,
+        const int bits, const int exponentBits )
+{
+    char s[128];        //  Binary is the longest we print
+
+    if( options->decimal == 1 )
+    {
+        /*  The sign goes in with the digits, ahead of any grouping */
+        s[0] = '-';
+        p = put_label( options, p, D2B_RADIX_DECIMAL );
+        p = put_number( options, p, D2B_RADIX_DECIMAL, s + 1 - negative,
+                negative + typed_decimal( s + 1, magnitude, bits ) );
+    }
+
+    if( options->hex == 1 )
+    {
+        p = put_label( options, p, D2B_RADIX_HEX );
+        p = put_number( options, p, D2B_RADIX_HEX, s,
+                typed_hex( s, pattern, bits, 0 ) );
+    }
+
+    if( options->hexCaps == 1 )
+    {
+        p = put_label( options, p, D2B_RADIX_HEX_CAPS );
+        p = put_number( options, p, D2B_RADIX_HEX_CAPS, s,
+                typed_hex( s, pattern, bits, 1 ) );
+    }
+
+    if( options->preciseHex == 1 )
+    {
+        p = put_label( options, p, D2B_RADIX_PRECISE_HEX );
+        p = put_number( options, p, D2B_RADIX_PRECISE_HEX, s,
+                snprintf( s, sizeof( s ), "%a", real ) );
+    }
+
+    if( options->preciseHexCaps == 1 )
+    {
+        p = put_label( options, p, D2B_RADIX_PRECISE_HEX_CAPS );
+        p = put_number( options, p, D2B_RADIX_PRECISE_HEX_CAPS, s,
+                snprintf( s, sizeof( s ), "%A", real ) );
+    }
+
+    if( options->octal == 1 )
+    {
+        p = put_label( options, p, D2B_RADIX_OCTAL );
+        p = put_number( options, p, D2B_RADIX_OCTAL, s,
+                typed_octal( s, pattern, bits ) );
+    }
+
+    if( options->binary == 1 )
+    {
+        int n = typed_binary( s, pattern, bits, options->bigEndian );
+
+        p = put_label( options, p, D2B_RADIX_BINARY );
+        if( exponentBits > 0 && options->sections != 0 )
+            p = put_fields( options, p, s, bits, exponentBits );
+        else
+            p = put_number( options, p, D2B_RADIX_BINARY, s, n );
+    }
+
+    return( put_end( options, p ) );
+}
+
+
+/*  Read [string] as a [bits]-bit integer and format its record */
+ALWAYS_INLINE int format_typed( const struct d2b_options *options,
+        const char *string, char *out, size_t *length, const int bits,
+        const int isSigned )
+{
+    typed_value pattern = 0;
+    typed_value magnitude = 0;
+    double real = 0;
+    int negative = 0;
+    int result = read_typed( string, bits, isSigned, &pattern, &magnitude,
+            &negative );
+
+    if( result != D2B_NUMBER )
+        return( result );
+
+    real = ( negative == 1 ) ? -(double)magnitude : (double)magnitude;
+    *length = put_typed( options, out, pattern, magnitude, negative, real,
+            bits, 0 ) - out;
+
+    return( D2B_NUMBER );
+}
+
+
+/*  One kernel per type, each with its width built in */
+#define TYPED_KERNEL(name, bits, isSigned) \
+    static int name( const struct d2b_options *options, const char *string, \
+            char *out, size_t *length ) \
+    { \
+        return( format_typed( options, string, out, length, bits, \
+                    isSigned ) ); \
+    }
+
+TYPED_KERNEL( format_i8, 8, 1 )
+TYPED_KERNEL( format_u8, 8, 0 )
+TYPED_KERNEL( format_i16, 16, 1 )
+TYPED_KERNEL( format_u16, 16, 0 )
+TYPED_KERNEL( format_i32, 32, 1 )
+TYPED_KERNEL( format_u32, 32, 0 )
+TYPED_KERNEL( format_i64, 64, 1 )
+TYPED_KERNEL( format_u64, 64, 0 )
+TYPED_KERNEL( format_i128, 128, 1 )
+TYPED_KERNEL( format_u128, 128, 0 )
+
+static const d2b_typed_kernel typedKernels[D2B_TYPE_COUNT] = {
+    [D2B_TYPE_I8] = format_i8,      [D2B_TYPE_U8] = format_u8,
+    [D2B_TYPE_I16] = format_i16,    [D2B_TYPE_U16] = format_u16,
+    [D2B_TYPE_I32] = format_i32,    [D2B_TYPE_U32] = format_u32,
+    [D2B_TYPE_I64] = format_i64,    [D2B_TYPE_U64] = format_u64,
+    [D2B_TYPE_I128] = format_i128,  [D2B_TYPE_U128] = format_u128
+};
+
+
+d2b_typed_kernel d2b_typed( int type )
+{
+    if( type < 0 || type >= D2B_TYPE_COUNT )
+        return( NULL );
+
+    return( typedKernels[type] );
+}
+
+
+/*  Where [name] is in [names] (entries [from] on), or [none] */
+static int name_index( const char *name, const char *const *names, int from,
+        int count, int none )
+{
+    int i = 0;
+
+    for( i = from; i < count; ++i )
+    {
+        if( strcmp( name, names[i] ) == 0 )
+            return( i );
+    }
+
+    return( none );
+}
+
+
+int d2b_type_named( const char *name )
+{
+    static const char *const names[D2B_TYPE_COUNT] = {
+        [D2B_TYPE_I8] = "i8",       [D2B_TYPE_U8] = "u8",
+        [D2B_TYPE_I16] = "i16",     [D2B_TYPE_U16] = "u16",
+        [D2B_TYPE_I32] = "i32",     [D2B_TYPE_U32] = "u32",
+        [D2B_TYPE_I64] = "i64",     [D2B_TYPE_U64] = "u64",
+        [D2B_TYPE_I128] = "i128",   [D2B_TYPE_U128] = "u128"
+    };
+
+    return( name_index( name, names, D2B_TYPE_I8, D2B_TYPE_COUNT, 0 ) );
+}
+
+
+int d2b_ieee_named( const char *name )
+{
+    static const char *const names[] = { "", "f16", "f32", "f64" };
+
+    return( name_index( name, names, D2B_IEEE_F16, D2B_IEEE_F64 + 1, 0 ) );
+}
+
+
+int d2b_layout_named( const char *name )
+{
+    static const char *const names[] = { "", "tsv", "csv", "ndjson" };
+
+    return( name_index( name, names, D2B_LAYOUT_TSV, D2B_LAYOUT_NDJSON + 1,
+                -1 ) );
+}
+
+
+int d2b_set_separator( struct d2b_options *options, const char *separator )
+{
+    size_t length = strlen( separator );
+    size_t i = 0;
+
+    if( length == 0 || length > D2B_SEPARATOR_MAX )
+        return(1);
+
+    for( i = 0; i < length; ++i )
+    {
+        unsigned char c = separator[i];
+
+        if( isalnum( c ) || iscntrl( c ) || c == '"' || c == '\\' )
+            return(1);
+    }
+
+    memcpy( options->separator, separator, length + 1 );
+    return(0);
+}
+
+
+void d2b_ieee_bits( int format, const double *values, uint64_t *bits,
+        size_t count )
+{
+    ieee_bits( ( format == D2B_IEEE_F16 ) ? 16 :
+            ( format == D2B_IEEE_F32 ) ? 32 : 64, values, bits, count );
+}
+
+
+/*  ----------------------  d2b_format_ieee  -----------------------------
+ *
+ *  a float's pattern is laid out like an unsigned integer of its width
+ *  (decimal being the pattern too), except for the precise hexes, which
+ *  print the value the pattern stands for
+ */
+size_t d2b_format_ieee( const struct d2b_options *options, int format,
+        uint64_t bits, char *out )
+{
+    float single = 0;
+    double real = 0;
+    uint32_t narrow = (uint32_t)bits;
+
+    switch( format )
+    {
+        case D2B_IEEE_F16:
+            real = half_value( (uint16_t)bits );
+            return( put_typed( options, out, bits, bits, 0, real, 16, 5 ) -
+                    out );
+        case D2B_IEEE_F32:
+            memcpy( &single, &narrow, sizeof( single ) );
+            return( put_typed( options, out, bits, bits, 0, single, 32, 8 ) -
+                    out );
+        default:
+            memcpy( &real, &bits, sizeof( real ) );
+            return( put_typed( options, out, bits, bits, 0, real, 64, 11 ) -
+                    out );
+    }
+}
+
+/*  Hex digits in the offsets of a dump of [size] bytes; 8 up to 4 GiB */
+static int dump_offset_digits( size_t size )
+{
+    uint64_t last = ( size > 0 ) ? size - 1 : 0;
+    int digits = 8;
+
+    while( digits < 16 && ( last >> ( 4 * digits ) ) != 0 )
+        ++digits;
+
+    return( digits );
+}
+
+
+/*  Width of the bits of [n] bytes in a dump row */
+static size_t dump_bits_width( const struct d2b_options *options, size_t n )
+{
+    return( n * 8 + ( ( options->sections != 0 && n > 0 ) ? n - 1 : 0 ) );
+}
+
+
+/*  Length of a dump row of [n] bytes; only the last row is ever short */
+static size_t dump_row_size( const struct d2b_options *options, size_t n,
+        int offsetDigits )
+{
+    if( options->verbose == 1 )
+        return( offsetDigits + 2 + dump_bits_width( options, D2B_DUMP_ROW ) +
+                2 + n + 1 );
+
+    return( dump_bits_width( options, n ) + 1 );
+}
+
+
+size_t d2b_dump_size( const struct d2b_options *options, size_t size,
+        size_t length )
+{
+    int digits = dump_offset_digits( size );
+    size_t rest = length % D2B_DUMP_ROW;
+
+    return( length / D2B_DUMP_ROW *
+            dump_row_size( options, D2B_DUMP_ROW, digits ) +
+            ( ( rest > 0 ) ? dump_row_size( options, rest, digits ) : 0 ) );
+}
+
+
+/*  ----------------------  put_dump_row  --------------------------------
+ *
+ *  one row of [n] bytes, found [offset] bytes into the file.  The bit
+ *  kernels scribble up to EXPAND_SLACK bytes past the row.
+ */
+static char *put_dump_row( const struct d2b_options *options, char *p,
+        const unsigned char *row, size_t n, size_t offset, int offsetDigits )
+{
+    int gap = ( options->sections != 0 );
+    size_t i = 0;
+
+    if( options->verbose == 1 )
+    {
+        p += u64_to_hex( p, offset, offsetDigits, 0 );
+        *p++ = ':';
+        *p++ = ' ';
+    }
+
+    /*  The gap after the last byte is taken back */
+    p += expand_bits( p, row, n, options->bigEndian, ' ', gap ) - gap;
+
+    if( options->verbose == 1 )
+    {
+        size_t pad = dump_bits_width( options, D2B_DUMP_ROW ) -
+            dump_bits_width( options, n ) + 2;
+
+        memset( p, ' ', pad );
+        p += pad;
+        for( i = 0; i < n; ++i )
+            *p++ = ( row[i] >= 0x20 && row[i] < 0x7f ) ? row[i] : '.';
+    }
+
+    *p++ = '\n';
+    return( p );
+}
+
+
+/*  ----------------------  d2b_format_dump  -----------------------------
+ *
+ *  each row's spill is written over by the next, so only the last row
+ *  has to go through a buffer of its own to keep within bounds
+ */
+size_t d2b_format_dump( const struct d2b_options *options,
+        const unsigned char *data, size_t size, size_t from, size_t to,
+        char *out )
+{
+    char last[DUMP_ROW_MAX + EXPAND_SLACK];
+    int digits = dump_offset_digits( size );
+    size_t row = from;
+    char *p = out;
+
+    while( row < to )
+    {
+        size_t n = ( to - row < D2B_DUMP_ROW ) ? to - row : D2B_DUMP_ROW;
+
+        if( row + n < to )
+            p = put_dump_row( options, p, data + row, n, row, digits );
+        else
+        {
+            size_t length = put_dump_row( options, last, data + row, n, row,
+                    digits ) - last;
+
+            p = put( p, last, length );
+        }
+
+        row += n;
+    }
+
+    return( p - out );
+}
+
+
+int d2b_convert_u64( const struct d2b_options *options,
+        const uint64_t *values, size_t count, char *buffer, size_t size,
+        size_t *offsets, size_t *done )
+{
+    char spare[D2B_RECORD_MAX];
+    size_t used = 0;
+    size_t i = 0;
+
+    offsets[0] = 0;
+    for( i = 0; i < count; ++i )
+    {
+        uint64_t value = values[i];
+        size_t n = 0;
+
+        if( d2b_fits_width( options, value ) == 0 )
+        {
+            *done = i;
+            return( D2B_ERR_WIDTH );
+        }
+
+        /*  Near the end, find out how long the record is before copying */
+        if( size - used >= D2B_RECORD_MAX )
+            n = d2b_format_u64( options, value, (double)value, buffer + used );
+        else
+        {
+            n = d2b_format_u64( options, value, (double)value, spare );
+            if( n > size - used )
+                break;
+            memcpy( buffer + used, spare, n );
+        }
+
+        used += n;
+        offsets[i + 1] = used;
+    }
+
+    *done = i;
+    return( i == count ? D2B_OK : D2B_ERR_SPACE );
+}
+
+
+int d2b_convert_text( const struct d2b_options *options,
+        const struct d2b_span *spans, size_t count, char *buffer, size_t size,
+        size_t *offsets, size_t *done )
+{
+    size_t used = 0;
+    size_t i = 0;
+
+    offsets[0] = 0;
+    for( i = 0; i < count; ++i )
+    {
+        size_t printed = 0;
+
+        if( size - used < d2b_text_max( options, spans[i].length ) )
+            break;
+
+        used += d2b_format_text( options, spans[i].data, spans[i].length,
+                &printed, buffer + used );
+        offsets[i + 1] = used;
+    }
+
+    *done = i;
+    return( i == count ? D2B_OK : D2B_ERR_SPACE );
+}
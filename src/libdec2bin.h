@@ -0,0 +1,455 @@
+/*******************************************************************************
+ * libdec2bin.h |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      The conversion core of dec2bin as a library.  Everything that used to
+ *      be a global option lives in a struct d2b_options, and every function
+ *      formats into memory the caller hands it, so any number of threads can
+ *      convert at once.  Nothing allocates except the conversion of numbers
+ *      past 64 bits and the record cache, which is one per thread.
+ *
+ *      A record is exactly what the dec2bin program prints for one number
+ *      (or one string, in text mode): a line per output type, in the same
+ *      order and format.  The blank line -l puts between numbers is not part
+ *      of a record; that's up to whoever strings records together.
+ ******************************************************************************/
+#ifndef LIBDEC2BIN_H
+#define LIBDEC2BIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ *  The library is built with -fvisibility=hidden, so what it shares with
+ *  the rest of the program stays its own; these are all it exports
+ */
+#if defined(__GNUC__)
+#define D2B_API __attribute__((visibility("default")))
+#else
+#define D2B_API
+#endif
+
+/*  No record for a number up to 64 bits (or a d2b_typed one) is longer */
+#define D2B_RECORD_MAX 2048
+
+/*  Longest separator between groups, and the biggest group */
+#define D2B_SEPARATOR_MAX 4
+#define D2B_GROUP_MAX 64
+
+/*  Bytes per row of d2b_format_dump, as in xxd -b */
+#define D2B_DUMP_ROW 6
+
+/*  Returned by the size_t formatters when they can't format a record */
+#define D2B_FAILED ( (size_t)-1 )
+
+/*
+ *  The most digits a number written with an exponent may expand to: 1e999999
+ *  is a handful of bytes of input but a megabyte of output
+ */
+#define D2B_EXPANDED_MAX 1000000
+
+/*  d2b_parse results */
+enum
+{
+    D2B_NUMBER = 0,             //  Fits in 64 bits
+    D2B_NEGATIVE = 1,           //  Refused
+    D2B_BIG = 2,                //  An integer past 64 bits
+    D2B_INVALID = 3,            //  Not a number at all
+    D2B_RANGE = 4,              //  Doesn't fit in the d2b_typed type, or
+                                //  past 2^64 and not a whole number
+    D2B_HUGE = 5                //  Whole, but more than D2B_EXPANDED_MAX
+                                //  digits once its exponent is written out
+};
+
+/*  Batch results */
+enum
+{
+    D2B_OK = 0,
+    D2B_ERR_SPACE = 1,          //  The buffer filled up first
+    D2B_ERR_WIDTH = 2           //  A value doesn't fit options->width
+};
+
+struct d2b_options
+{
+    int binary;                 //  Output types, printed in the order of
+    int decimal;                //  dec2bin's text mode for text and of its
+    int hex;                    //  number mode for everything else
+    int hexCaps;
+    int preciseHex;             //  printf %a of the value as a double
+    int preciseHexCaps;         //  ... and %A
+    int octal;
+    int verbose;                //  Label every line with its output type
+    int sections;               //  Digits per group (-s, --group); 0 for none
+    int lineSpacing;            //  -l: a line per character in text mode
+    int bigEndian;              //  1 (the default) for most significant first
+    int width;                  //  Pad (or cut) to 1 to 64 bits; 0 for none
+    int layout;                 //  A D2B_LAYOUT_ value
+    char separator[D2B_SEPARATOR_MAX + 1];  //  Between groups; "" for a space
+};
+
+/*
+ *  Record layouts.  Lines are dec2bin's own: a line per output type.  The
+ *  others are a line per record, starting with the number as it was given
+ *  (see d2b_format_input) and then a column per output type, in the same
+ *  order; -v and -l don't apply.
+ */
+enum
+{
+    D2B_LAYOUT_LINES = 0,
+    D2B_LAYOUT_TSV,             //  Tab-separated, \t \n \r \\ escaped
+    D2B_LAYOUT_CSV,             //  Comma-separated, quoted as RFC 4180 says
+    D2B_LAYOUT_NDJSON           //  A JSON object per line, all strings
+};
+
+/*  The output types, for d2b_timing */
+enum
+{
+    D2B_RADIX_DECIMAL,
+    D2B_RADIX_HEX,
+    D2B_RADIX_HEX_CAPS,
+    D2B_RADIX_PRECISE_HEX,
+    D2B_RADIX_PRECISE_HEX_CAPS,
+    D2B_RADIX_OCTAL,
+    D2B_RADIX_BINARY,
+    D2B_RADIX_COUNT
+};
+
+/*
+ *  Where d2b_format_u64_timed adds up its time, per output type: making
+ *  the digits, then laying them out (label, sections, newline)
+ */
+struct d2b_timing
+{
+    uint64_t convertNanos[D2B_RADIX_COUNT];
+    uint64_t formatNanos[D2B_RADIX_COUNT];
+    uint64_t count[D2B_RADIX_COUNT];
+};
+
+/*  A number's digits in one radix, for d2b_range */
+struct d2b_digits
+{
+    unsigned char value[64];    //  Least significant first
+    char text[64];              //  As printed
+    int length;                 //  Digits printed
+    int fixed;                  //  Padded length with a width, else 0
+};
+
+/*
+ *  Counting through a range.  The digits of every output type are kept as
+ *  text and the step is added to them in place, carries and all, so going
+ *  from one number to the next touches a digit or two instead of
+ *  converting from scratch.  Set up with d2b_range_init; treat the rest as
+ *  private.
+ */
+struct d2b_range
+{
+    struct d2b_options options;
+    uint64_t value;             //  The next number
+    uint64_t end;
+    uint64_t step;
+    int done;
+    int tooWide;                //  Stopped at value, past the width
+    struct d2b_digits digits[D2B_RADIX_COUNT];
+    struct d2b_digits stepDigits[D2B_RADIX_COUNT];
+};
+
+/*  A cache of whole records, from d2b_cache_new */
+struct d2b_cache;
+
+/*  The integer types of d2b_typed */
+enum
+{
+    D2B_TYPE_I8 = 1,
+    D2B_TYPE_U8,
+    D2B_TYPE_I16,
+    D2B_TYPE_U16,
+    D2B_TYPE_I32,
+    D2B_TYPE_U32,
+    D2B_TYPE_I64,
+    D2B_TYPE_U64,
+    D2B_TYPE_I128,
+    D2B_TYPE_U128,
+    D2B_TYPE_COUNT
+};
+
+/*
+ *  A d2b_typed kernel: read [string] as an integer of its type and format
+ *  its record into [out], which needs D2B_RECORD_MAX bytes, setting *length
+ *  to the bytes written.  Returns D2B_NUMBER, D2B_INVALID (not an integer)
+ *  or D2B_RANGE (one the type can't hold).
+ */
+typedef int (*d2b_typed_kernel)( const struct d2b_options *options,
+        const char *string, char *out, size_t *length );
+
+/*  The floating-point formats of d2b_format_ieee */
+enum
+{
+    D2B_IEEE_F16 = 1,           //  Half: 1 sign, 5 exponent, 10 mantissa bits
+    D2B_IEEE_F32,               //  Single: 1, 8 and 23
+    D2B_IEEE_F64                //  Double: 1, 11 and 52
+};
+
+/*  One string for d2b_convert_text */
+struct d2b_span
+{
+    const char *data;
+    size_t length;
+};
+
+
+/*  Everything off but big endian; set at least one output type */
+D2B_API void d2b_options_init( struct d2b_options *options );
+
+/*  How many output types [options] has switched on */
+D2B_API int d2b_conversions( const struct d2b_options *options );
+
+
+/*
+ *  Read a number from [string] the way dec2bin does: plain integers exactly
+ *  up to 2^64 - 1, anything else (1.5, 2e9) through strtod, truncated.  Past
+ *  that, whole numbers (1e20 too) are D2B_BIG, unless their exponent would
+ *  take them past D2B_EXPANDED_MAX digits (D2B_HUGE), and the rest (inf,
+ *  18446744073709551616.5) D2B_RANGE.  The double is what the precise hex
+ *  types print.  Returns D2B_NUMBER, D2B_NEGATIVE, D2B_BIG, D2B_RANGE,
+ *  D2B_HUGE or D2B_INVALID, only setting *value for the first.
+ */
+D2B_API int d2b_parse( const char *string, uint64_t *value, double *real );
+
+/*
+ *  Read a floating-point number from [string], sign and all, as strtod
+ *  would, but without calling it for plain decimals like 12.375.  Returns
+ *  D2B_NUMBER or D2B_INVALID, only setting *value for the first.
+ */
+D2B_API int d2b_parse_real( const char *string, double *value );
+
+/*  Room d2b_format_input needs for an input [length] bytes long */
+D2B_API size_t d2b_input_max( size_t length );
+
+/*
+ *  In a column layout, the start of a record: the number (or character) as
+ *  it was given, [length] bytes of [input].  The formatters write the rest
+ *  of the record straight after it.  [escape] is 0 when [input] is known to
+ *  be a number, so it has nothing that needs escaping.  Returns the bytes
+ *  written.
+ */
+D2B_API size_t d2b_format_input( const struct d2b_options *options,
+        const char *input, size_t length, int escape, char *out );
+
+/*
+ *  The line of column names that goes before the records of a TSV or CSV
+ *  layout, into [out] (D2B_RECORD_MAX bytes).  Returns the bytes written, 0
+ *  for any other layout.
+ */
+D2B_API size_t d2b_format_header( const struct d2b_options *options,
+        char *out );
+
+/*
+ *  Format the record for [value] into [out], which needs D2B_RECORD_MAX
+ *  bytes.  Returns the bytes written.  [value] has to fit the width, if
+ *  [options] has one; see d2b_fits_width.
+ */
+D2B_API size_t d2b_format_u64( const struct d2b_options *options,
+        uint64_t value, double real, char *out );
+
+/*  Whether [value] fits in options->width bits; anything does without one */
+D2B_API int d2b_fits_width( const struct d2b_options *options,
+        uint64_t value );
+
+/*
+ *  The length every record has when [options] has a width, or 0 if records
+ *  can differ (no width, or a precise hex type)
+ */
+D2B_API size_t d2b_record_size( const struct d2b_options *options );
+
+/*
+ *  d2b_format_u64, adding the time each output type took to [timing] (on
+ *  the monotonic clock).  A NULL [timing] costs next to nothing.
+ */
+D2B_API size_t d2b_format_u64_timed( const struct d2b_options *options,
+        uint64_t value, double real, char *out, struct d2b_timing *timing );
+
+/*
+ *  A cache of the records of numbers seen before, for input that repeats
+ *  itself a lot, in at most [bytes] of memory.  Records are kept for the
+ *  options they were made with, a copy of [options], in a two-way set
+ *  associative table: a number can go in one of two slots, bumping the
+ *  less recently used of them.
+ *  NULL if out of memory or [bytes] isn't enough for a single record.  A
+ *  cache is not for sharing between threads.
+ */
+D2B_API struct d2b_cache *d2b_cache_new( const struct d2b_options *options,
+        size_t bytes );
+
+/*  Free [cache], which can be NULL */
+D2B_API void d2b_cache_free( struct d2b_cache *cache );
+
+/*
+ *  d2b_format_u64_timed with the cache's options, copying the record
+ *  straight from [cache] if [value] is in it (which is not timed) and
+ *  putting it there if not
+ */
+D2B_API size_t d2b_cache_format( struct d2b_cache *cache, uint64_t value,
+        double real, char *out, struct d2b_timing *timing );
+
+/*  Hand over the hits and misses [cache] has counted since last asked */
+D2B_API void d2b_cache_counts( struct d2b_cache *cache, uint64_t *hits,
+        uint64_t *misses );
+
+/*  Room d2b_format_big needs for a number [length] digits long */
+D2B_API size_t d2b_big_max( size_t length );
+
+/*  How many digits the D2B_BIG [string] has, once 1e20 and such are expanded */
+D2B_API size_t d2b_big_digits( const char *string );
+
+/*
+ *  Format the record for [string], an integer d2b_parse called D2B_BIG.
+ *  Returns the bytes written, or D2B_FAILED if out of memory or [options]
+ *  has a width, which no number past 64 bits fits.
+ */
+D2B_API size_t d2b_format_big( const struct d2b_options *options,
+        const char *string, double real, char *out );
+
+/*  Room d2b_format_reverse needs for a string [length] bytes long */
+D2B_API size_t d2b_reverse_max( size_t length );
+
+/*
+ *  Reverse mode: read [string] (null-terminated) as a number in binary, hex
+ *  (either case) or octal, as [radix] says (D2B_RADIX_BINARY, D2B_RADIX_HEX
+ *  or D2B_RADIX_OCTAL), and write it to [out] in decimal, as a line.  Binary
+ *  is read in the order options->bigEndian says.  Numbers past 64 bits work
+ *  too.  Returns the bytes written, 0 if [string] isn't a number in that
+ *  radix, or D2B_FAILED if out of memory.
+ */
+D2B_API size_t d2b_format_reverse( const struct d2b_options *options, int radix,
+        const char *string, char *out );
+
+/*  Room d2b_format_text needs for [length] bytes of text */
+D2B_API size_t d2b_text_max( const struct d2b_options *options, size_t length );
+
+/*
+ *  Format [length] bytes of text; non-ASCII bytes are skipped.  [printed]
+ *  counts the characters converted so far and carries over between calls,
+ *  for text that arrives in pieces; start it at 0.  Returns the bytes
+ *  written.
+ */
+D2B_API size_t d2b_format_text( const struct d2b_options *options,
+        const char *text, size_t length, size_t *printed, char *out );
+
+
+/*
+ *  Set [range] up to count from [start] to [end] (inclusive) in steps of
+ *  [step], which mustn't be 0, formatting as [options] says
+ */
+D2B_API void d2b_range_init( struct d2b_range *range,
+        const struct d2b_options *options, uint64_t start, uint64_t end,
+        uint64_t step );
+
+/*
+ *  Format the record for the next number of [range] into [out], which needs
+ *  D2B_RECORD_MAX bytes, exactly as d2b_format_u64 would (in columns, after
+ *  the number itself).  Returns the bytes written, or 0 once the range is
+ *  used up.  A range with a width stops at the first number that doesn't
+ *  fit it, setting range->tooWide, with range->value that number.
+ */
+D2B_API size_t d2b_range_next( struct d2b_range *range, char *out );
+
+
+/*
+ *  The kernel for a D2B_TYPE_ value, or NULL if there's no such type.  A
+ *  number comes out at exactly the type's width: every bit of its two's
+ *  complement in binary, hex and octal, and the number itself, sign and
+ *  all, in decimal and the precise hexes; options->width is ignored.  Each
+ *  type has a kernel of its own, so pick it once and call it for every
+ *  number.
+ */
+D2B_API d2b_typed_kernel d2b_typed( int type );
+
+
+/*
+ *  The values the options are known by on dec2bin's command line: the
+ *  D2B_TYPE_ for "i8" to "u128" and the D2B_IEEE_ for "f16", "f32" or
+ *  "f64" (0 for any other name), and the D2B_LAYOUT_ for "tsv", "csv" or
+ *  "ndjson" (-1 for any other)
+ */
+D2B_API int d2b_type_named( const char *name );
+D2B_API int d2b_ieee_named( const char *name );
+D2B_API int d2b_layout_named( const char *name );
+
+/*
+ *  Set options->separator to [separator]: 1 to D2B_SEPARATOR_MAX bytes, none
+ *  of them a letter, digit, control character, quote or backslash (so the
+ *  groups read back, and need no escaping in CSV or JSON).  Returns 1 if it
+ *  isn't one of those.
+ */
+D2B_API int d2b_set_separator( struct d2b_options *options,
+        const char *separator );
+
+/*
+ *  The IEEE-754 bit patterns of [count] doubles rounded (to nearest, ties to
+ *  even) to [format], a D2B_IEEE_ value, into [bits].  Converting a whole
+ *  array at once lets singles go two to a vector.
+ */
+D2B_API void d2b_ieee_bits( int format, const double *values, uint64_t *bits,
+        size_t count );
+
+/*
+ *  Format the record for a [format] bit pattern from d2b_ieee_bits into
+ *  [out], which needs D2B_RECORD_MAX bytes.  Binary, hex, octal and decimal
+ *  all show the pattern, at the format's full width; the precise hexes show
+ *  the value it stands for.  options->sections splits binary into sign,
+ *  exponent and mantissa.  Returns the bytes written.
+ */
+D2B_API size_t d2b_format_ieee( const struct d2b_options *options, int format,
+        uint64_t bits, char *out );
+
+/*
+ *  The length of the dump of the first [length] bytes of a file [size]
+ *  bytes long (see d2b_format_dump)
+ */
+D2B_API size_t d2b_dump_size( const struct d2b_options *options, size_t size,
+        size_t length );
+
+/*
+ *  Dump bytes [from] to [to] of [data], a file [size] bytes long, every byte
+ *  as eight bits in options->bigEndian order, D2B_DUMP_ROW bytes to a line.
+ *  options->sections puts a space between bytes, and options->verbose puts
+ *  the offset in front and the bytes as characters behind, like xxd -b.
+ *  [from] must start a row.  Writes d2b_dump_size( to ) - d2b_dump_size(
+ *  from ) bytes to [out] and never a byte past them, so threads can dump
+ *  neighbouring ranges into one buffer.  Returns the bytes written.
+ */
+D2B_API size_t d2b_format_dump( const struct d2b_options *options,
+        const unsigned char *data, size_t size, size_t from, size_t to,
+        char *out );
+
+
+/*
+ *  Batch conversion of [count] values into [buffer], [size] bytes long.
+ *  Record i ends up at buffer[offsets[i]] through buffer[offsets[i + 1]],
+ *  so [offsets] needs count + 1 entries.  *done is set to the number of
+ *  records converted; that's all of them unless D2B_ERR_SPACE comes back,
+ *  in which case the caller can hand the rest over again with more room,
+ *  or D2B_ERR_WIDTH, in which case values[*done] is too wide for the width.
+ */
+D2B_API int d2b_convert_u64( const struct d2b_options *options,
+        const uint64_t *values, size_t count, char *buffer, size_t size,
+        size_t *offsets, size_t *done );
+
+/*
+ *  The same for text mode, a record per span.  A span is only started when
+ *  d2b_text_max of it still fits.
+ */
+D2B_API int d2b_convert_text( const struct d2b_options *options,
+        const struct d2b_span *spans, size_t count, char *buffer, size_t size,
+        size_t *offsets, size_t *done );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,63 @@
+/*******************************************************************************
+ * options.c    |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      The long option table; see options.h
+ ******************************************************************************/
+#include <string.h>
+
+#include "options.h"
+
+const struct option longOptions[] = {
+    { "help",           no_argument,        NULL,   'h' },
+    { "version",        no_argument,        NULL,   OPT_VERSION },
+    { "buffer-size",    required_argument,  NULL,   OPT_BUFFER_SIZE },
+    { "raw",            required_argument,  NULL,   OPT_RAW },
+    { "width",          required_argument,  NULL,   OPT_WIDTH },
+    { "stats",          optional_argument,  NULL,   OPT_STATS },
+    { "range",          no_argument,        NULL,   OPT_RANGE },
+    { "type",           required_argument,  NULL,   OPT_TYPE },
+    { "ieee",           required_argument,  NULL,   OPT_IEEE },
+    { "format",         required_argument,  NULL,   OPT_FORMAT },
+    { "cache",          optional_argument,  NULL,   OPT_CACHE },
+    { "serve",          required_argument,  NULL,   OPT_SERVE },
+    { "uring",          no_argument,        NULL,   OPT_URING },
+    { "group",          required_argument,  NULL,   OPT_GROUP },
+    { "sep",            required_argument,  NULL,   OPT_SEP },
+    { "bitstats",       no_argument,        NULL,   OPT_BITSTATS },
+    { NULL,             0,                  NULL,   0 }
+};
+
+
+/*  ----------------------  option_named  ---------------------------------
+ *
+ *  an exact match wins outright; otherwise the name given has to be the
+ *  start of exactly one option, as getopt_long has it
+ */
+const struct option *option_named( const char *arg, const char **value )
+{
+    const struct option *found = NULL;
+    const char *name = arg + 2;
+    size_t length = strcspn( name, "=" );
+    int matches = 0;
+    int i = 0;
+
+    if( strncmp( arg, "--", 2 ) != 0 || length == 0 )
+        return( NULL );
+
+    *value = ( name[length] == '=' ) ? name + length + 1 : NULL;
+
+    for( i = 0; longOptions[i].name != NULL; ++i )
+    {
+        if( strncmp( longOptions[i].name, name, length ) != 0 )
+            continue;
+        if( longOptions[i].name[length] == '\0' )
+            return( &longOptions[i] );
+
+        found = &longOptions[i];
+        ++matches;
+    }
+
+    return( ( matches == 1 ) ? found : NULL );
+}
@@ -0,0 +1,47 @@
+/*******************************************************************************
+ * options.h    |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      dec2bin's long options, in one table for getopt_long on the command
+ *      line and for --serve, which gets its options from --client requests
+ *      and can't use getopt (it keeps its place in globals, and a server
+ *      has a thread per connection).  option_named looks a long option up
+ *      the way getopt_long does, so --wid=8 means --width=8 either way.
+ ******************************************************************************/
+#ifndef DEC2BIN_OPTIONS_H
+#define DEC2BIN_OPTIONS_H
+
+#include <getopt.h>
+
+/*  Long options; the ones with no short form get codes past any character */
+enum
+{
+    OPT_VERSION = 256,
+    OPT_BUFFER_SIZE,
+    OPT_RAW,
+    OPT_WIDTH,
+    OPT_STATS,
+    OPT_RANGE,
+    OPT_TYPE,
+    OPT_IEEE,
+    OPT_FORMAT,
+    OPT_CACHE,
+    OPT_SERVE,
+    OPT_URING,
+    OPT_GROUP,
+    OPT_SEP,
+    OPT_BITSTATS
+};
+
+extern const struct option longOptions[];
+
+/*
+ *  Look up [arg], a "--name" or "--name=value" argument, in longOptions:
+ *  the whole name, or failing that a part of one that starts no other.
+ *  Returns the option's entry, with *value pointing past the '=' (NULL if
+ *  there isn't one), or NULL if [arg] names no option or more than one.
+ */
+const struct option *option_named( const char *arg, const char **value );
+
+#endif
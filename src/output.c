@@ -0,0 +1,319 @@
+/*******************************************************************************
+ * output.c     |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      Buffered bulk output; see output.h
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#include "output.h"
+#include "stats.h"
+#include "uring.h"
+
+
+/*  ------------------  output_fail ---------------------------
+ *
+ *  there's no sensible way to carry on once output is lost, so say why and
+ *  leave.  The writer is emptied first so the exit-time flush stays quiet.
+ */
+static void output_fail( struct output *out, const char *description )
+{
+    out->length = 0;
+    out->fd = -1;
+
+    fprintf(stderr, "ERROR:  %s\n", description );
+    exit(1);
+}
+
+
+int output_init( struct output *out, int fd, size_t flushSize )
+{
+    if( flushSize == 0 )
+        flushSize = DEFAULT_FLUSH_SIZE;
+
+    out->fd = fd;
+    out->length = 0;
+    out->written = 0;
+    out->writeNanos = 0;
+    out->ring = NULL;
+    out->flushSize = flushSize;
+    out->capacity = flushSize + 4096;   //  Slack so records rarely straddle
+    out->data = malloc( out->capacity );
+
+    if( out->data == NULL )
+    {
+        out->capacity = 0;
+        return( 1 );
+    }
+
+    return( 0 );
+}
+
+
+void output_free( struct output *out )
+{
+    /*  On io_uring, the buffer is the ring's */
+    if( out->ring != NULL )
+    {
+        uring_writer_close( out->ring );
+        out->ring = NULL;
+    }
+    else
+        free( out->data );
+    out->data = NULL;
+    out->length = 0;
+    out->capacity = 0;
+}
+
+
+/*  ------------------  write_vector    ---------------------------
+ *
+ *  writev() the whole of [iov], picking up wherever a short write stops,
+ *  and keep count of the bytes and the time
+ */
+static int write_vector( struct output *out, struct iovec *iov, int count )
+{
+    uint64_t start = monotonic_ns();
+    int i = 0;
+
+    for( i = 0; i < count; ++i )
+        out->written += iov[i].iov_len;
+
+    while( count > 0 )
+    {
+        ssize_t written = writev( out->fd, iov, count );
+
+        if( written < 0 )
+        {
+            if( errno == EINTR )
+                continue;
+            return( 1 );
+        }
+
+        while( count > 0 && (size_t)written >= iov->iov_len )
+        {
+            written -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if( count > 0 )
+        {
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+
+    out->writeNanos += monotonic_ns() - start;
+    return( 0 );
+}
+
+
+int output_use_uring( struct output *out )
+{
+    struct uring_writer *ring = NULL;
+    char *data = NULL;
+
+    if( out->fd < 0 || out->ring != NULL )
+        return( 1 );
+
+    ring = uring_writer_open( out->fd, out->capacity );
+    if( ring == NULL )
+        return( 1 );
+
+    /*  Whatever's already waiting (a --format header) moves over */
+    data = uring_writer_buffer( ring );
+    memcpy( data, out->data, out->length );
+    free( out->data );
+    out->data = data;
+    out->ring = ring;
+
+    return( 0 );
+}
+
+
+/*  ------------------  drop_uring  ---------------------------
+ *
+ *  go back to write() for good, once everything on io_uring is written; for
+ *  a record too big for its buffers
+ */
+static void drop_uring( struct output *out )
+{
+    char *data = malloc( out->capacity );
+
+    if( data == NULL )
+        output_fail( out, "Out of memory\nIn:  drop_uring" );
+    if( uring_writer_finish( out->ring ) == 1 )
+        output_fail( out, strerror( errno ) );
+
+    memcpy( data, out->data, out->length );
+    uring_writer_close( out->ring );
+    out->ring = NULL;
+    out->data = data;
+}
+
+
+int output_send( struct output *out )
+{
+    uint64_t start = 0;
+    char *data = NULL;
+
+    if( out->ring == NULL )
+        return( output_flush( out ) );
+    if( out->fd < 0 || out->length == 0 )
+        return( 0 );
+
+    start = monotonic_ns();
+    out->written += out->length;
+    data = uring_write( out->ring, out->length );
+    out->length = 0;
+    out->writeNanos += monotonic_ns() - start;
+
+    if( data == NULL )
+    {
+        output_fail( out, strerror( errno ) );
+        return( 1 );
+    }
+
+    out->data = data;
+    return( 0 );
+}
+
+
+int output_flush( struct output *out )
+{
+    struct iovec iov;
+    uint64_t start = 0;
+
+    if( out->fd < 0 )
+        return( 0 );
+
+    /*  io_uring: send the rest and wait for all of it */
+    if( out->ring != NULL )
+    {
+        output_send( out );
+
+        start = monotonic_ns();
+        if( uring_writer_finish( out->ring ) == 1 )
+        {
+            output_fail( out, strerror( errno ) );
+            return( 1 );
+        }
+        out->writeNanos += monotonic_ns() - start;
+
+        return( 0 );
+    }
+
+    if( out->length == 0 )
+        return( 0 );
+
+    iov.iov_base = out->data;
+    iov.iov_len = out->length;
+    out->length = 0;
+
+    if( write_vector( out, &iov, 1 ) == 1 )
+    {
+        output_fail( out, strerror( errno ) );
+        return( 1 );
+    }
+
+    return( 0 );
+}
+
+
+char *output_make_room( struct output *out, size_t n )
+{
+    /*  A real file gets flushed first; that may be all we need */
+    if( out->fd >= 0 && out->length > 0 )
+    {
+        output_send( out );
+        if( out->capacity >= n )
+            return( out->data );
+    }
+
+    /*  io_uring's buffers don't grow */
+    if( out->ring != NULL )
+        drop_uring( out );
+
+    /*  Otherwise (or for an oversized record) the buffer grows */
+    size_t capacity = out->capacity * 2;
+    if( capacity < out->length + n )
+        capacity = out->length + n;
+
+    char *data = realloc( out->data, capacity );
+    if( data == NULL )
+    {
+        output_fail( out, "Out of memory\nIn:  output_make_room" );
+        return( NULL );
+    }
+
+    out->data = data;
+    out->capacity = capacity;
+
+    return( out->data + out->length );
+}
+
+
+/*
+ *  Send everything waiting and then [n] bytes from [data], in one writev.
+ *  io_uring only writes from its own buffers, so there it's copied in.
+ */
+static void write_through( struct output *out, const void *data, size_t n )
+{
+    struct iovec iov[2];
+    const char *from = data;
+
+    while( out->ring != NULL && n > 0 )
+    {
+        size_t room = out->capacity - out->length;
+
+        if( room > n )
+            room = n;
+        memcpy( out->data + out->length, from, room );
+        output_commit( out, room );
+        from += room;
+        n -= room;
+    }
+    if( out->ring != NULL )
+        return;
+
+    iov[0].iov_base = out->data;
+    iov[0].iov_len = out->length;
+    iov[1].iov_base = (void *)data;
+    iov[1].iov_len = n;
+    out->length = 0;
+
+    if( write_vector( out, iov, 2 ) == 1 )
+        output_fail( out, strerror( errno ) );
+}
+
+
+void output_write( struct output *out, const void *data, size_t n )
+{
+    /*  Large blocks go straight out alongside whatever's waiting */
+    if( out->fd >= 0 && n >= out->flushSize )
+    {
+        write_through( out, data, n );
+        return;
+    }
+
+    memcpy( output_reserve( out, n ), data, n );
+    output_commit( out, n );
+}
+
+
+void output_pass( struct output *out, const void *data, size_t n )
+{
+    if( out->fd >= 0 && n >= OUTPUT_PASS_SIZE )
+    {
+        write_through( out, data, n );
+        return;
+    }
+
+    output_write( out, data, n );
+}
@@ -0,0 +1,104 @@
+/*******************************************************************************
+ * output.h     |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      Buffered bulk output.  Records are formatted straight into one large,
+ *      reusable buffer, which goes out in a few big write/writev calls once
+ *      it holds flushSize bytes (or when it's flushed by hand).  A writer with
+ *      no file descriptor just keeps growing, for output built in memory.
+ *      One writing to a file can hand its full buffers to io_uring instead,
+ *      and fill the next while they're written.
+ ******************************************************************************/
+#ifndef DEC2BIN_OUTPUT_H
+#define DEC2BIN_OUTPUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define DEFAULT_FLUSH_SIZE ( 1024 * 1024 )
+
+/*  Input passed through at least this big isn't copied; see output_pass */
+#define OUTPUT_PASS_SIZE ( 16 * 1024 )
+
+struct uring_writer;
+
+struct output
+{
+    char *data;             //  Bytes waiting to go out
+    size_t length;          //  How many of them there are
+    size_t capacity;        //  How many fit before we grow
+    size_t flushSize;       //  Flush once this many are waiting
+    int fd;                 //  Where they go; -1 keeps them in memory
+    size_t written;         //  Bytes written so far
+    uint64_t writeNanos;    //  Time spent writing them
+    struct uring_writer *ring;  //  Writing on io_uring, if not NULL
+};
+
+
+/*  Set up [out] to write to [fd]; returns 1 if out of memory */
+int output_init( struct output *out, int fd, size_t flushSize );
+
+/*  Release the buffer (without flushing it) */
+void output_free( struct output *out );
+
+/*
+ *  Write [out]'s file on io_uring from here on, if it can be had; returns 1
+ *  (and leaves [out] as it was) if not
+ */
+int output_use_uring( struct output *out );
+
+/*  Write everything waiting; returns 1 on a write error */
+int output_flush( struct output *out );
+
+/*  output_flush, except that on io_uring the writes may still be going */
+int output_send( struct output *out );
+
+/*  Make room for [n] more bytes, flushing or growing as needed */
+char *output_make_room( struct output *out, size_t n );
+
+/*  Append [n] bytes from [data]; big blocks skip the buffer with writev */
+void output_write( struct output *out, const void *data, size_t n );
+
+/*
+ *  output_write for input going out as it came in: a block of at least
+ *  OUTPUT_PASS_SIZE is written from where it is, so it has to be whole only
+ *  until this returns
+ */
+void output_pass( struct output *out, const void *data, size_t n );
+
+
+/*
+ *  Hot-path helpers.  output_reserve returns a pointer with room for [n]
+ *  bytes, output_commit marks [n] of them as used and flushes when the
+ *  buffer is full enough.
+ */
+static inline char *output_reserve( struct output *out, size_t n )
+{
+    if( out->capacity - out->length >= n )
+        return( out->data + out->length );
+
+    return( output_make_room( out, n ) );
+}
+
+static inline void output_commit( struct output *out, size_t n )
+{
+    out->length += n;
+
+    if( out->fd >= 0 && out->length >= out->flushSize )
+        output_send( out );
+}
+
+static inline void output_putc( struct output *out, char c )
+{
+    *output_reserve( out, 1 ) = c;
+    output_commit( out, 1 );
+}
+
+static inline void output_puts( struct output *out, const char *s )
+{
+    output_write( out, s, strlen( s ) );
+}
+
+#endif
@@ -0,0 +1,488 @@
+/*******************************************************************************
+ * parse.c      |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      Integer parsing; see parse.h
+ *
+ *  Notes:
+ *      Eight characters are loaded as one little-endian word, so the first
+ *      digit sits in the low byte.  A byte is a digit when its high nibble
+ *      is 3 both before and after adding 6; the lowest byte that fails is
+ *      where the run ends.  Taking '0' off every byte and shifting the run
+ *      up to the top of the word (zeroes coming in behind it are leading
+ *      zeroes) leaves something three multiplies turn into the value.
+ *
+ *      Binary digits go through the same kind of word (or vector) load: a
+ *      byte is a digit when it's '0' or '1', and bit 0 of each digit byte,
+ *      gathered up by a multiply (or a movemask), is the digit itself.  The
+ *      kernels hand the bits back first character lowest, so big-endian
+ *      strings get their bits reversed a byte at a time through a table.
+ *
+ *      Loads never cross into the next page, so reading past the end of a
+ *      token can't fault; near a page boundary we go a digit at a time.
+ ******************************************************************************/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "parse.h"
+
+#if defined(__x86_64__)
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+#define PAGE_SIZE 4096
+
+/*  Digits that always fit in 64 bits */
+#define SAFE_DIGITS 19
+
+/*  Every byte with its bits in the opposite order */
+#define REVERSED(n) ( \
+    (((n) & 0x01) << 7) | (((n) & 0x02) << 5) | (((n) & 0x04) << 3) | \
+    (((n) & 0x08) << 1) | (((n) & 0x10) >> 1) | (((n) & 0x20) >> 3) | \
+    (((n) & 0x40) >> 5) | (((n) & 0x80) >> 7) )
+#define ROW4(n)     REVERSED(n), REVERSED((n) + 1), REVERSED((n) + 2), \
+                    REVERSED((n) + 3)
+#define ROW16(n)    ROW4(n), ROW4((n) + 4), ROW4((n) + 8), ROW4((n) + 12)
+#define ROW64(n)    ROW16(n), ROW16((n) + 16), ROW16((n) + 32), \
+                    ROW16((n) + 48)
+
+static const unsigned char reversedBytes[256] = {
+    ROW64(0), ROW64(64), ROW64(128), ROW64(192)
+};
+
+static const uint64_t powersOfTen[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+    10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+    100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL
+};
+
+
+/*  Whether [n] bytes from [p] stay on p's page */
+static int can_load( const char *p, size_t n )
+{
+    return( ( (uintptr_t)p & ( PAGE_SIZE - 1 ) ) <= PAGE_SIZE - n );
+}
+
+
+/*  How many of the eight characters in [word] are digits, from the start */
+static int digit_count( uint64_t word )
+{
+    const uint64_t high = 0xF0F0F0F0F0F0F0F0ULL;
+    const uint64_t three = 0x3030303030303030ULL;
+    uint64_t bad = ( ( word & high ) ^ three ) |
+        ( ( ( word + 0x0606060606060606ULL ) & high ) ^ three );
+
+    if( bad == 0 )
+        return( 8 );
+
+    return( __builtin_ctzll( bad ) >> 3 );
+}
+
+
+/*  The value of the first [count] (1 to 8) digits in [word] */
+static uint64_t swar_value( uint64_t word, int count )
+{
+    word -= 0x3030303030303030ULL;
+    word <<= 8 * ( 8 - count );
+
+    word = word * 10 + ( word >> 8 );   //  Pairs of digits
+    word = ( ( ( word & 0x000000FF000000FFULL ) *
+                ( 100 + ( 1000000ULL << 32 ) ) ) +
+            ( ( ( word >> 16 ) & 0x000000FF000000FFULL ) *
+              ( 1 + ( 10000ULL << 32 ) ) ) ) >> 32;
+
+    return( word );
+}
+
+
+#ifdef HAVE_X86_KERNELS
+
+/*
+ *  Sixteen digits at once: multiply-add pairs, then pairs of pairs, then
+ *  pack and do it once more.  Returns 16, or how many of the characters
+ *  were digits (leaving *value alone) if the run is shorter.
+ */
+__attribute__((target("sse4.1")))
+static int parse_sse41( const char *p, uint64_t *value )
+{
+    __m128i digits = _mm_sub_epi8( _mm_loadu_si128( (const __m128i *)p ),
+            _mm_set1_epi8( '0' ) );
+    int valid = _mm_movemask_epi8( _mm_cmpeq_epi8(
+                _mm_min_epu8( digits, _mm_set1_epi8( 9 ) ), digits ) );
+
+    if( valid != 0xFFFF )
+        return( __builtin_ctz( ~valid ) );
+
+    __m128i pairs = _mm_maddubs_epi16( digits, _mm_setr_epi8(
+                10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1 ) );
+    __m128i quads = _mm_madd_epi16( pairs, _mm_setr_epi16(
+                100, 1, 100, 1, 100, 1, 100, 1 ) );
+    __m128i eights = _mm_madd_epi16( _mm_packus_epi32( quads, quads ),
+            _mm_setr_epi16( 10000, 1, 10000, 1, 10000, 1, 10000, 1 ) );
+
+    *value = (uint64_t)(uint32_t)_mm_cvtsi128_si32( eights ) * 100000000ULL +
+        (uint32_t)_mm_extract_epi32( eights, 1 );
+    return( 16 );
+}
+
+#endif
+
+/*
+ *  Eight binary digits at once.  Returns how many of the characters (from
+ *  the first) are '0' or '1'; *bits gets bit 0 of every character, the
+ *  first one lowest.
+ */
+static int bits_swar( const char *p, uint64_t *bits )
+{
+    uint64_t word;
+    uint64_t bad = 0;
+
+    memcpy( &word, p, 8 );
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64( word );
+#endif
+
+    bad = ( word ^ 0x3030303030303030ULL ) & 0xFEFEFEFEFEFEFEFEULL;
+    *bits = ( ( word & 0x0101010101010101ULL ) * 0x0102040810204080ULL ) >> 56;
+
+    return( ( bad == 0 ) ? 8 : __builtin_ctzll( bad ) >> 3 );
+}
+
+
+#ifdef HAVE_X86_KERNELS
+
+/*  Sixteen binary digits at once; same results as bits_swar */
+static int bits_sse2( const char *p, uint64_t *bits )
+{
+    __m128i chars = _mm_loadu_si128( (const __m128i *)p );
+    int ones = _mm_movemask_epi8( _mm_cmpeq_epi8( chars,
+                _mm_set1_epi8( '1' ) ) );
+    int valid = ones | _mm_movemask_epi8( _mm_cmpeq_epi8( chars,
+                _mm_set1_epi8( '0' ) ) );
+
+    *bits = (unsigned)ones;
+    return( ( valid == 0xFFFF ) ? 16 : __builtin_ctz( ~valid ) );
+}
+
+
+/*  Thirty-two binary digits at once */
+__attribute__((target("avx2")))
+static int bits_avx2( const char *p, uint64_t *bits )
+{
+    __m256i chars = _mm256_loadu_si256( (const __m256i *)p );
+    uint32_t ones = (uint32_t)_mm256_movemask_epi8( _mm256_cmpeq_epi8( chars,
+                _mm256_set1_epi8( '1' ) ) );
+    uint32_t valid = ones | (uint32_t)_mm256_movemask_epi8(
+            _mm256_cmpeq_epi8( chars, _mm256_set1_epi8( '0' ) ) );
+
+    *bits = ones;
+    return( ( valid == 0xFFFFFFFFU ) ? 32 : __builtin_ctz( ~valid ) );
+}
+
+#endif
+
+typedef int (*wide_kernel)( const char *p, uint64_t *value );
+
+static wide_kernel wideKernel = NULL;
+static wide_kernel bitsKernel = bits_swar;
+static int bitsStep = 8;
+
+__attribute__((constructor))
+static void select_parser( void )
+{
+#ifdef HAVE_X86_KERNELS
+    const char *limit = getenv( "DEC2BIN_KERNEL" );
+
+    if( limit != NULL && strcmp( limit, "scalar" ) == 0 )
+        return;
+
+    bitsKernel = bits_sse2;     //  SSE2 is always there on x86-64
+    bitsStep = 16;
+
+    if( limit != NULL && strcmp( limit, "sse2" ) == 0 )
+        return;
+
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports( "sse4.1" ) )
+        wideKernel = parse_sse41;
+    if( __builtin_cpu_supports( "avx2" ) )
+    {
+        bitsKernel = bits_avx2;
+        bitsStep = 32;
+    }
+#endif
+}
+
+
+/*  Append [count] digits worth [part] to [*value], watching for overflow */
+static void append_digits( uint64_t *value, uint64_t part, int count,
+        size_t *significant, int *overflow )
+{
+    *significant += count;
+
+    if( *significant <= SAFE_DIGITS )
+        *value = *value * powersOfTen[count] + part;
+    else if( *overflow == 0 &&
+            ( __builtin_mul_overflow( *value, powersOfTen[count], value ) ||
+              __builtin_add_overflow( *value, part, value ) ) )
+        *overflow = 1;
+}
+
+
+size_t parse_decimal( const char *s, uint64_t *value, int *overflow )
+{
+    const char *p = s;
+    uint64_t number = 0;
+    uint64_t part = 0;
+    size_t significant = 0;     //  Digits after the leading zeroes
+    int wide = ( wideKernel != NULL );
+    int count = 0;
+
+    *overflow = 0;
+
+    /*  Leading zeroes don't bring us any closer to overflowing */
+    while( *p == '0' )
+        ++p;
+
+    for( ;; )
+    {
+        if( wide && can_load( p, 16 ) )
+        {
+            if( wideKernel( p, &part ) == 16 )
+            {
+                append_digits( &number, part, 16, &significant, overflow );
+                p += 16;
+                continue;
+            }
+            wide = 0;   //  The run ends in there; SWAR finishes it
+        }
+
+        if( can_load( p, 8 ) )
+        {
+            uint64_t word;
+
+            memcpy( &word, p, 8 );
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            word = __builtin_bswap64( word );
+#endif
+            count = digit_count( word );
+            if( count == 0 )
+                break;
+            part = swar_value( word, count );
+        }
+        else
+        {
+            for( count = 0, part = 0; count < 8 &&
+                    (unsigned char)( p[count] - '0' ) <= 9; ++count )
+                part = part * 10 + (uint64_t)( p[count] - '0' );
+            if( count == 0 )
+                break;
+        }
+
+        append_digits( &number, part, count, &significant, overflow );
+        p += count;
+        if( count < 8 )
+            break;
+    }
+
+    *value = number;
+    return( p - s );
+}
+
+
+/*  The low [count] bits of [bits] in the opposite order */
+static uint64_t reverse_bits( uint64_t bits, int count )
+{
+    uint64_t reversed = 0;
+    int i = 0;
+
+    for( i = 0; i < count; i += 8 )
+        reversed = ( reversed << 8 ) | reversedBytes[ ( bits >> i ) & 0xff ];
+
+    return( reversed >> ( ( ( count + 7 ) & ~7 ) - count ) );
+}
+
+
+/*  Append [count] binary digits, first one in bit 0 of [bits], to *value */
+static void append_bits( uint64_t *value, uint64_t bits, int count,
+        int bigEndian, size_t *position, int *overflow )
+{
+    if( bigEndian == 1 )
+    {
+        /*  Leading zeroes are gone, so every digit counts */
+        if( *position + count > 64 )
+            *overflow = 1;
+        else if( count == 64 )
+            *value = reverse_bits( bits, count );
+        else
+            *value = ( *value << count ) | reverse_bits( bits, count );
+    }
+    else if( *position >= 64 )
+    {
+        if( bits != 0 )
+            *overflow = 1;
+    }
+    else
+    {
+        *value |= bits << *position;
+        if( *position + count > 64 && ( bits >> ( 64 - *position ) ) != 0 )
+            *overflow = 1;
+    }
+
+    *position += count;
+}
+
+
+size_t parse_binary( const char *s, int bigEndian, uint64_t *value,
+        int *overflow )
+{
+    const char *p = s;
+    uint64_t number = 0;
+    uint64_t bits = 0;
+    size_t position = 0;        //  Digits taken so far
+    int count = 0;
+    int step = 0;
+
+    *overflow = 0;
+
+    /*  Most significant first, leading zeroes are nothing */
+    if( bigEndian == 1 )
+        while( *p == '0' )
+            ++p;
+
+    for( ;; )
+    {
+        if( can_load( p, bitsStep ) )
+        {
+            step = bitsStep;
+            count = bitsKernel( p, &bits );
+        }
+        else if( can_load( p, 8 ) )
+        {
+            step = 8;
+            count = bits_swar( p, &bits );
+        }
+        else
+        {
+            step = 8;
+            for( count = 0, bits = 0; count < 8 &&
+                    ( p[count] == '0' || p[count] == '1' ); ++count )
+                bits |= (uint64_t)( p[count] - '0' ) << count;
+        }
+
+        if( count == 0 )
+            break;
+        if( count < 64 )
+            bits &= ( 1ULL << count ) - 1;
+
+        append_bits( &number, bits, count, bigEndian, &position, overflow );
+        p += count;
+        if( count < step )
+            break;
+    }
+
+    *value = number;
+    return( p - s );
+}
+
+
+/*  The value of hex digit [c], or 16 if it isn't one */
+static unsigned digit_value( unsigned char c )
+{
+    if( (unsigned char)( c - '0' ) <= 9 )
+        return( c - '0' );
+
+    c |= 0x20;      //  Either case
+    if( (unsigned char)( c - 'a' ) <= 5 )
+        return( c - 'a' + 10 );
+
+    return( 16 );
+}
+
+
+size_t parse_digits( const char *s, int bits, uint64_t *value,
+        int *overflow )
+{
+    const unsigned radix = 1U << bits;
+    const char *p = s;
+    uint64_t number = 0;
+    unsigned digit = 0;
+
+    *overflow = 0;
+
+    while( ( digit = digit_value( (unsigned char)*p ) ) < radix )
+    {
+        if( ( number >> ( 64 - bits ) ) != 0 )
+            *overflow = 1;
+
+        number = ( number << bits ) | digit;
+        ++p;
+    }
+
+    *value = number;
+    return( p - s );
+}
+
+
+/*  Powers of ten that doubles hold exactly */
+static const double exactPowers[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+    1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+
+/*  ----------------------  parse_real  ----------------------------------
+ *
+ *  both the digits and the power of ten are exact as doubles, so the one
+ *  rounding is the division's, and that's the correctly rounded result
+ */
+size_t parse_real( const char *s, double *value )
+{
+    const char *p = s;
+    uint64_t whole = 0;
+    uint64_t fraction = 0;
+    uint64_t digits = 0;
+    size_t wholeLength = 0;
+    size_t fractionLength = 0;
+    int negative = 0;
+    int overflow = 0;
+
+    if( *p == '-' || *p == '+' )
+        negative = ( *p++ == '-' );
+
+    wholeLength = parse_decimal( p, &whole, &overflow );
+    p += wholeLength;
+    if( overflow == 1 )
+        return(0);
+
+    if( *p == '.' )
+    {
+        fractionLength = parse_decimal( ++p, &fraction, &overflow );
+        p += fractionLength;
+        if( overflow == 1 )
+            return(0);
+    }
+
+    if( ( wholeLength == 0 && fractionLength == 0 ) || *p == 'e' ||
+            *p == 'E' || fractionLength >= sizeof( exactPowers ) /
+            sizeof( exactPowers[0] ) )
+        return(0);
+
+    /*  The digits without the point, which have to fit in 53 bits */
+    if( whole != 0 && ( fractionLength > 15 || __builtin_mul_overflow(
+                    whole, powersOfTen[fractionLength], &whole ) ) )
+        return(0);
+    if( __builtin_add_overflow( whole, fraction, &digits ) ||
+            digits > ( 1ULL << 53 ) )
+        return(0);
+
+    *value = (double)digits / exactPowers[fractionLength];
+    if( negative == 1 )
+        *value = -*value;
+
+    return( p - s );
+}
@@ -0,0 +1,47 @@
+/*******************************************************************************
+ * parse.h      |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      Integer parsing without strtoull or atof.  Decimal digits are taken
+ *      eight at a time with SWAR arithmetic on a 64-bit word, and sixteen at
+ *      a time with SSE4.1 when the CPU has it.  Binary digits (for reverse
+ *      mode) are folded into an integer sixteen at a time with an SSE2
+ *      compare and movemask, or thirty-two at a time with AVX2.  Plain
+ *      decimal fractions (for --ieee) get the same digit parsing and one
+ *      exact division.
+ ******************************************************************************/
+#ifndef DEC2BIN_PARSE_H
+#define DEC2BIN_PARSE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ *  Read the run of decimal digits at the start of [s] (which must end in
+ *  something that isn't a digit, like a NUL) into *value.  Returns the
+ *  length of the run.  *overflow is set to 1, and *value left meaningless,
+ *  if the number doesn't fit in 64 bits.
+ */
+size_t parse_decimal( const char *s, uint64_t *value, int *overflow );
+
+/*
+ *  The same for a run of '0' and '1' characters, most significant first if
+ *  [bigEndian] is 1 and last if it's 0
+ */
+size_t parse_binary( const char *s, int bigEndian, uint64_t *value,
+        int *overflow );
+
+/*  ... and for hex (4 [bits] per digit, either case) or octal (3 [bits]) */
+size_t parse_digits( const char *s, int bits, uint64_t *value,
+        int *overflow );
+
+/*
+ *  Read a plain decimal like -12.375 at the start of [s] into *value,
+ *  correctly rounded, when that can be done with one division: no exponent,
+ *  at most 22 digits after the point and at most 2^53 for all the digits
+ *  together.  Returns the length read, or 0 if [s] needs strtod.
+ */
+size_t parse_real( const char *s, double *value );
+
+#endif
@@ -0,0 +1,407 @@
+/*******************************************************************************
+ * pipeline.c   |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      Multi-threaded conversion of a large input stream; see pipeline.h
+ *
+ *  Notes:
+ *      Chunks live in a ring of slots, each going EMPTY -> FILLED (reader)
+ *      -> BUSY -> DONE (a worker) -> EMPTY (writer).  Sequence numbers are
+ *      handed out in input order, so slot (sequence % slotCount) is the only
+ *      place a chunk can be, and the writer just waits on the next one.  One
+ *      mutex and one condition variable cover everything; with chunks this
+ *      big, nobody waits on them much.
+ *
+ *      With positional output the writer has nothing left to write; it only
+ *      hands slots back to the reader in order.
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "pipeline.h"
+#include "reader.h"
+#include "stats.h"
+
+enum slot_state { SLOT_EMPTY, SLOT_FILLED, SLOT_BUSY, SLOT_DONE };
+
+struct slot
+{
+    char *data;                 //  Input chunk (plus a spare byte)
+    size_t length;
+    size_t capacity;
+    struct output out;          //  What the chunk converted to
+    size_t items;               //  Items the converter reported
+    size_t firstItem;           //  Items in all the chunks before this one
+    uint64_t placeNanos;        //  Time the worker spent in pwrite
+    enum slot_state state;
+};
+
+struct pipeline
+{
+    const struct pipeline_job *job;
+    int fd;
+    struct pipeline_totals *totals;     //  Read counts belong to the reader
+
+    struct slot *slots;
+    int slotCount;
+
+    size_t nextFill;            //  Sequence number the reader fills next
+    size_t nextProcess;         //  ... a worker takes next
+    size_t nextWrite;           //  ... the writer waits on next
+    int finished;               //  Reader is done; nextFill is final
+    int failed;                 //  Somebody gave up; everyone stops
+
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+};
+
+
+/*  Mark the run as failed and wake everybody so they notice */
+static void pipeline_fail( struct pipeline *p, const char *description )
+{
+    pthread_mutex_lock( &p->lock );
+    if( p->failed == 0 )
+        fprintf(stderr, "ERROR:  %s\n", description );
+    p->failed = 1;
+    pthread_cond_broadcast( &p->changed );
+    pthread_mutex_unlock( &p->lock );
+}
+
+
+/*  Make sure [buffer] can hold [needed] bytes plus the spare one */
+static int grow( char **buffer, size_t *capacity, size_t needed )
+{
+    if( *capacity >= needed )
+        return( 0 );
+
+    char *data = realloc( *buffer, needed + 1 );
+    if( data == NULL )
+        return( 1 );
+
+    *buffer = data;
+    *capacity = needed;
+    return( 0 );
+}
+
+
+/*  ------------------  reader_thread   ---------------------------
+ *
+ *  fill slots in order.  With splitTokens, a chunk ends after its last
+ *  separator and the partial token behind it starts the next chunk;
+ *  splitLines does the same with the last newline.
+ */
+static void *reader_thread( void *argument )
+{
+    struct pipeline *p = argument;
+    const struct pipeline_job *job = p->job;
+    size_t itemsSoFar = 0;
+    char *carry = NULL;
+    size_t carryLength = 0;
+    size_t carryCapacity = 0;
+    int eof = 0;
+
+    while( eof == 0 )
+    {
+        pthread_mutex_lock( &p->lock );
+        struct slot *slot = &p->slots[ p->nextFill % p->slotCount ];
+        while( slot->state != SLOT_EMPTY && p->failed == 0 )
+            pthread_cond_wait( &p->changed, &p->lock );
+        pthread_mutex_unlock( &p->lock );
+
+        if( p->failed )
+            break;
+
+        if( grow( &slot->data, &slot->capacity, job->chunkSize ) == 1 ||
+                grow( &slot->data, &slot->capacity, carryLength ) == 1 )
+        {
+            pipeline_fail( p, "Out of memory\nIn:  reader_thread" );
+            break;
+        }
+
+        memcpy( slot->data, carry, carryLength );
+        slot->length = carryLength;
+        carryLength = 0;
+
+        while( eof == 0 )
+        {
+            /*  Only a token longer than the whole chunk gets us here */
+            if( slot->length == slot->capacity &&
+                    grow( &slot->data, &slot->capacity,
+                        slot->capacity * 2 ) == 1 )
+            {
+                pipeline_fail( p, "Out of memory\nIn:  reader_thread" );
+                eof = -1;
+                break;
+            }
+
+            uint64_t start = monotonic_ns();
+            ssize_t got = read( p->fd, slot->data + slot->length,
+                    slot->capacity - slot->length );
+            p->totals->readNanos += monotonic_ns() - start;
+            if( got < 0 )
+            {
+                if( errno == EINTR )
+                    continue;
+                pipeline_fail( p, strerror( errno ) );
+                eof = -1;
+                break;
+            }
+            if( got == 0 )
+            {
+                eof = 1;
+                break;
+            }
+
+            slot->length += got;
+            p->totals->bytesRead += got;
+            if( slot->length < job->chunkSize )
+                continue;
+            if( job->splitTokens == 0 && job->splitLines == 0 )
+                break;
+
+            size_t cut = ( job->splitLines == 1 ) ?
+                last_newline_end( slot->data, slot->length ) :
+                last_separator_end( slot->data, slot->length );
+            if( cut > 0 )
+            {
+                carryLength = slot->length - cut;
+                if( grow( &carry, &carryCapacity, carryLength ) == 1 )
+                {
+                    pipeline_fail( p, "Out of memory\nIn:  reader_thread" );
+                    eof = -1;
+                    break;
+                }
+                memcpy( carry, slot->data + cut, carryLength );
+                slot->length = cut;
+                break;
+            }
+        }
+
+        if( eof < 0 || slot->length == 0 )
+            break;
+
+        if( job->positionalFd >= 0 )
+        {
+            slot->firstItem = itemsSoFar;
+            itemsSoFar += job->count( slot->data, slot->length, job->context );
+        }
+
+        pthread_mutex_lock( &p->lock );
+        slot->state = SLOT_FILLED;
+        ++p->nextFill;
+        pthread_cond_broadcast( &p->changed );
+        pthread_mutex_unlock( &p->lock );
+    }
+
+    free( carry );
+
+    pthread_mutex_lock( &p->lock );
+    p->finished = 1;
+    pthread_cond_broadcast( &p->changed );
+    pthread_mutex_unlock( &p->lock );
+
+    return( NULL );
+}
+
+
+/*  ------------------  write_in_place  ---------------------------
+ *
+ *  pwrite a converted chunk to where its first item goes.  With
+ *  dropFirstByte every item's output starts with its separator, so all but
+ *  the first chunk start a byte early.  Returns 1 on a write error.
+ */
+static int write_in_place( const struct pipeline_job *job, struct slot *slot )
+{
+    const char *data = slot->out.data;
+    size_t length = slot->out.length;
+    off_t offset = (off_t)( slot->firstItem * job->itemSize );
+    uint64_t start = monotonic_ns();
+
+    if( job->dropFirstByte && length > 0 )
+    {
+        if( slot->firstItem == 0 )
+        {
+            ++data;
+            --length;
+        }
+        else
+            --offset;
+    }
+
+    while( length > 0 )
+    {
+        ssize_t wrote = pwrite( job->positionalFd, data, length, offset );
+        if( wrote < 0 )
+        {
+            if( errno == EINTR )
+                continue;
+            return( 1 );
+        }
+
+        data += wrote;
+        length -= wrote;
+        offset += wrote;
+    }
+
+    slot->placeNanos = monotonic_ns() - start;
+    return( 0 );
+}
+
+
+/*  ------------------  worker_thread   ---------------------------
+ *
+ *  take the oldest filled chunk, convert it, repeat
+ */
+static void *worker_thread( void *argument )
+{
+    struct pipeline *p = argument;
+    const struct pipeline_job *job = p->job;
+
+    pthread_mutex_lock( &p->lock );
+    for( ;; )
+    {
+        while( p->failed == 0 && p->nextProcess == p->nextFill &&
+                p->finished == 0 )
+            pthread_cond_wait( &p->changed, &p->lock );
+
+        if( p->failed || p->nextProcess == p->nextFill )
+            break;
+
+        struct slot *slot = &p->slots[ p->nextProcess % p->slotCount ];
+        ++p->nextProcess;
+        slot->state = SLOT_BUSY;
+        pthread_mutex_unlock( &p->lock );
+
+        slot->out.length = 0;
+        slot->items = job->convert( &slot->out, slot->data, slot->length,
+                job->context );
+
+        if( job->positionalFd >= 0 && write_in_place( job, slot ) == 1 )
+        {
+            pipeline_fail( p, strerror( errno ) );
+            pthread_mutex_lock( &p->lock );
+            break;
+        }
+
+        pthread_mutex_lock( &p->lock );
+        slot->state = SLOT_DONE;
+        pthread_cond_broadcast( &p->changed );
+    }
+    pthread_mutex_unlock( &p->lock );
+
+    return( NULL );
+}
+
+
+int pipeline_run( int fd, struct output *out, const struct pipeline_job *job,
+        struct pipeline_totals *totals )
+{
+    struct pipeline p;
+    pthread_t reader;
+    pthread_t workers[PIPELINE_MAX_THREADS];
+    int readerStarted = 0;
+    int workerCount = 0;
+    int dropped = 0;
+    int i = 0;
+
+    memset( &p, 0, sizeof( p ) );
+    p.job = job;
+    p.fd = fd;
+    p.totals = totals;
+    p.slotCount = 2 * job->threads + 2;     //  Enough to keep everyone busy
+    p.slots = calloc( p.slotCount, sizeof( struct slot ) );
+    memset( totals, 0, sizeof( *totals ) );
+
+    if( p.slots == NULL )
+    {
+        fprintf(stderr, "ERROR:  Out of memory\nIn:  pipeline_run\n");
+        return( 1 );
+    }
+    for( i = 0; i < p.slotCount; ++i )
+    {
+        if( output_init( &p.slots[i].out, -1, job->chunkSize ) == 1 )
+        {
+            p.slotCount = i;
+            p.failed = 1;
+            fprintf(stderr, "ERROR:  Out of memory\nIn:  pipeline_run\n");
+            break;
+        }
+    }
+
+    pthread_mutex_init( &p.lock, NULL );
+    pthread_cond_init( &p.changed, NULL );
+
+    if( p.failed == 0 )
+    {
+        if( pthread_create( &reader, NULL, reader_thread, &p ) != 0 )
+            pipeline_fail( &p, "Could not start the reader thread" );
+        else
+            readerStarted = 1;
+
+        for( i = 0; i < job->threads && p.failed == 0; ++i )
+        {
+            if( pthread_create( &workers[i], NULL, worker_thread, &p ) != 0 )
+                pipeline_fail( &p, "Could not start a worker thread" );
+            else
+                ++workerCount;
+        }
+    }
+
+    /*  We're the writer: chunks go out strictly in the order they came in */
+    while( p.failed == 0 )
+    {
+        pthread_mutex_lock( &p.lock );
+        struct slot *slot = &p.slots[ p.nextWrite % p.slotCount ];
+        while( p.failed == 0 && slot->state != SLOT_DONE &&
+                ! ( p.finished && p.nextWrite == p.nextFill ) )
+            pthread_cond_wait( &p.changed, &p.lock );
+        pthread_mutex_unlock( &p.lock );
+
+        if( p.failed || slot->state != SLOT_DONE )
+            break;
+
+        const char *data = slot->out.data;
+        size_t length = slot->out.length;
+        if( job->dropFirstByte && dropped == 0 && length > 0 )
+        {
+            ++data;
+            --length;
+            dropped = 1;
+        }
+        if( job->positionalFd < 0 )
+            output_write( out, data, length );
+        else
+        {
+            totals->bytesPlaced += length;
+            totals->placeNanos += slot->placeNanos;
+        }
+        totals->items += slot->items;
+
+        pthread_mutex_lock( &p.lock );
+        slot->state = SLOT_EMPTY;
+        ++p.nextWrite;
+        pthread_cond_broadcast( &p.changed );
+        pthread_mutex_unlock( &p.lock );
+    }
+
+    if( readerStarted )
+        pthread_join( reader, NULL );
+    for( i = 0; i < workerCount; ++i )
+        pthread_join( workers[i], NULL );
+
+    for( i = 0; i < p.slotCount; ++i )
+    {
+        free( p.slots[i].data );
+        output_free( &p.slots[i].out );
+    }
+    free( p.slots );
+    pthread_mutex_destroy( &p.lock );
+    pthread_cond_destroy( &p.changed );
+
+    return( p.failed );
+}
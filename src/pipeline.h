@@ -0,0 +1,73 @@
+/*******************************************************************************
+ * pipeline.h   |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      Multi-threaded conversion of a large input stream.  A reader thread
+ *      cuts the input into chunks (ending on a token boundary when asked
+ *      to), a pool of workers converts chunks into their own output buffers
+ *      and the calling thread writes those buffers out in input order.  A
+ *      fixed ring of chunk slots keeps memory bounded.
+ *
+ *      When every item converts to the same number of bytes, the reader can
+ *      count the items in each chunk as it goes, and then each worker knows
+ *      where its output belongs and writes it there itself with pwrite.
+ ******************************************************************************/
+#ifndef DEC2BIN_PIPELINE_H
+#define DEC2BIN_PIPELINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "output.h"
+
+#define PIPELINE_CHUNK_SIZE ( 4 * 1024 * 1024 )
+#define PIPELINE_MAX_THREADS 256
+
+/*
+ *  Converts one chunk into [out].  [data] is writable and has a spare byte
+ *  at data[length].  Returns the number of items it printed.
+ */
+typedef size_t (*chunk_converter)( struct output *out, char *data,
+        size_t length, void *context );
+
+/*  Counts the items in a chunk without converting it, for positional output */
+typedef size_t (*chunk_counter)( const char *data, size_t length,
+        void *context );
+
+struct pipeline_job
+{
+    int threads;                //  Worker threads
+    size_t chunkSize;           //  Input bytes per chunk (before alignment)
+    int splitTokens;            //  1 to end chunks on a separator
+    int splitLines;             //  1 to end them on a newline instead
+    int dropFirstByte;          //  1 to drop the first byte of all output
+    chunk_converter convert;
+    void *context;
+
+    int positionalFd;           //  -1, or a file workers pwrite straight to
+    size_t itemSize;            //  Output bytes per item, for positionalFd
+    chunk_counter count;        //  ... and how to count them
+};
+
+/*  What a run got through */
+struct pipeline_totals
+{
+    size_t items;               //  Summed from what the converter reported
+    size_t bytesRead;
+    uint64_t readNanos;         //  Time in read()
+    size_t bytesPlaced;         //  Bytes the workers wrote to positionalFd
+    uint64_t placeNanos;        //  ... and the time they took, all together
+};
+
+
+/*
+ *  Run [job] over everything readable from [fd], writing to [out] (or to
+ *  job->positionalFd, item n at n * job->itemSize).  Fills in [totals].
+ *  Returns 0 on success, 1 if something went wrong (a message has been
+ *  printed).
+ */
+int pipeline_run( int fd, struct output *out, const struct pipeline_job *job,
+        struct pipeline_totals *totals );
+
+#endif
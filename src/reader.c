@@ -0,0 +1,268 @@
+/*******************************************************************************
+ * reader.c     |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      Streaming input; see reader.h
+ ******************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "reader.h"
+#include "stats.h"
+#include "uring.h"
+
+
+/*  The separators we split on; anything else is part of a token */
+static int is_separator( char c )
+{
+    return( c == ' ' || c == '\n' || c == '\t' || c == '\r' ||
+            c == '\v' || c == '\f' );
+}
+
+
+/*  What separates lines, for reverse mode's spaced-out records */
+static int is_newline( char c )
+{
+    return( c == '\n' );
+}
+
+
+int reader_init( struct reader *in, int fd, size_t blockSize )
+{
+    if( blockSize == 0 )
+        blockSize = READ_BLOCK_SIZE;
+
+    in->fd = fd;
+    in->capacity = blockSize;
+    in->start = 0;
+    in->end = 0;
+    in->eof = 0;
+    in->bytesRead = 0;
+    in->readNanos = 0;
+    in->ring = NULL;
+    in->before_read = NULL;
+    in->context = NULL;
+    in->data = malloc( blockSize + 1 );
+
+    return( in->data == NULL );
+}
+
+
+void reader_free( struct reader *in )
+{
+    free( in->data );
+    in->data = NULL;
+}
+
+
+/*  ------------------  reader_fill ---------------------------
+ *
+ *  slide the unread bytes to the front of the block and read in behind
+ *  them, growing the block if it's already full of one token.  Returns the
+ *  number of new bytes, 0 at end of input, -1 on error.
+ */
+static long reader_fill( struct reader *in )
+{
+    ssize_t got = 0;
+    uint64_t start = 0;
+
+    if( in->eof == 1 )
+        return( 0 );
+
+    if( in->start > 0 )
+    {
+        memmove( in->data, in->data + in->start, in->end - in->start );
+        in->end -= in->start;
+        in->start = 0;
+    }
+
+    if( in->end == in->capacity )
+    {
+        char *data = realloc( in->data, in->capacity * 2 + 1 );
+        if( data == NULL )
+            return( -1 );
+
+        in->data = data;
+        in->capacity *= 2;
+    }
+
+    if( in->before_read != NULL )
+        in->before_read( in->context );
+
+    start = monotonic_ns();
+    do
+    {
+        if( in->ring != NULL )
+            got = uring_read( in->ring, in->data + in->end,
+                    in->capacity - in->end );
+        else
+            got = read( in->fd, in->data + in->end, in->capacity - in->end );
+    } while( got < 0 && errno == EINTR );
+    in->readNanos += monotonic_ns() - start;
+
+    if( got < 0 )
+        return( -1 );
+    if( got == 0 )
+        in->eof = 1;
+
+    in->end += got;
+    in->bytesRead += got;
+    return( got );
+}
+
+
+/*  Next piece of input between [separates] characters */
+static int reader_next( struct reader *in, struct token *token,
+        int (*separates)( char ) )
+{
+    size_t i = in->start;
+    long got = 0;
+
+    /*  Skip separators, reading more as we run out */
+    for( ;; )
+    {
+        while( i < in->end && separates( in->data[i] ) )
+            ++i;
+        if( i < in->end )
+            break;
+
+        in->start = i;
+        if( ( got = reader_fill( in ) ) <= 0 )
+            return( (int)got );
+        i = in->start;
+    }
+
+    /*  Find the end of the token; if the block ends first, read on */
+    size_t length = 0;
+    in->start = i;
+    for( ;; )
+    {
+        while( in->start + length < in->end &&
+                ! separates( in->data[in->start + length] ) )
+            ++length;
+        if( in->start + length < in->end || in->eof == 1 )
+            break;
+
+        if( ( got = reader_fill( in ) ) < 0 )
+            return( -1 );
+    }
+
+    token->data = in->data + in->start;
+    token->length = length;
+    token->data[length] = '\0';     //  Over a separator, or the spare byte
+
+    in->start += length;
+    if( in->start < in->end )
+        ++in->start;                //  That separator is used up
+
+    return( 1 );
+}
+
+
+int reader_next_token( struct reader *in, struct token *token )
+{
+    return( reader_next( in, token, is_separator ) );
+}
+
+
+int reader_next_line( struct reader *in, struct token *token )
+{
+    return( reader_next( in, token, is_newline ) );
+}
+
+
+int reader_next_block( struct reader *in, struct token *block )
+{
+    long got = 0;
+
+    if( in->start == in->end )
+    {
+        in->start = 0;
+        in->end = 0;
+        if( ( got = reader_fill( in ) ) <= 0 )
+            return( (int)got );
+    }
+
+    block->data = in->data + in->start;
+    block->length = in->end - in->start;
+    in->start = in->end;
+
+    return( 1 );
+}
+
+
+/*  Next piece of a buffer between [separates] characters */
+static int buffer_next( char **cursor, char *end, struct token *token,
+        int (*separates)( char ) )
+{
+    char *p = *cursor;
+
+    while( p < end && separates( *p ) )
+        ++p;
+    if( p == end )
+    {
+        *cursor = p;
+        return( 0 );
+    }
+
+    token->data = p;
+    while( p < end && ! separates( *p ) )
+        ++p;
+    token->length = p - token->data;
+    *p = '\0';
+
+    *cursor = ( p < end ) ? p + 1 : p;
+    return( 1 );
+}
+
+
+int buffer_next_token( char **cursor, char *end, struct token *token )
+{
+    return( buffer_next( cursor, end, token, is_separator ) );
+}
+
+
+int buffer_next_line( char **cursor, char *end, struct token *token )
+{
+    return( buffer_next( cursor, end, token, is_newline ) );
+}
+
+
+size_t last_separator_end( const char *data, size_t length )
+{
+    while( length > 0 && ! is_separator( data[length - 1] ) )
+        --length;
+
+    return( length );
+}
+
+
+size_t last_newline_end( const char *data, size_t length )
+{
+    while( length > 0 && ! is_newline( data[length - 1] ) )
+        --length;
+
+    return( length );
+}
+
+
+size_t count_tokens( const char *data, size_t length )
+{
+    size_t count = 0;
+    size_t i = 0;
+    int inToken = 0;
+
+    /*  Every step from a separator (or the start) onto a token is one more */
+    for( i = 0; i < length; ++i )
+    {
+        int separator = is_separator( data[i] );
+
+        count += ( inToken == 0 && separator == 0 );
+        inToken = ! separator;
+    }
+
+    return( count );
+}
@@ -0,0 +1,132 @@
+/*******************************************************************************
+ * reader.h     |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      Streaming input.  Pulls large blocks from a file descriptor and splits
+ *      them into whitespace-separated tokens, carrying a token over the end of
+ *      one block into the next.  Tokens are handed out as views into the
+ *      block, so nothing gets copied, and memory stays at one block unless a
+ *      single token is bigger than that.
+ ******************************************************************************/
+#ifndef DEC2BIN_READER_H
+#define DEC2BIN_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#define READ_BLOCK_SIZE ( 1024 * 1024 )
+
+struct uring_reader;
+
+struct reader
+{
+    int fd;                 //  Where the input comes from
+    char *data;             //  The current block (plus a byte for a null)
+    size_t capacity;        //  Size of that block
+    size_t start;           //  First byte not yet handed out
+    size_t end;             //  One past the last byte read in
+    int eof;                //  1 once read() has nothing more for us
+    size_t bytesRead;       //  Everything read() has given us
+    uint64_t readNanos;     //  Time spent in read()
+    struct uring_reader *ring;  //  Reads ahead on io_uring, if set
+
+    /*  Called just before read() might block, if set */
+    void (*before_read)( void *context );
+    void *context;
+};
+
+/*  A token, pointing into the reader's block; good until the next call */
+struct token
+{
+    char *data;
+    size_t length;
+};
+
+
+/*  Set up [in] to read [fd] in blocks of [blockSize]; 1 if out of memory */
+int reader_init( struct reader *in, int fd, size_t blockSize );
+
+void reader_free( struct reader *in );
+
+/*
+ *  Find the next whitespace-separated token.  Its text is null-terminated
+ *  in place (the byte after it was whitespace we'd skip anyway).  Returns 1
+ *  for a token, 0 at the end of the input and -1 on a read error.
+ */
+int reader_next_token( struct reader *in, struct token *token );
+
+/*
+ *  The same, but splitting on newlines only, so a token is a whole line
+ *  (spaces and all); empty lines are skipped
+ */
+int reader_next_line( struct reader *in, struct token *token );
+
+/*
+ *  Hand out whatever is buffered, reading a block first if there's nothing;
+ *  for input that isn't split into tokens.  Same return values as above.
+ */
+int reader_next_block( struct reader *in, struct token *block );
+
+/*
+ *  Split a buffer already in memory: find the next token at or after
+ *  *cursor (but before [end]), null-terminate it and move *cursor past it.
+ *  *end must be writable.  Returns 1 for a token, 0 when there are no more.
+ */
+int buffer_next_token( char **cursor, char *end, struct token *token );
+
+/*  buffer_next_token for lines, as reader_next_line */
+int buffer_next_line( char **cursor, char *end, struct token *token );
+
+/*
+ *  For -k: a bit for each of the 16 bytes from [from] (fewer if [end]
+ *  comes first) that's a [delimiter] or a newline, the first byte in the
+ *  lowest bit, with the newlines alone in [*newlines].  Going through the
+ *  input 16 bytes at a time like this finds every field in one pass,
+ *  however short they are.
+ */
+static inline unsigned field_stops( const char *from, const char *end,
+        char delimiter, unsigned *newlines )
+{
+    unsigned stops = 0;
+    int i = 0;
+
+#if defined(__x86_64__)
+    if( end - from >= 16 )
+    {
+        __m128i bytes = _mm_loadu_si128( (const __m128i *)from );
+        __m128i lines = _mm_cmpeq_epi8( bytes, _mm_set1_epi8( '\n' ) );
+
+        *newlines = _mm_movemask_epi8( lines );
+        return( _mm_movemask_epi8( _mm_or_si128( lines,
+                        _mm_cmpeq_epi8( bytes,
+                            _mm_set1_epi8( delimiter ) ) ) ) );
+    }
+#endif
+
+    *newlines = 0;
+    for( i = 0; i < 16 && from + i < end; ++i )
+    {
+        if( from[i] == '\n' )
+            *newlines |= 1u << i;
+        if( from[i] == delimiter || from[i] == '\n' )
+            stops |= 1u << i;
+    }
+
+    return( stops );
+}
+
+/*  Offset just past the last separator in [data], or 0 if there isn't one */
+size_t last_separator_end( const char *data, size_t length );
+
+/*  The same for a newline */
+size_t last_newline_end( const char *data, size_t length );
+
+/*  How many tokens buffer_next_token would find in [data] */
+size_t count_tokens( const char *data, size_t length );
+
+#endif
@@ -0,0 +1,1161 @@
+/*******************************************************************************
+ * serve.c      |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      A resident server and its client; see serve.h
+ *
+ *  Notes:
+ *      The server converts with the library alone, options and all kept per
+ *      connection, so connections never wait on each other.  That's why it
+ *      takes the output options (and -t, --width, --type, --ieee, --format,
+ *      --group and --sep) but not the ones about files, threads or reading
+ *      records back (-i, -O, -f, -j, -r, --raw, --range, --cache): it
+ *      refuses those.
+ *
+ *      The client sends from one thread and reads answers on another, so a
+ *      server busy writing a big answer never waits on a client busy
+ *      writing a big request.  At most SERVE_DEPTH requests are out at once.
+ ******************************************************************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#include "serve.h"
+#include "libdec2bin.h"
+#include "output.h"
+#include "reader.h"
+#include "stats.h"
+#include "options.h"
+
+/*  A client reading stdin sends a request per this many numbers ... */
+#define SERVE_BATCH 4096
+
+/*  ... or this many bytes of them, whichever comes first */
+#define SERVE_BATCH_BYTES ( 64 * 1024 )
+
+/*  Requests a client has out at once */
+#define SERVE_DEPTH 16
+
+/*  Length, then flags or status, then a count or a length */
+#define SERVE_HEADER 9
+
+/*  Bytes each connection's output starts with */
+#define SERVE_OUTPUT_SIZE ( 64 * 1024 )
+
+/*  Longest --width */
+#define SERVE_MAX_WIDTH 64
+
+/*  One connection: a run of dec2bin, with the options of its last request */
+struct session
+{
+    int fd;
+    char *frame;                //  The request being served
+    size_t frameCapacity;
+    char **args;                //  ... split into its strings
+    size_t argCapacity;
+
+    struct d2b_options options;
+    int textMode;
+    int ieeeFormat;
+    d2b_typed_kernel typedKernel;
+    const char *typeName;
+    int groupMode;              //  --group or --sep was given
+    size_t pCount;              //  Records so far this run, for -l
+
+    struct output out;          //  What would have gone to stdout
+    struct output err;          //  ... and to stderr
+};
+
+/*  The client's side of a run */
+struct client
+{
+    int fd;
+    char **options;
+    size_t optionCount;
+    struct output request;      //  The request being put together
+    size_t tokens;              //  Numbers in it so far
+    int flags;                  //  Its flags
+
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    uint64_t sent[SERVE_DEPTH]; //  When each request out went
+    size_t requests;            //  Requests sent
+    size_t answered;            //  Responses read
+    int finished;               //  Nothing more to send; requests is final
+    struct stats stats;
+};
+
+static const char *servePath;   //  Our socket, removed when we're stopped
+
+
+static void put_u32( unsigned char *p, uint32_t value )
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+
+static uint32_t get_u32( const unsigned char *p )
+{
+    return( p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24 );
+}
+
+
+/*  Write all of [count] pieces; returns 1 if the other end is gone */
+static int send_all( int fd, struct iovec *iov, int count )
+{
+    while( count > 0 )
+    {
+        ssize_t sent = writev( fd, iov, count );
+
+        if( sent < 0 && errno == EINTR )
+            continue;
+        if( sent < 0 )
+            return( 1 );
+
+        while( count > 0 && (size_t)sent >= iov->iov_len )
+        {
+            sent -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if( count > 0 )
+        {
+            iov->iov_base = (char *)iov->iov_base + sent;
+            iov->iov_len -= sent;
+        }
+    }
+
+    return( 0 );
+}
+
+
+/*  Read [n] bytes; 1 if we got them, 0 if the input ended first, -1 on error */
+static int read_all( int fd, void *data, size_t n )
+{
+    char *p = data;
+
+    while( n > 0 )
+    {
+        ssize_t got = read( fd, p, n );
+
+        if( got < 0 && errno == EINTR )
+            continue;
+        if( got < 0 )
+            return( -1 );
+        if( got == 0 )
+            return( 0 );
+
+        p += got;
+        n -= got;
+    }
+
+    return( 1 );
+}
+
+
+/*  ----------------------  read_frame  ----------------------------------
+ *
+ *  read the next frame into [*buffer], growing it as needed, with a null
+ *  after it.  Returns its length, 0 if the connection closed cleanly before
+ *  one started, or -1 if it broke off, was over [limit] or we ran out of
+ *  memory.
+ */
+static long long read_frame( int fd, char **buffer, size_t *capacity,
+        size_t limit )
+{
+    unsigned char prefix[4];
+    size_t length = 0;
+    int got = read_all( fd, prefix, 4 );
+
+    if( got <= 0 )
+        return( got );
+
+    length = get_u32( prefix );
+    if( length > limit )
+        return( -1 );
+
+    if( length + 1 > *capacity )
+    {
+        char *grown = realloc( *buffer, length + 1 );
+
+        if( grown == NULL )
+            return( -1 );
+        *buffer = grown;
+        *capacity = length + 1;
+    }
+
+    if( read_all( fd, *buffer, length ) != 1 )
+        return( -1 );
+    (*buffer)[length] = '\0';
+
+    return( (long long)length );
+}
+
+
+/*  Add a printf-style message to what the session would print on stderr */
+static void session_error( struct session *s, const char *format, ... )
+{
+    va_list args;
+    va_list again;
+    int length = 0;
+
+    va_start( args, format );
+    va_copy( again, args );
+    length = vsnprintf( NULL, 0, format, args );
+    vsnprintf( output_reserve( &s->err, length + 1 ), length + 1, format,
+            again );
+    output_commit( &s->err, length );
+    va_end( again );
+    va_end( args );
+}
+
+
+/*  ----------------------  session_option  ------------------------------
+ *
+ *  apply one option from a request, the way dec2bin's command line would.
+ *  Returns 1 (with the message for stderr) if it's not one we take.
+ */
+static int session_option( struct session *s, const char *arg )
+{
+    struct d2b_options *options = &s->options;
+    const char *value = NULL;
+
+    if( arg[0] != '-' || arg[1] == '\0' )
+    {
+        session_error( s, "ERROR:  '%s' is not an option\n", arg );
+        return(1);
+    }
+
+    if( arg[1] == '-' )
+    {
+        const struct option *option = option_named( arg, &value );
+
+        if( option == NULL )
+        {
+            session_error( s, "ERROR:  '%s' is not an option\n", arg );
+            return(1);
+        }
+        if( option->has_arg == required_argument && value == NULL )
+        {
+            session_error( s, "ERROR:  --%s needs a value\n", option->name );
+            return(1);
+        }
+
+        switch( option->val )
+        {
+            case OPT_WIDTH:
+                options->width = atoi( value );
+                if( options->width < 1 || options->width > SERVE_MAX_WIDTH )
+                {
+                    session_error( s, "ERROR:  --width takes 1 to %d bits\n",
+                            SERVE_MAX_WIDTH );
+                    return(1);
+                }
+                break;
+            case OPT_TYPE:
+                s->typedKernel = d2b_typed( d2b_type_named( value ) );
+                s->typeName = value;
+                if( s->typedKernel == NULL )
+                {
+                    session_error( s, "ERROR:  --type is one of i8, u8, i16, "
+                            "u16, i32, u32, i64, u64, i128 or u128\n" );
+                    return(1);
+                }
+                break;
+            case OPT_IEEE:
+                s->ieeeFormat = d2b_ieee_named( value );
+                if( s->ieeeFormat == 0 )
+                {
+                    session_error( s, "ERROR:  --ieee is one of f16, f32 or "
+                            "f64\n" );
+                    return(1);
+                }
+                break;
+            case OPT_GROUP:
+                options->sections = atoi( value );
+                s->groupMode = 1;
+                if( options->sections < 1 ||
+                        options->sections > D2B_GROUP_MAX )
+                {
+                    session_error( s, "ERROR:  --group takes 1 to %d "
+                            "digits\n", D2B_GROUP_MAX );
+                    return(1);
+                }
+                break;
+            case OPT_SEP:
+                s->groupMode = 1;
+                if( d2b_set_separator( options, value ) == 1 )
+                {
+                    session_error( s, "ERROR:  --sep takes 1 to %d bytes, no "
+                            "letters, digits, quotes or backslashes\n",
+                            D2B_SEPARATOR_MAX );
+                    return(1);
+                }
+                break;
+            case OPT_FORMAT:
+                options->layout = d2b_layout_named( value );
+                if( options->layout < 0 )
+                {
+                    session_error( s, "ERROR:  --format is one of tsv, csv "
+                            "or ndjson\n" );
+                    return(1);
+                }
+                break;
+            default:
+                session_error( s, "ERROR:  --%s doesn't work with --client\n",
+                        option->name );
+                return(1);
+        }
+
+        return(0);
+    }
+
+    for( ++arg; *arg != '\0'; ++arg )
+    {
+        switch( *arg )
+        {
+            case 'v':   options->verbose = 1;           break;
+            case 'd':   options->decimal = 1;           break;
+            case 'b':   options->binary = 1;            break;
+            case 'a':   options->preciseHex = 1;        break;
+            case 'A':   options->preciseHexCaps = 1;    break;
+            case 'x':   options->hex = 1;               break;
+            case 'X':   options->hexCaps = 1;           break;
+            case 'o':   options->octal = 1;             break;
+            case 's':
+                if( options->sections == 0 )
+                    options->sections = 4;
+                break;
+            case 'l':   options->lineSpacing = 1;       break;
+            case 't':   s->textMode = 1;                break;
+            case 'e':   options->bigEndian = 0;         break;
+            case 'E':   options->bigEndian = 1;         break;
+            default:
+                session_error( s, "ERROR:  -%c doesn't work with --client\n",
+                        *arg );
+                return(1);
+        }
+    }
+
+    return(0);
+}
+
+
+/*  ----------------------  session_options  -----------------------------
+ *
+ *  set the session up from a request's [count] options, checking that they
+ *  go together as main() would.  Returns 1 if they don't.
+ */
+static int session_options( struct session *s, char **args, size_t count )
+{
+    struct d2b_options *options = &s->options;
+    size_t i = 0;
+
+    d2b_options_init( options );
+    s->textMode = 0;
+    s->ieeeFormat = 0;
+    s->typedKernel = NULL;
+    s->typeName = NULL;
+    s->groupMode = 0;
+
+    for( i = 0; i < count; ++i )
+    {
+        if( session_option( s, args[i] ) == 1 )
+            return(1);
+    }
+
+    if( options->width > 0 && ( s->textMode == 1 ||
+                options->preciseHex == 1 || options->preciseHexCaps == 1 ) )
+    {
+        session_error( s, "ERROR:  --width doesn't work with -t, -a or -A\n" );
+        return(1);
+    }
+    if( s->typedKernel != NULL && ( s->textMode == 1 || options->width > 0 ) )
+    {
+        session_error( s, "ERROR:  --type doesn't mix with -t or "
+                "--width\n" );
+        return(1);
+    }
+    if( s->ieeeFormat != 0 && ( s->textMode == 1 || options->width > 0 ||
+                s->typedKernel != NULL ) )
+    {
+        session_error( s, "ERROR:  --ieee doesn't mix with -t, --width or "
+                "--type\n" );
+        return(1);
+    }
+
+    if( s->groupMode == 1 && s->textMode == 1 )
+    {
+        session_error( s, "ERROR:  --group and --sep don't mix with -t\n" );
+        return(1);
+    }
+    if( s->groupMode == 1 && options->sections == 0 )
+        options->sections = 4;
+
+    if( d2b_conversions( options ) == 0 )
+        options->binary = 1;
+    if( options->layout != D2B_LAYOUT_LINES )
+        options->lineSpacing = 0;
+
+    return(0);
+}
+
+
+/*  With --format, start the record at [p] with [string]; see put_input */
+static size_t session_input( const struct d2b_options *options,
+        const char *string, size_t length, char *p )
+{
+    if( options->layout == D2B_LAYOUT_LINES )
+        return( 0 );
+
+    return( d2b_format_input( options, string, length, 0, p ) );
+}
+
+
+/*  A record of spaces for a number we couldn't convert; see blank_record */
+static void session_blank( struct session *s )
+{
+    size_t size = d2b_record_size( &s->options );
+
+    if( size > 0 )
+    {
+        char *p = output_reserve( &s->out, size );
+
+        memset( p, ' ', size - 1 );
+        p[size - 1] = '\n';
+        output_commit( &s->out, size );
+    }
+}
+
+
+/*  ----------------------  session_number  ------------------------------
+ *
+ *  convert one number of a request the way dec2bin converts one from stdin
+ *  or the command line, -l spacing and all.  Returns 1 if it was no good,
+ *  or 2 if it didn't fit --width.
+ */
+static int session_number( struct session *s, const char *string )
+{
+    const struct d2b_options *options = &s->options;
+    size_t length = strlen( string );
+    size_t room = ( options->layout != D2B_LAYOUT_LINES ) ?
+        d2b_input_max( length ) : 0;
+    uint64_t value = 0;
+    double real = 0;
+    size_t skip = 0;
+    size_t written = 0;
+    char *p = NULL;
+
+    /*  --ieee counts only what it prints, for -l */
+    if( s->ieeeFormat != 0 )
+    {
+        uint64_t bits = 0;
+
+        if( d2b_parse_real( string, &real ) != D2B_NUMBER )
+        {
+            session_error( s, "ERROR:  '%s' is not a number\n", string );
+            return(1);
+        }
+
+        d2b_ieee_bits( s->ieeeFormat, &real, &bits, 1 );
+        p = output_reserve( &s->out, D2B_RECORD_MAX + 1 + room );
+        skip = ( options->lineSpacing == 1 && s->pCount > 0 );
+        if( skip == 1 )
+            *p = '\n';
+        skip += session_input( options, string, length, p + skip );
+        output_commit( &s->out, skip + d2b_format_ieee( options,
+                    s->ieeeFormat, bits, p + skip ) );
+        ++s->pCount;
+        return(0);
+    }
+
+    if( options->lineSpacing == 1 && s->pCount > 0 )
+        output_putc( &s->out, '\n' );
+    ++s->pCount;
+
+    if( s->textMode == 1 )
+    {
+        size_t printed = 0;
+
+        p = output_reserve( &s->out, d2b_text_max( options, length ) );
+        output_commit( &s->out, d2b_format_text( options, string, length,
+                    &printed, p ) );
+        if( options->lineSpacing == 0 && options->layout == D2B_LAYOUT_LINES )
+            output_putc( &s->out, '\n' );
+        return(0);
+    }
+
+    if( s->typedKernel != NULL )
+    {
+        int kind = 0;
+
+        p = output_reserve( &s->out, D2B_RECORD_MAX + room );
+        skip = session_input( options, string, length, p );
+        kind = s->typedKernel( options, string, p + skip, &written );
+        if( kind == D2B_RANGE )
+        {
+            session_error( s, "ERROR:  '%s' doesn't fit in %s\n", string,
+                    s->typeName );
+            return(1);
+        }
+        if( kind != D2B_NUMBER )
+        {
+            session_error( s, "ERROR:  '%s' is not a whole number\n",
+                    string );
+            return(1);
+        }
+        output_commit( &s->out, skip + written );
+        return(0);
+    }
+
+    switch( d2b_parse( string, &value, &real ) )
+    {
+        case D2B_NEGATIVE:
+            if( options->width == 0 && options->layout == D2B_LAYOUT_LINES )
+                output_puts( &s->out, "What is this, a joke!?\n" );
+            else
+            {
+                session_error( s, "What is this, a joke!?\n" );
+                session_blank( s );
+            }
+            return(1);
+        case D2B_INVALID:
+            session_error( s, "ERROR:  '%s' is not a number\n", string );
+            session_blank( s );
+            return(1);
+        case D2B_RANGE:
+            session_error( s, "ERROR:  '%s' is past 2^64 and not a whole "
+                    "number\n", string );
+            session_blank( s );
+            return(1);
+        case D2B_HUGE:
+            session_error( s, "ERROR:  '%s' would be more than %d digits "
+                    "long\n", string, D2B_EXPANDED_MAX );
+            session_blank( s );
+            return(1);
+        case D2B_BIG:
+            if( options->width > 0 )
+            {
+                session_error( s, "ERROR:  '%s' doesn't fit in %d bits\n",
+                        string, options->width );
+                session_blank( s );
+                return(2);
+            }
+            p = output_reserve( &s->out, d2b_big_max( d2b_big_digits( string ) )
+                    + room );
+            skip = session_input( options, string, length, p );
+            written = d2b_format_big( options, string, real, p + skip );
+            if( written == D2B_FAILED )
+            {
+                session_error( s, "ERROR:  Out of memory\n" );
+                return(1);
+            }
+            break;
+        default:
+            if( d2b_fits_width( options, value ) == 0 )
+            {
+                session_error( s, "ERROR:  '%s' doesn't fit in %d bits\n",
+                        string, options->width );
+                session_blank( s );
+                return(2);
+            }
+            p = output_reserve( &s->out, D2B_RECORD_MAX + room );
+            skip = session_input( options, string, length, p );
+            written = d2b_format_u64( options, value, real, p + skip );
+            break;
+    }
+
+    output_commit( &s->out, skip + written );
+    return(0);
+}
+
+
+/*  ----------------------  session_request  -----------------------------
+ *
+ *  serve the [length] byte request in s->frame into s->out and s->err.
+ *  Returns its status.
+ */
+static int session_request( struct session *s, size_t length )
+{
+    const unsigned char *frame = (const unsigned char *)s->frame;
+    size_t optionCount = 0;
+    size_t count = 0;
+    size_t at = SERVE_HEADER - 4;
+    int status = SERVE_OK;
+    size_t i = 0;
+
+    if( length < at || ( length > at && frame[length - 1] != '\0' ) )
+    {
+        session_error( s, "ERROR:  That's not a dec2bin request\n" );
+        return( SERVE_REFUSED );
+    }
+    optionCount = get_u32( frame + 1 );
+
+    /*  Split the arguments, which are already null-terminated */
+    while( at < length )
+    {
+        if( count == s->argCapacity )
+        {
+            size_t grown = ( count > 0 ) ? count * 2 : 256;
+            char **args = realloc( s->args, grown * sizeof( *args ) );
+
+            if( args == NULL )
+            {
+                session_error( s, "ERROR:  Out of memory\n" );
+                return( SERVE_REFUSED );
+            }
+            s->args = args;
+            s->argCapacity = grown;
+        }
+
+        s->args[count++] = s->frame + at;
+        at += strlen( s->frame + at ) + 1;
+    }
+
+    if( optionCount > count )
+    {
+        session_error( s, "ERROR:  That's not a dec2bin request\n" );
+        return( SERVE_REFUSED );
+    }
+    if( session_options( s, s->args, optionCount ) == 1 )
+        return( SERVE_REFUSED );
+
+    if( ( frame[0] & SERVE_START ) != 0 )
+    {
+        s->pCount = 0;
+        if( s->options.layout != D2B_LAYOUT_LINES )
+            output_commit( &s->out, d2b_format_header( &s->options,
+                        output_reserve( &s->out, D2B_RECORD_MAX ) ) );
+    }
+
+    for( i = optionCount; i < count; ++i )
+    {
+        int result = session_number( s, s->args[i] );
+
+        if( result != 0 )
+        {
+            if( status != SERVE_WIDE )
+                status = ( result == 2 ) ? SERVE_WIDE : SERVE_FAILED;
+            if( ( frame[0] & SERVE_STOP ) != 0 )
+                break;
+        }
+    }
+
+    return( status );
+}
+
+
+/*  ----------------------  session_thread  ------------------------------
+ *
+ *  a connection: serve its requests in order until it closes
+ */
+static void *session_thread( void *argument )
+{
+    struct session *s = argument;
+    unsigned char header[SERVE_HEADER];
+    long long length = 0;
+
+    while( ( length = read_frame( s->fd, &s->frame, &s->frameCapacity,
+                    SERVE_MAX_FRAME ) ) > 0 )
+    {
+        int status = session_request( s, (size_t)length );
+        struct iovec iov[3];
+
+        /*  A frame's length has to fit its four bytes */
+        if( s->out.length + s->err.length > UINT32_MAX - SERVE_HEADER )
+        {
+            s->out.length = 0;
+            s->err.length = 0;
+            session_error( s, "ERROR:  Too much output for one request\n" );
+            status = SERVE_REFUSED;
+        }
+
+        put_u32( header, SERVE_HEADER - 4 + s->out.length + s->err.length );
+        header[4] = status;
+        put_u32( header + 5, s->out.length );
+        iov[0].iov_base = header;
+        iov[0].iov_len = SERVE_HEADER;
+        iov[1].iov_base = s->out.data;
+        iov[1].iov_len = s->out.length;
+        iov[2].iov_base = s->err.data;
+        iov[2].iov_len = s->err.length;
+
+        if( send_all( s->fd, iov, 3 ) == 1 )
+            break;
+        s->out.length = 0;
+        s->err.length = 0;
+    }
+
+    close( s->fd );
+    output_free( &s->out );
+    output_free( &s->err );
+    free( s->frame );
+    free( s->args );
+    free( s );
+
+    return( NULL );
+}
+
+
+/*  SIGINT and SIGTERM: take the socket away with us */
+static void stop_serving( int signal )
+{
+    (void)signal;
+
+    unlink( servePath );
+    _exit(0);
+}
+
+
+/*  ----------------------  serve_listen  --------------------------------
+ *
+ *  a listening socket at [path], or -1.  A socket file left by a server
+ *  that's gone is replaced; one with a server behind it isn't.
+ */
+static int serve_listen( const char *path )
+{
+    struct sockaddr_un address;
+    struct stat info;
+    int fd = -1;
+
+    if( strlen( path ) >= sizeof( address.sun_path ) )
+    {
+        fprintf(stderr, "ERROR:  Socket path '%s' is too long\n", path );
+        return( -1 );
+    }
+
+    memset( &address, 0, sizeof( address ) );
+    address.sun_family = AF_UNIX;
+    strcpy( address.sun_path, path );
+
+    fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if( fd < 0 )
+    {
+        fprintf(stderr, "ERROR:  Could not make a socket: %s\n",
+                strerror( errno ) );
+        return( -1 );
+    }
+
+    if( stat( path, &info ) == 0 && S_ISSOCK( info.st_mode ) )
+    {
+        if( connect( fd, (struct sockaddr *)&address, sizeof( address ) ) == 0 )
+        {
+            fprintf(stderr, "ERROR:  '%s' is already being served\n", path );
+            close( fd );
+            return( -1 );
+        }
+        unlink( path );
+    }
+
+    if( bind( fd, (struct sockaddr *)&address, sizeof( address ) ) != 0 ||
+            listen( fd, SOMAXCONN ) != 0 )
+    {
+        fprintf(stderr, "ERROR:  Could not serve on '%s': %s\n", path,
+                strerror( errno ) );
+        close( fd );
+        return( -1 );
+    }
+
+    return( fd );
+}
+
+
+int serve_run( const char *path )
+{
+    struct sigaction stop;
+    pthread_attr_t detached;
+    int fd = serve_listen( path );
+
+    if( fd < 0 )
+        return(1);
+
+    servePath = path;
+    memset( &stop, 0, sizeof( stop ) );
+    stop.sa_handler = stop_serving;
+    sigaction( SIGINT, &stop, NULL );
+    sigaction( SIGTERM, &stop, NULL );
+    signal( SIGPIPE, SIG_IGN );         //  A client that leaves is no matter
+
+    pthread_attr_init( &detached );
+    pthread_attr_setdetachstate( &detached, PTHREAD_CREATE_DETACHED );
+
+    for( ;; )
+    {
+        int connection = accept( fd, NULL, NULL );
+        struct session *s = NULL;
+        pthread_t id;
+
+        if( connection < 0 )
+        {
+            if( errno == EINTR || errno == ECONNABORTED )
+                continue;
+            fprintf(stderr, "ERROR:  Accepting a connection: %s\n",
+                    strerror( errno ) );
+            sleep(1);       //  Out of descriptors; give some a chance to close
+            continue;
+        }
+
+        s = calloc( 1, sizeof( *s ) );
+        if( s == NULL || output_init( &s->out, -1, SERVE_OUTPUT_SIZE ) == 1 )
+        {
+            free( s );
+            close( connection );
+            continue;
+        }
+        if( output_init( &s->err, -1, 1024 ) == 1 )
+        {
+            output_free( &s->out );
+            free( s );
+            close( connection );
+            continue;
+        }
+        s->fd = connection;
+
+        if( pthread_create( &id, &detached, session_thread, s ) != 0 )
+        {
+            close( connection );
+            output_free( &s->out );
+            output_free( &s->err );
+            free( s );
+        }
+    }
+
+    return(0);
+}
+
+
+/*  Start a request: room for its header, then the options */
+static void client_begin( struct client *c, int flags )
+{
+    size_t i = 0;
+
+    c->request.length = SERVE_HEADER;
+    c->tokens = 0;
+    c->flags = flags;
+
+    for( i = 0; i < c->optionCount; ++i )
+        output_write( &c->request, c->options[i],
+                strlen( c->options[i] ) + 1 );
+}
+
+
+/*  ----------------------  client_send  ---------------------------------
+ *
+ *  send the request put together so far, once there's room for it among
+ *  the ones out.  Returns 1 if the server's gone.
+ */
+static int client_send( struct client *c )
+{
+    unsigned char *header = (unsigned char *)c->request.data;
+    struct iovec iov;
+
+    put_u32( header, c->request.length - 4 );
+    header[4] = c->flags;
+    put_u32( header + 5, c->optionCount );
+
+    pthread_mutex_lock( &c->lock );
+    while( c->requests - c->answered >= SERVE_DEPTH )
+        pthread_cond_wait( &c->changed, &c->lock );
+    c->sent[c->requests % SERVE_DEPTH] = monotonic_ns();
+    pthread_mutex_unlock( &c->lock );
+
+    iov.iov_base = c->request.data;
+    iov.iov_len = c->request.length;
+    if( send_all( c->fd, &iov, 1 ) == 1 )
+        return(1);
+
+    pthread_mutex_lock( &c->lock );
+    ++c->requests;
+    c->stats.bytesIn += c->request.length;
+    pthread_cond_broadcast( &c->changed );
+    pthread_mutex_unlock( &c->lock );
+
+    client_begin( c, c->flags & ~SERVE_START );
+    return(0);
+}
+
+
+/*  Stdin reader hook: someone is typing, so send what they've typed so far */
+static void client_before_read( void *context )
+{
+    struct client *c = context;
+
+    if( c->tokens > 0 )
+        client_send( c );
+}
+
+
+/*  ----------------------  client_sender  -------------------------------
+ *
+ *  the sending thread for numbers from stdin: a request per batch of them,
+ *  and always at least one, so that a run with no numbers still starts
+ */
+static void *client_sender( void *argument )
+{
+    struct client *c = argument;
+    struct reader in;
+    struct token token;
+    int status = 0;
+    int gone = 0;
+
+    if( reader_init( &in, STDIN_FILENO, READ_BLOCK_SIZE ) == 1 )
+    {
+        fprintf(stderr, "ERROR:  Out of memory\n");
+        exit(1);
+    }
+    if( isatty( STDIN_FILENO ) )
+    {
+        in.before_read = client_before_read;
+        in.context = c;
+    }
+
+    while( gone == 0 && ( status = reader_next_token( &in, &token ) ) == 1 )
+    {
+        output_write( &c->request, token.data, token.length + 1 );
+        if( ++c->tokens >= SERVE_BATCH ||
+                c->request.length >= SERVE_BATCH_BYTES )
+            gone = client_send( c );
+    }
+    if( status < 0 )
+        fprintf(stderr, "ERROR:  Reading input: %s\n", strerror( errno ) );
+
+    if( gone == 0 && ( c->tokens > 0 || c->requests == 0 ) )
+        client_send( c );
+    reader_free( &in );
+
+    pthread_mutex_lock( &c->lock );
+    c->finished = 1;
+    pthread_cond_broadcast( &c->changed );
+    pthread_mutex_unlock( &c->lock );
+
+    return( NULL );
+}
+
+
+/*  ----------------------  client_receive  ------------------------------
+ *
+ *  print the answers as they come, until every request sent has one.
+ *  Returns the worst status among them, or -1 if the server went away.
+ */
+static int client_receive( struct client *c )
+{
+    char *frame = NULL;
+    size_t capacity = 0;
+    int worst = SERVE_OK;
+
+    for( ;; )
+    {
+        long long length = 0;
+        size_t printed = 0;
+
+        pthread_mutex_lock( &c->lock );
+        while( c->answered == c->requests && c->finished == 0 )
+            pthread_cond_wait( &c->changed, &c->lock );
+        if( c->answered == c->requests )
+        {
+            pthread_mutex_unlock( &c->lock );
+            break;
+        }
+        pthread_mutex_unlock( &c->lock );
+
+        length = read_frame( c->fd, &frame, &capacity, UINT32_MAX );
+        if( length < SERVE_HEADER - 4 )
+        {
+            fprintf(stderr, "ERROR:  The server hung up\n");
+            worst = -1;
+            break;
+        }
+
+        pthread_mutex_lock( &c->lock );
+        stats_latency( &c->stats, monotonic_ns() -
+                c->sent[c->answered % SERVE_DEPTH] );
+        c->stats.bytesOut += length + 4;
+        ++c->answered;
+        pthread_cond_broadcast( &c->changed );
+        pthread_mutex_unlock( &c->lock );
+
+        printed = get_u32( (unsigned char *)frame + 1 );
+        if( printed > (size_t)length - ( SERVE_HEADER - 4 ) )
+            printed = length - ( SERVE_HEADER - 4 );
+
+        struct iovec out = { frame + SERVE_HEADER - 4, printed };
+        struct iovec err = { frame + SERVE_HEADER - 4 + printed,
+            length - ( SERVE_HEADER - 4 ) - printed };
+        send_all( STDOUT_FILENO, &out, 1 );
+        send_all( STDERR_FILENO, &err, 1 );
+
+        if( frame[0] > worst )
+            worst = frame[0];
+        if( worst == SERVE_REFUSED )
+            break;
+    }
+
+    free( frame );
+    return( worst );
+}
+
+
+/*  ----------------------  client_connect  ------------------------------
+ *
+ *  a connection to the server at [path], or -1
+ */
+static int client_connect( const char *path )
+{
+    struct sockaddr_un address;
+    int fd = -1;
+
+    if( strlen( path ) >= sizeof( address.sun_path ) )
+    {
+        fprintf(stderr, "ERROR:  Socket path '%s' is too long\n", path );
+        return( -1 );
+    }
+
+    memset( &address, 0, sizeof( address ) );
+    address.sun_family = AF_UNIX;
+    strcpy( address.sun_path, path );
+
+    fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if( fd < 0 || connect( fd, (struct sockaddr *)&address,
+                sizeof( address ) ) != 0 )
+    {
+        fprintf(stderr, "ERROR:  Could not connect to '%s': %s\n", path,
+                strerror( errno ) );
+        if( fd >= 0 )
+            close( fd );
+        return( -1 );
+    }
+
+    return( fd );
+}
+
+
+int serve_client( const char *path, int argc, char *argv[] )
+{
+    struct client c;
+    char **numbers = NULL;
+    size_t numberCount = 0;
+    int statsMode = 0;
+    int textMode = 0;
+    const struct option *option = NULL;
+    const char *value = NULL;
+    int options = 1;
+    int status = 0;
+    uint64_t startNanos = monotonic_ns();
+    int i = 0;
+
+    memset( &c, 0, sizeof( c ) );
+    c.options = malloc( ( argc + 1 ) * sizeof( *c.options ) );
+    numbers = malloc( ( argc + 1 ) * sizeof( *numbers ) );
+    if( c.options == NULL || numbers == NULL ||
+            output_init( &c.request, -1, SERVE_BATCH_BYTES ) == 1 )
+    {
+        fprintf(stderr, "ERROR:  Out of memory\n");
+        return(1);
+    }
+
+    /*  Split the options from the numbers, as getopt would */
+    for( i = 0; i < argc; ++i )
+    {
+        char *arg = argv[i];
+
+        if( options == 0 || arg[0] != '-' || arg[1] == '\0' )
+            numbers[numberCount++] = arg;
+        else if( strcmp( arg, "--" ) == 0 )
+            options = 0;
+        else if( ( option = option_named( arg, &value ) ) != NULL &&
+                option->val == OPT_STATS )
+            statsMode = ( value != NULL && strcmp( value, "json" ) == 0 ) ?
+                2 : 1;
+        else if( option != NULL && option->has_arg == required_argument &&
+                value == NULL && i + 1 < argc )
+        {
+            char *joined = malloc( strlen( arg ) + strlen( argv[i + 1] ) + 2 );
+
+            if( joined == NULL )
+            {
+                fprintf(stderr, "ERROR:  Out of memory\n");
+                return(1);
+            }
+            sprintf( joined, "%s=%s", arg, argv[++i] );
+            c.options[c.optionCount++] = joined;
+        }
+        else
+        {
+            if( arg[1] != '-' && strchr( arg, 't' ) != NULL )
+                textMode = 1;
+            c.options[c.optionCount++] = arg;
+        }
+    }
+
+    int fromStdin = ( numberCount == 0 || strcmp( numbers[0], "-" ) == 0 );
+    if( fromStdin && textMode == 1 )
+    {
+        fprintf(stderr, "ERROR:  With --client, text goes on the command ");
+        fprintf(stderr, "line, not stdin\n");
+        return(1);
+    }
+
+    c.fd = client_connect( path );
+    if( c.fd < 0 )
+        return(1);
+    pthread_mutex_init( &c.lock, NULL );
+    pthread_cond_init( &c.changed, NULL );
+    stats_init( &c.stats );
+
+    /*  The command line is one request, stopping where dec2bin would */
+    if( fromStdin == 0 )
+    {
+        client_begin( &c, SERVE_START | SERVE_STOP );
+        for( i = 0; (size_t)i < numberCount; ++i )
+            output_write( &c.request, numbers[i], strlen( numbers[i] ) + 1 );
+
+        if( client_send( &c ) == 1 )
+        {
+            fprintf(stderr, "ERROR:  The server hung up\n");
+            return(1);
+        }
+        c.finished = 1;
+        status = client_receive( &c );
+    }
+    else
+    {
+        pthread_t sender;
+
+        client_begin( &c, SERVE_START );
+        if( pthread_create( &sender, NULL, client_sender, &c ) != 0 )
+        {
+            fprintf(stderr, "ERROR:  Could not start a thread\n");
+            return(1);
+        }
+
+        status = client_receive( &c );
+        if( status == SERVE_REFUSED || status < 0 )
+            return(1);
+        pthread_join( sender, NULL );
+
+        /*  A bad number from stdin is skipped, not the end of the run,
+         *  though one too wide for --width still fails it */
+        if( status == SERVE_FAILED )
+            status = SERVE_OK;
+    }
+
+    close( c.fd );
+    if( statsMode != 0 )
+        stats_report_requests( stderr, &c.stats, monotonic_ns() - startNanos,
+                ( statsMode == 2 ) );
+
+    return( status != SERVE_OK );
+}
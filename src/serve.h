@@ -0,0 +1,72 @@
+/*******************************************************************************
+ * serve.h      |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      --serve and --client.  A server keeps one dec2bin running on a Unix
+ *      socket, so scripts that call it over and over don't pay to start it
+ *      every time; a client hands it a command line's worth of numbers and
+ *      prints what comes back, which is what dec2bin itself would print.
+ *
+ *      Everything sent either way is a frame: four bytes of length (little
+ *      endian), then that many bytes.  A request is
+ *
+ *          flags           1 byte, SERVE_START and SERVE_STOP
+ *          option count    4 bytes
+ *          arguments       null-terminated strings: that many options, as
+ *                          they'd be given to dec2bin (-vx, --width=8), and
+ *                          then the numbers
+ *
+ *      and its response is
+ *
+ *          status          1 byte, SERVE_OK, SERVE_FAILED, SERVE_WIDE or
+ *                          SERVE_REFUSED
+ *          stdout length   4 bytes
+ *          output          what dec2bin would have written to stdout, and
+ *                          then what it would have written to stderr
+ *
+ *      A client can send as many requests as it likes without waiting, and
+ *      the responses come back in the same order.  A connection is one run
+ *      of dec2bin: -l spacing carries on from one request to the next until
+ *      a request starts a new run.
+ ******************************************************************************/
+#ifndef DEC2BIN_SERVE_H
+#define DEC2BIN_SERVE_H
+
+/*  Largest request a server takes */
+#define SERVE_MAX_FRAME ( 64 * 1024 * 1024 )
+
+/*  Request flags */
+enum
+{
+    SERVE_START = 1,            //  First of a run (--format prints its header)
+    SERVE_STOP = 2              //  Stop at a bad number, as on a command line
+};
+
+/*  Response statuses */
+enum
+{
+    SERVE_OK,
+    SERVE_FAILED,               //  A number was no good (dec2bin would exit 1)
+    SERVE_WIDE,                 //  ... because it didn't fit --width, which
+                                //  fails a run from stdin too
+    SERVE_REFUSED               //  The options were; nothing was converted
+};
+
+
+/*
+ *  Serve requests on a socket at [path] until killed, a thread per
+ *  connection.  Returns 1 (with a message printed) if it can't start.
+ */
+int serve_run( const char *path );
+
+/*
+ *  Send the [argc] arguments in [argv] -- a dec2bin command line, less the
+ *  program name and --client -- to the server at [path] and print what
+ *  comes back.  Numbers from stdin go out in batches, without waiting for
+ *  each answer.  --stats is the client's own, and reports how long the
+ *  requests took.  Returns the exit status dec2bin would have had.
+ */
+int serve_client( const char *path, int argc, char *argv[] );
+
+#endif
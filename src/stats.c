@@ -0,0 +1,291 @@
+/*******************************************************************************
+ * stats.c      |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      Run statistics for --stats; see stats.h
+ *
+ *  Notes:
+ *      The histogram keeps three significant bits of every latency, so a
+ *      percentile is off by at most an eighth.  That's plenty to tell a
+ *      100 ns record from a 200 ns one, and it never needs more memory.
+ ******************************************************************************/
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "stats.h"
+
+static pthread_mutex_t mergeLock = PTHREAD_MUTEX_INITIALIZER;
+
+static const char *stageNames[STAGE_COUNT] = {
+    "read", "tokenize", "parse", "format", "write"
+};
+
+/*  Same order as the D2B_RADIX_ values */
+static const char *radixNames[D2B_RADIX_COUNT] = {
+    "decimal", "hex", "hex_caps", "precise_hex", "precise_hex_caps",
+    "octal", "binary"
+};
+
+static const double percentiles[] = { 50, 90, 99, 99.9 };
+#define PERCENTILE_COUNT ( sizeof( percentiles ) / sizeof( percentiles[0] ) )
+
+
+uint64_t monotonic_ns( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return( (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec );
+}
+
+
+void stats_init( struct stats *stats )
+{
+    memset( stats, 0, sizeof( *stats ) );
+}
+
+
+void stats_latency( struct stats *stats, uint64_t nanos )
+{
+    int bucket = (int)nanos;
+
+    if( nanos >= 16 )
+    {
+        int top = 63 - __builtin_clzll( nanos );    //  4 and up
+
+        bucket = 16 + ( top - 4 ) * 8 + (int)( ( nanos >> ( top - 3 ) ) & 7 );
+    }
+
+    ++stats->latency[bucket];
+    ++stats->records;
+}
+
+
+/*  The longest latency that lands in [bucket] */
+static uint64_t bucket_limit( int bucket )
+{
+    if( bucket < 16 )
+        return( bucket );
+
+    int top = ( bucket - 16 ) / 8 + 4;
+    uint64_t step = 1ULL << ( top - 3 );
+
+    return( ( 8 + ( bucket - 16 ) % 8 ) * step + step - 1 );
+}
+
+
+void stats_merge( struct stats *into, const struct stats *from )
+{
+    int i = 0;
+
+    pthread_mutex_lock( &mergeLock );
+
+    for( i = 0; i < STAGE_COUNT; ++i )
+        into->nanos[i] += from->nanos[i];
+    for( i = 0; i < D2B_RADIX_COUNT; ++i )
+    {
+        into->radix.convertNanos[i] += from->radix.convertNanos[i];
+        into->radix.formatNanos[i] += from->radix.formatNanos[i];
+        into->radix.count[i] += from->radix.count[i];
+    }
+    for( i = 0; i < LATENCY_BUCKETS; ++i )
+        into->latency[i] += from->latency[i];
+
+    into->records += from->records;
+    into->rejected += from->rejected;
+    into->bytesIn += from->bytesIn;
+    into->bytesOut += from->bytesOut;
+    into->cacheHits += from->cacheHits;
+    into->cacheMisses += from->cacheMisses;
+
+    pthread_mutex_unlock( &mergeLock );
+}
+
+
+/*  ----------------------  percentile  ----------------------------------
+ *
+ *  the latency [p] percent of timed records came in under, or 0 if none
+ *  were timed
+ */
+static uint64_t percentile( const struct stats *stats, double p )
+{
+    uint64_t total = 0;
+    uint64_t seen = 0;
+    int i = 0;
+
+    for( i = 0; i < LATENCY_BUCKETS; ++i )
+        total += stats->latency[i];
+    if( total == 0 )
+        return( 0 );
+
+    uint64_t wanted = (uint64_t)( p / 100.0 * total + 0.999999 );
+    if( wanted < 1 )
+        wanted = 1;
+
+    for( i = 0; i < LATENCY_BUCKETS; ++i )
+    {
+        seen += stats->latency[i];
+        if( seen >= wanted )
+            return( bucket_limit( i ) );
+    }
+
+    return( bucket_limit( LATENCY_BUCKETS - 1 ) );
+}
+
+
+/*  Percentage of --cache lookups that hit */
+static double hit_rate( const struct stats *stats )
+{
+    uint64_t lookups = stats->cacheHits + stats->cacheMisses;
+
+    return( ( lookups > 0 ) ? 100.0 * stats->cacheHits / lookups : 0 );
+}
+
+
+/*  Rate of [count] over [nanos], per second */
+static double per_second( double count, uint64_t nanos )
+{
+    return( ( nanos > 0 ) ? count * 1e9 / nanos : 0 );
+}
+
+
+static void report_json( FILE *fp, const struct stats *stats,
+        uint64_t wallNanos )
+{
+    size_t i = 0;
+
+    fprintf(fp, "{\n  \"records\": %zu,\n  \"rejected\": %zu,\n",
+            stats->records, stats->rejected );
+    fprintf(fp, "  \"bytes_in\": %zu,\n  \"bytes_out\": %zu,\n",
+            stats->bytesIn, stats->bytesOut );
+    fprintf(fp, "  \"wall_seconds\": %.9f,\n", wallNanos / 1e9 );
+    fprintf(fp, "  \"records_per_sec\": %.0f,\n",
+            per_second( stats->records, wallNanos ) );
+    fprintf(fp, "  \"cache\": { \"hits\": %llu, \"misses\": %llu, "
+            "\"hit_rate\": %.2f },\n", (unsigned long long)stats->cacheHits,
+            (unsigned long long)stats->cacheMisses, hit_rate( stats ) );
+
+    fprintf(fp, "  \"stage_seconds\": {" );
+    for( i = 0; i < STAGE_COUNT; ++i )
+        fprintf(fp, "%s \"%s\": %.9f", ( i > 0 ) ? "," : "", stageNames[i],
+                stats->nanos[i] / 1e9 );
+    fprintf(fp, " },\n" );
+
+    fprintf(fp, "  \"radixes\": {" );
+    for( i = 0; i < D2B_RADIX_COUNT; ++i )
+        fprintf(fp, "%s\n    \"%s\": { \"count\": %llu, "
+                "\"convert_seconds\": %.9f, \"format_seconds\": %.9f }",
+                ( i > 0 ) ? "," : "", radixNames[i],
+                (unsigned long long)stats->radix.count[i],
+                stats->radix.convertNanos[i] / 1e9,
+                stats->radix.formatNanos[i] / 1e9 );
+    fprintf(fp, "\n  },\n" );
+
+    fprintf(fp, "  \"latency_ns\": {" );
+    for( i = 0; i < PERCENTILE_COUNT; ++i )
+        fprintf(fp, " \"p%g\": %llu,", percentiles[i],
+                (unsigned long long)percentile( stats, percentiles[i] ) );
+    fprintf(fp, " \"max\": %llu }\n}\n",
+            (unsigned long long)percentile( stats, 100 ) );
+}
+
+
+void stats_report( FILE *fp, const struct stats *stats, uint64_t wallNanos,
+        int json )
+{
+    uint64_t staged = 0;
+    size_t i = 0;
+
+    if( json == 1 )
+    {
+        report_json( fp, stats, wallNanos );
+        return;
+    }
+
+    for( i = 0; i < STAGE_COUNT; ++i )
+        staged += stats->nanos[i];
+    if( staged == 0 )
+        staged = 1;
+
+    fprintf(fp, "\nStatistics:\n");
+    fprintf(fp, "  records     %14zu   (%zu rejected)\n", stats->records,
+            stats->rejected );
+    fprintf(fp, "  bytes in    %14zu   (%.2f MB/s)\n", stats->bytesIn,
+            per_second( stats->bytesIn, wallNanos ) / 1e6 );
+    fprintf(fp, "  bytes out   %14zu   (%.2f MB/s)\n", stats->bytesOut,
+            per_second( stats->bytesOut, wallNanos ) / 1e6 );
+    fprintf(fp, "  wall time   %14.6f s (%.0f records/s)\n",
+            wallNanos / 1e9, per_second( stats->records, wallNanos ) );
+    if( stats->cacheHits + stats->cacheMisses > 0 )
+        fprintf(fp, "  cache hits  %14llu   (%.1f%% of %llu lookups)\n",
+                (unsigned long long)stats->cacheHits, hit_rate( stats ),
+                (unsigned long long)( stats->cacheHits +
+                    stats->cacheMisses ) );
+
+    fprintf(fp, "\n  stage               seconds    share\n");
+    for( i = 0; i < STAGE_COUNT; ++i )
+    {
+        fprintf(fp, "  %-16s %10.6f   %5.1f%%\n", stageNames[i],
+                stats->nanos[i] / 1e9, 100.0 * stats->nanos[i] / staged );
+
+        if( i != STAGE_FORMAT )
+            continue;
+
+        /*  The format stage, broken down by output type */
+        size_t r = 0;
+        for( r = 0; r < D2B_RADIX_COUNT; ++r )
+        {
+            if( stats->radix.count[r] == 0 )
+                continue;
+            fprintf(fp, "    %-16s %10.6f convert, %.6f format\n",
+                    radixNames[r], stats->radix.convertNanos[r] / 1e9,
+                    stats->radix.formatNanos[r] / 1e9 );
+        }
+    }
+
+    fprintf(fp, "\n  latency per record (ns):");
+    for( i = 0; i < PERCENTILE_COUNT; ++i )
+        fprintf(fp, "  p%g %llu", percentiles[i],
+                (unsigned long long)percentile( stats, percentiles[i] ) );
+    fprintf(fp, "  max %llu\n", (unsigned long long)percentile( stats, 100 ) );
+}
+
+
+void stats_report_requests( FILE *fp, const struct stats *stats,
+        uint64_t wallNanos, int json )
+{
+    size_t i = 0;
+
+    if( json == 1 )
+    {
+        fprintf(fp, "{\n  \"requests\": %zu,\n", stats->records );
+        fprintf(fp, "  \"bytes_sent\": %zu,\n  \"bytes_received\": %zu,\n",
+                stats->bytesIn, stats->bytesOut );
+        fprintf(fp, "  \"wall_seconds\": %.9f,\n", wallNanos / 1e9 );
+        fprintf(fp, "  \"requests_per_sec\": %.0f,\n",
+                per_second( stats->records, wallNanos ) );
+        fprintf(fp, "  \"latency_ns\": {" );
+        for( i = 0; i < PERCENTILE_COUNT; ++i )
+            fprintf(fp, " \"p%g\": %llu,", percentiles[i],
+                    (unsigned long long)percentile( stats, percentiles[i] ) );
+        fprintf(fp, " \"max\": %llu }\n}\n",
+                (unsigned long long)percentile( stats, 100 ) );
+        return;
+    }
+
+    fprintf(fp, "\nStatistics:\n");
+    fprintf(fp, "  requests    %14zu\n", stats->records );
+    fprintf(fp, "  bytes sent  %14zu\n", stats->bytesIn );
+    fprintf(fp, "  bytes back  %14zu\n", stats->bytesOut );
+    fprintf(fp, "  wall time   %14.6f s (%.0f requests/s)\n",
+            wallNanos / 1e9, per_second( stats->records, wallNanos ) );
+
+    fprintf(fp, "\n  latency per request (ns):");
+    for( i = 0; i < PERCENTILE_COUNT; ++i )
+        fprintf(fp, "  p%g %llu", percentiles[i],
+                (unsigned long long)percentile( stats, percentiles[i] ) );
+    fprintf(fp, "  max %llu\n", (unsigned long long)percentile( stats, 100 ) );
+}
@@ -0,0 +1,71 @@
+/*******************************************************************************
+ * stats.h      |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      Where the time goes, for --stats.  Each stage of a run (read,
+ *      tokenize, parse, format, write) adds up its time on the monotonic
+ *      clock, each record's own time goes into a log-scale histogram for
+ *      percentiles, and the lot is printed to stderr at the end, as text or
+ *      as JSON.  Nothing is timed per record unless --stats is given.
+ ******************************************************************************/
+#ifndef DEC2BIN_STATS_H
+#define DEC2BIN_STATS_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libdec2bin.h"
+
+/*  Exact buckets below 16 ns, then 8 per power of two up to 2^63 */
+#define LATENCY_BUCKETS ( 16 + 60 * 8 )
+
+enum stats_stage
+{
+    STAGE_READ,
+    STAGE_TOKENIZE,
+    STAGE_PARSE,
+    STAGE_FORMAT,
+    STAGE_WRITE,
+    STAGE_COUNT
+};
+
+struct stats
+{
+    uint64_t nanos[STAGE_COUNT];        //  Summed over threads
+    struct d2b_timing radix;            //  The format stage, by output type
+    size_t records;                     //  Numbers (or characters) converted
+    size_t rejected;                    //  Tokens that weren't numbers we take
+    size_t bytesIn;
+    size_t bytesOut;
+    uint64_t cacheHits;                 //  --cache lookups that found the
+    uint64_t cacheMisses;               //  record, and those that didn't
+    uint64_t latency[LATENCY_BUCKETS];  //  Records by time to convert
+};
+
+
+/*  Monotonic nanoseconds */
+uint64_t monotonic_ns( void );
+
+/*  Zero [stats] */
+void stats_init( struct stats *stats );
+
+/*  Count a record that took [nanos] */
+void stats_latency( struct stats *stats, uint64_t nanos );
+
+/*  Add [from] to [into]; safe to call from several threads at once */
+void stats_merge( struct stats *into, const struct stats *from );
+
+/*  Print [stats] for a run that took [wallNanos] as text, or as JSON */
+void stats_report( FILE *fp, const struct stats *stats, uint64_t wallNanos,
+        int json );
+
+/*
+ *  The same for --client, where each latency is a request's round trip and
+ *  the bytes are what was sent to the server and what came back
+ */
+void stats_report_requests( FILE *fp, const struct stats *stats,
+        uint64_t wallNanos, int json );
+
+#endif
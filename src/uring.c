@@ -0,0 +1,618 @@
+/*******************************************************************************
+ * uring.c      |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      io_uring for -i and -O files; see uring.h
+ ******************************************************************************/
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "uring.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_URING 1
+#endif
+#endif
+
+#ifdef HAVE_URING
+
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+/*  One ring: its shared queues, mapped from the kernel */
+struct ring
+{
+    int fd;
+
+    unsigned *sqHead;
+    unsigned *sqTail;
+    unsigned *sqMask;
+    unsigned *sqArray;
+    struct io_uring_sqe *sqes;
+
+    unsigned *cqHead;
+    unsigned *cqTail;
+    unsigned *cqMask;
+    struct io_uring_cqe *cqes;
+
+    void *sqMap;
+    size_t sqMapSize;
+    void *cqMap;
+    size_t cqMapSize;
+    size_t sqesSize;
+};
+
+/*  A buffer and the request it's part of */
+struct block
+{
+    char *data;
+    size_t size;                //  Bytes asked for
+    off_t offset;               //  Where in the file
+    size_t done;                //  How many have been read or written
+    int result;                 //  What the kernel said last
+    int busy;                   //  1 while the kernel has it
+};
+
+struct uring_reader
+{
+    struct ring ring;
+    int fd;
+    size_t blockSize;
+    char *buffers;
+    struct block blocks[URING_DEPTH];
+    unsigned head;              //  The block being handed out
+    size_t used;                //  ... and how much of it has been
+    off_t next;                 //  Where the next block's read starts
+};
+
+struct uring_writer
+{
+    struct ring ring;
+    int fd;
+    char *buffers;
+    struct block blocks[URING_DEPTH];
+    unsigned current;           //  The block being filled
+    off_t next;                 //  Where it'll be written
+    int error;                  //  errno of a write that failed, or 0
+};
+
+
+/*  ------------------  ring_close  ---------------------------
+ *
+ *  unmap the queues and close the ring; the kernel unregisters the buffers
+ */
+static void ring_close( struct ring *ring )
+{
+    if( ring->sqes != NULL )
+        munmap( ring->sqes, ring->sqesSize );
+    if( ring->cqMap != NULL && ring->cqMap != ring->sqMap )
+        munmap( ring->cqMap, ring->cqMapSize );
+    if( ring->sqMap != NULL )
+        munmap( ring->sqMap, ring->sqMapSize );
+    if( ring->fd >= 0 )
+        close( ring->fd );
+}
+
+
+/*  ------------------  ring_open   ---------------------------
+ *
+ *  set up a ring big enough for every block to be in flight at once, and
+ *  register [count] buffers of [size] bytes at [buffers] with it.  Returns
+ *  1 if there's no io_uring to be had, or the kernel won't pin that much.
+ */
+static int ring_open( struct ring *ring, char *buffers, size_t size,
+        unsigned count )
+{
+    struct io_uring_params params;
+    struct iovec iov[URING_DEPTH];
+    unsigned i = 0;
+
+    memset( ring, 0, sizeof( *ring ) );
+    memset( &params, 0, sizeof( params ) );
+
+    ring->fd = syscall( __NR_io_uring_setup, count, &params );
+    if( ring->fd < 0 )
+        return(1);
+
+    ring->sqMapSize = params.sq_off.array +
+        params.sq_entries * sizeof( unsigned );
+    ring->cqMapSize = params.cq_off.cqes +
+        params.cq_entries * sizeof( struct io_uring_cqe );
+    ring->sqesSize = params.sq_entries * sizeof( struct io_uring_sqe );
+
+    /*  Newer kernels put both queues in one mapping */
+    if( params.features & IORING_FEAT_SINGLE_MMAP )
+    {
+        if( ring->cqMapSize > ring->sqMapSize )
+            ring->sqMapSize = ring->cqMapSize;
+        ring->cqMapSize = ring->sqMapSize;
+    }
+
+    ring->sqMap = mmap( NULL, ring->sqMapSize, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING );
+    if( ring->sqMap == MAP_FAILED )
+    {
+        ring->sqMap = NULL;
+        ring_close( ring );
+        return(1);
+    }
+
+    if( params.features & IORING_FEAT_SINGLE_MMAP )
+        ring->cqMap = ring->sqMap;
+    else
+    {
+        ring->cqMap = mmap( NULL, ring->cqMapSize, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING );
+        if( ring->cqMap == MAP_FAILED )
+        {
+            ring->cqMap = NULL;
+            ring_close( ring );
+            return(1);
+        }
+    }
+
+    ring->sqes = mmap( NULL, ring->sqesSize, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES );
+    if( ring->sqes == MAP_FAILED )
+    {
+        ring->sqes = NULL;
+        ring_close( ring );
+        return(1);
+    }
+
+    ring->sqHead = (unsigned *)( (char *)ring->sqMap + params.sq_off.head );
+    ring->sqTail = (unsigned *)( (char *)ring->sqMap + params.sq_off.tail );
+    ring->sqMask = (unsigned *)( (char *)ring->sqMap +
+            params.sq_off.ring_mask );
+    ring->sqArray = (unsigned *)( (char *)ring->sqMap + params.sq_off.array );
+    ring->cqHead = (unsigned *)( (char *)ring->cqMap + params.cq_off.head );
+    ring->cqTail = (unsigned *)( (char *)ring->cqMap + params.cq_off.tail );
+    ring->cqMask = (unsigned *)( (char *)ring->cqMap +
+            params.cq_off.ring_mask );
+    ring->cqes = (struct io_uring_cqe *)( (char *)ring->cqMap +
+            params.cq_off.cqes );
+
+    for( i = 0; i < count; ++i )
+    {
+        iov[i].iov_base = buffers + i * size;
+        iov[i].iov_len = size;
+    }
+    if( syscall( __NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS,
+                iov, count ) != 0 )
+    {
+        ring_close( ring );
+        return(1);
+    }
+
+    return(0);
+}
+
+
+/*  ------------------  ring_queue  ---------------------------
+ *
+ *  queue a read or write of what's left of block [index] (of the buffers
+ *  registered in that order), to go in with the next ring_enter
+ */
+static void ring_queue( struct ring *ring, int fd, struct block *blocks,
+        unsigned index, int writing )
+{
+    struct block *b = &blocks[index];
+    unsigned tail = *ring->sqTail;
+    unsigned slot = tail & *ring->sqMask;
+    struct io_uring_sqe *sqe = &ring->sqes[slot];
+
+    memset( sqe, 0, sizeof( *sqe ) );
+    sqe->opcode = writing ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+    sqe->buf_index = index;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)( b->data + b->done );
+    sqe->len = b->size - b->done;
+    sqe->off = b->offset + b->done;
+    sqe->user_data = index;
+
+    ring->sqArray[slot] = slot;
+    __atomic_store_n( ring->sqTail, tail + 1, __ATOMIC_RELEASE );
+    b->busy = 1;
+}
+
+
+/*  ------------------  ring_enter  ---------------------------
+ *
+ *  submit whatever's queued and, if [wait], sleep until something is done;
+ *  then note every finished request's result in its block.  Returns 1
+ *  (with errno set) if the kernel wouldn't have it.
+ */
+static int ring_enter( struct ring *ring, struct block *blocks, int wait )
+{
+    unsigned head = 0;
+
+    for( ;; )
+    {
+        unsigned queued = *ring->sqTail -
+            __atomic_load_n( ring->sqHead, __ATOMIC_ACQUIRE );
+
+        if( queued == 0 && wait == 0 )
+            break;
+        if( syscall( __NR_io_uring_enter, ring->fd, queued, wait ? 1 : 0,
+                    wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0 ) >= 0 )
+            break;
+        if( errno != EINTR )
+            return(1);
+    }
+
+    head = *ring->cqHead;
+    while( head != __atomic_load_n( ring->cqTail, __ATOMIC_ACQUIRE ) )
+    {
+        struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cqMask];
+        struct block *b = &blocks[cqe->user_data];
+
+        b->result = cqe->res;
+        b->busy = 0;
+        ++head;
+    }
+    __atomic_store_n( ring->cqHead, head, __ATOMIC_RELEASE );
+
+    return(0);
+}
+
+
+/*  ------------------  ring_settle ---------------------------
+ *
+ *  wait until none of [blocks] is with the kernel any more; nothing may be
+ *  freed before then, since it could still be writing into it
+ */
+static void ring_settle( struct ring *ring, struct block *blocks )
+{
+    unsigned i = 0;
+
+    for( i = 0; i < URING_DEPTH; ++i )
+    {
+        while( blocks[i].busy == 1 )
+        {
+            if( ring_enter( ring, blocks, 1 ) == 1 )
+                return;
+        }
+    }
+}
+
+
+struct uring_reader *uring_reader_open( int fd, size_t blockSize )
+{
+    struct uring_reader *in = NULL;
+    unsigned i = 0;
+    off_t position = lseek( fd, 0, SEEK_CUR );
+
+    if( position < 0 || blockSize == 0 || blockSize > URING_MAX_BUFFER )
+        return( NULL );
+
+    in = calloc( 1, sizeof( *in ) );
+    if( in == NULL )
+        return( NULL );
+
+    in->buffers = malloc( blockSize * URING_DEPTH );
+    if( in->buffers == NULL || ring_open( &in->ring, in->buffers,
+                blockSize, URING_DEPTH ) == 1 )
+    {
+        free( in->buffers );
+        free( in );
+        return( NULL );
+    }
+
+    in->fd = fd;
+    in->blockSize = blockSize;
+    in->next = position;
+
+    /*  Every block starts out reading, one after the other */
+    for( i = 0; i < URING_DEPTH; ++i )
+    {
+        in->blocks[i].data = in->buffers + i * blockSize;
+        in->blocks[i].size = blockSize;
+        in->blocks[i].offset = in->next;
+        in->next += blockSize;
+        ring_queue( &in->ring, fd, in->blocks, i, 0 );
+    }
+    if( ring_enter( &in->ring, in->blocks, 0 ) == 1 )
+    {
+        ring_close( &in->ring );
+        free( in->buffers );
+        free( in );
+        return( NULL );
+    }
+
+    return( in );
+}
+
+
+ssize_t uring_read( struct uring_reader *in, void *data, size_t n )
+{
+    struct block *b = NULL;
+    size_t length = 0;
+
+    for( ;; )
+    {
+        b = &in->blocks[in->head];
+        if( b->busy == 0 )
+            break;
+        if( ring_enter( &in->ring, in->blocks, 1 ) == 1 )
+            return( -1 );
+    }
+
+    /*  Interrupted is only a reason to ask again */
+    if( b->result == -EINTR || b->result == -EAGAIN )
+    {
+        ring_queue( &in->ring, in->fd, in->blocks, in->head, 0 );
+        return( uring_read( in, data, n ) );
+    }
+    if( b->result < 0 )
+    {
+        errno = -b->result;
+        return( -1 );
+    }
+
+    /*  Nothing at all means the end of the file; the blocks after it, too */
+    if( b->result == 0 )
+        return( 0 );
+
+    length = b->result - in->used;
+    if( length > n )
+        length = n;
+    memcpy( data, b->data + in->used, length );
+    in->used += length;
+
+    /*  Used up: read the rest of a short block, or the next block along */
+    if( in->used == (size_t)b->result )
+    {
+        if( (size_t)b->result < b->size )
+        {
+            b->offset += b->result;
+            b->size -= b->result;
+        }
+        else
+        {
+            b->offset = in->next;
+            b->size = in->blockSize;
+            in->next += in->blockSize;
+            in->head = ( in->head + 1 ) % URING_DEPTH;
+        }
+        in->used = 0;
+        ring_queue( &in->ring, in->fd, in->blocks, b - in->blocks, 0 );
+
+        /*  If that doesn't go in, the next wait for it says why */
+        ring_enter( &in->ring, in->blocks, 0 );
+    }
+
+    return( length );
+}
+
+
+void uring_reader_close( struct uring_reader *in )
+{
+    if( in == NULL )
+        return;
+
+    ring_settle( &in->ring, in->blocks );
+    ring_close( &in->ring );
+    free( in->buffers );
+    free( in );
+}
+
+
+struct uring_writer *uring_writer_open( int fd, size_t capacity )
+{
+    struct uring_writer *out = NULL;
+    unsigned i = 0;
+    off_t position = lseek( fd, 0, SEEK_CUR );
+
+    if( position < 0 || capacity == 0 || capacity > URING_MAX_BUFFER )
+        return( NULL );
+
+    out = calloc( 1, sizeof( *out ) );
+    if( out == NULL )
+        return( NULL );
+
+    out->buffers = malloc( capacity * URING_DEPTH );
+    if( out->buffers == NULL || ring_open( &out->ring, out->buffers,
+                capacity, URING_DEPTH ) == 1 )
+    {
+        free( out->buffers );
+        free( out );
+        return( NULL );
+    }
+
+    for( i = 0; i < URING_DEPTH; ++i )
+        out->blocks[i].data = out->buffers + i * capacity;
+    out->fd = fd;
+    out->next = position;
+
+    return( out );
+}
+
+
+char *uring_writer_buffer( struct uring_writer *out )
+{
+    return( out->blocks[out->current].data );
+}
+
+
+/*  ------------------  writer_reap ---------------------------
+ *
+ *  wait for something to finish (if [wait]) and deal with what has: a
+ *  write cut short (by a signal, or by a big one) goes back for the rest
+ */
+static int writer_reap( struct uring_writer *out, int wait )
+{
+    unsigned i = 0;
+    int again = 0;
+
+    if( ring_enter( &out->ring, out->blocks, wait ) == 1 )
+    {
+        out->error = errno;
+        return(1);
+    }
+
+    /*  Anything unfinished and not with the kernel has just come back */
+    for( i = 0; i < URING_DEPTH; ++i )
+    {
+        struct block *b = &out->blocks[i];
+
+        if( b->busy == 1 || b->done == b->size )
+            continue;
+
+        if( b->result > 0 )
+            b->done += b->result;
+        else if( b->result != -EINTR && b->result != -EAGAIN )
+        {
+            /*  Writing nothing at all is as good as out of space */
+            out->error = ( b->result < 0 ) ? -b->result : ENOSPC;
+            b->done = b->size;
+            continue;
+        }
+
+        if( b->done < b->size )
+        {
+            ring_queue( &out->ring, out->fd, out->blocks, i, 1 );
+            again = 1;
+        }
+    }
+
+    if( again == 1 && ring_enter( &out->ring, out->blocks, 0 ) == 1 )
+    {
+        out->error = errno;
+        return(1);
+    }
+
+    return(0);
+}
+
+
+char *uring_write( struct uring_writer *out, size_t length )
+{
+    struct block *b = &out->blocks[out->current];
+
+    if( length > 0 )
+    {
+        b->size = length;
+        b->offset = out->next;
+        b->done = 0;
+        out->next += length;
+        ring_queue( &out->ring, out->fd, out->blocks, out->current, 1 );
+        writer_reap( out, 0 );
+
+        out->current = ( out->current + 1 ) % URING_DEPTH;
+        b = &out->blocks[out->current];
+    }
+
+    /*  The next buffer was the first to go out, so it's first to be free */
+    while( out->error == 0 && ( b->busy == 1 || b->done < b->size ) )
+        writer_reap( out, 1 );
+
+    if( out->error != 0 )
+    {
+        errno = out->error;
+        return( NULL );
+    }
+
+    return( b->data );
+}
+
+
+int uring_writer_finish( struct uring_writer *out )
+{
+    unsigned i = 0;
+
+    for( i = 0; i < URING_DEPTH && out->error == 0; ++i )
+    {
+        struct block *b = &out->blocks[i];
+
+        while( out->error == 0 && ( b->busy == 1 || b->done < b->size ) )
+            writer_reap( out, 1 );
+    }
+
+    if( out->error != 0 )
+    {
+        errno = out->error;
+        return(1);
+    }
+
+    lseek( out->fd, out->next, SEEK_SET );
+    return(0);
+}
+
+
+void uring_writer_close( struct uring_writer *out )
+{
+    if( out == NULL )
+        return;
+
+    uring_writer_finish( out );
+    ring_settle( &out->ring, out->blocks );
+    ring_close( &out->ring );
+    free( out->buffers );
+    free( out );
+}
+
+#else
+
+/*  No io_uring here: nothing opens, so plain read() and write() it is */
+
+struct uring_reader *uring_reader_open( int fd, size_t blockSize )
+{
+    (void)fd;
+    (void)blockSize;
+    return( NULL );
+}
+
+ssize_t uring_read( struct uring_reader *in, void *data, size_t n )
+{
+    (void)in;
+    (void)data;
+    (void)n;
+    errno = ENOSYS;
+    return( -1 );
+}
+
+void uring_reader_close( struct uring_reader *in )
+{
+    (void)in;
+}
+
+struct uring_writer *uring_writer_open( int fd, size_t capacity )
+{
+    (void)fd;
+    (void)capacity;
+    return( NULL );
+}
+
+char *uring_writer_buffer( struct uring_writer *out )
+{
+    (void)out;
+    return( NULL );
+}
+
+char *uring_write( struct uring_writer *out, size_t length )
+{
+    (void)out;
+    (void)length;
+    errno = ENOSYS;
+    return( NULL );
+}
+
+int uring_writer_finish( struct uring_writer *out )
+{
+    (void)out;
+    return(0);
+}
+
+void uring_writer_close( struct uring_writer *out )
+{
+    (void)out;
+}
+
+#endif
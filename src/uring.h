@@ -0,0 +1,76 @@
+/*******************************************************************************
+ * uring.h      |   part of dec2bin     |   FreeBSD License
+ * James Hendrie                        |   hendrie.james@gmail.com
+ *
+ *  Description:
+ *      io_uring for -i and -O files, so the disk works while we convert.  A
+ *      reader keeps several big reads of the file ahead of us in flight and
+ *      hands their bytes out as read() would; a writer takes a full output
+ *      buffer, starts writing it and hands back another one to fill.  Their
+ *      buffers are registered with the kernel, so it doesn't have to map
+ *      them for every request.
+ *
+ *      Both talk to the kernel directly, with no liburing.  Where io_uring
+ *      isn't there (an old kernel, a container that blocks it, or a build
+ *      without its header) the open functions return NULL, and the caller
+ *      goes on with plain read() and write().
+ ******************************************************************************/
+#ifndef DEC2BIN_URING_H
+#define DEC2BIN_URING_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/*  Buffers each reader and writer keeps */
+#define URING_DEPTH 4
+
+/*  Biggest buffer we'll register; past that, plain I/O will do */
+#define URING_MAX_BUFFER ( 256 * 1024 * 1024 )
+
+struct uring_reader;
+struct uring_writer;
+
+
+/*
+ *  Start reading [fd], from where it is now, [blockSize] bytes a request.
+ *  Returns NULL if io_uring can't be had (or [fd] can't seek).
+ */
+struct uring_reader *uring_reader_open( int fd, size_t blockSize );
+
+/*
+ *  read() from what [in] has read ahead: up to [n] bytes into [data],
+ *  waiting for them if they haven't come in yet.  Returns how many, 0 at
+ *  the end of the file, or -1 (with errno set) on an error.
+ */
+ssize_t uring_read( struct uring_reader *in, void *data, size_t n );
+
+/*  Wait for any reads still going and let the reader go */
+void uring_reader_close( struct uring_reader *in );
+
+
+/*
+ *  Start writing to [fd], from where it is now, out of buffers of
+ *  [capacity] bytes.  Returns NULL if io_uring can't be had.
+ */
+struct uring_writer *uring_writer_open( int fd, size_t capacity );
+
+/*  The buffer to fill first */
+char *uring_writer_buffer( struct uring_writer *out );
+
+/*
+ *  Start writing the first [length] bytes of the buffer being filled and
+ *  hand back the next one, once it's free.  Returns NULL (with errno set)
+ *  if a write has failed.
+ */
+char *uring_write( struct uring_writer *out, size_t length );
+
+/*
+ *  Wait for every write to finish and leave the file position after the
+ *  last of them.  Returns 1 (with errno set) if any failed.
+ */
+int uring_writer_finish( struct uring_writer *out );
+
+/*  Finish and let the writer (and its buffers) go */
+void uring_writer_close( struct uring_writer *out );
+
+#endif
@@ -0,0 +1,390 @@
+#!/bin/sh
+#===============================================================================
+#   check.sh    |   part of dec2bin     |   FreeBSD License
+#   James Hendrie                       |   hendrie.james@gmail.com
+#
+#   Checks a dec2bin binary against answers worked out elsewhere, by seq,
+#   python3 and xxd, and prints a line for each case that gets it wrong.
+#
+#   Usage:  check.sh [DEC2BIN]
+#
+#   Prints a count at the end; exits 1 if anything failed.
+#===============================================================================
+
+DEC2BIN=${1:-./dec2bin}
+
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/dec2bin-check.XXXXXX") || exit 1
+SERVER=""
+trap '[ -n "$SERVER" ] && kill "$SERVER"; rm -rf "$WORK"' EXIT INT TERM
+
+if ! command -v python3 > /dev/null; then
+    echo "check.sh needs python3 for the expected answers" >&2
+    exit 1
+fi
+
+passed=0
+failed=0
+
+
+#   same NAME: compare $WORK/got with $WORK/want
+same()
+{
+    if cmp -s "$WORK/got" "$WORK/want"; then
+        passed=$(( passed + 1 ))
+    else
+        failed=$(( failed + 1 ))
+        echo "FAIL: $1"
+        diff "$WORK/want" "$WORK/got" | head -5
+    fi
+}
+
+
+#   expect NAME INPUT WANT FLAGS...: dec2bin FLAGS - < INPUT should print WANT,
+#   under each DEC2BIN_KERNEL level (auto being whatever the CPU has) and
+#   again with -j4
+expect()
+{
+    name=$1; input=$2; want=$3
+    shift 3
+
+    cp "$want" "$WORK/want"
+    for kernel in scalar sse2 auto; do
+        DEC2BIN_KERNEL=$kernel "$DEC2BIN" "$@" - < "$input" \
+            > "$WORK/got" 2> /dev/null
+        same "$name ($kernel)"
+        DEC2BIN_KERNEL=$kernel "$DEC2BIN" -j4 "$@" - < "$input" \
+            > "$WORK/got" 2> /dev/null
+        same "$name -j4 ($kernel)"
+    done
+}
+
+
+#   run NAME WANT FLAGS...: dec2bin FLAGS, with nothing on stdin, should
+#   print WANT
+run()
+{
+    name=$1
+    cp "$2" "$WORK/want"
+    shift 2
+
+    "$DEC2BIN" "$@" < /dev/null > "$WORK/got" 2> /dev/null
+    same "$name"
+}
+
+
+#   Numbers of every length up to 20 digits, the edges of each power of two
+#   and of ten, and numbers past 64 bits up to a few thousand digits, with
+#   the answers for each output type
+python3 - "$WORK" << 'EOF'
+import random, struct, sys
+
+work = sys.argv[1]
+random.seed(2017)
+
+small = list(range(0, 1100))
+for k in range(1, 65):
+    small += [2**k - 1, 2**k, 2**k + 1]
+for k in range(1, 20):
+    small += [10**k - 1, 10**k, 10**k + 1]
+for digits in range(1, 21):
+    for _ in range(200):
+        small.append(random.randrange(10**(digits - 1), min(10**digits, 2**64)))
+
+big = []
+for k in range(65, 300, 7):
+    big += [2**k - 1, 2**k, 2**k + 1]
+for k in (20, 38, 39, 76, 77, 152, 304, 305, 608, 1216, 2432):
+    big += [10**k - 1, 10**k, 10**k + 1]
+for digits in list(range(21, 400)) + [1000, 2000, 3000]:
+    big.append(random.randrange(10**(digits - 1), 10**digits))
+
+def write(name, numbers, text=None):
+    with open(f"{work}/{name}", "w") as f:
+        f.write("".join(f"{n}\n" for n in numbers) if text is None else text)
+    for flag in "bdxXo":
+        with open(f"{work}/{name}.{flag}", "w") as f:
+            f.write("".join(format(n, flag) + "\n" for n in numbers))
+    with open(f"{work}/{name}.e", "w") as f:
+        f.write("".join(format(n, "b")[::-1] + "\n" for n in numbers))
+
+write("small", small)
+write("big", big)
+
+# The way people type them: padded, signed and spaced
+odd = [7, 8, 255, 65536, 2**64 - 1, 0, 12]
+write("odd", odd, "007\n+8\n  255\n0000065536\n+18446744073709551615\n"
+      "00000000000000000000000000\n\t 12 \n")
+
+# And in exponent form, past 2^64 included
+exponent = [10**19, 2**64, 10**20, 25 * 10**29, 15, 10**300]
+write("exponent", exponent, "1e19\n18446744073709551616.0\n1e20\n2.5e30\n"
+      "1.5E1\n1e300\n")
+
+# --raw: records in each byte order, 32 and 64 bits wide
+for name, fmt, bits in (("u32le", "<I", 32), ("u32be", ">I", 32),
+                        ("u64le", "<Q", 64), ("u64be", ">Q", 64)):
+    numbers = [0, 1, 255, 256, 2**(bits - 1), 2**bits - 1]
+    numbers += [random.randrange(2**bits) for _ in range(5000)]
+    with open(f"{work}/{name}", "wb") as f:
+        f.write(b"".join(struct.pack(fmt, n) for n in numbers))
+    with open(f"{work}/{name}.b", "w") as f:
+        f.write("".join(format(n, "b") + "\n" for n in numbers))
+
+# --type: two's complement, every bit of the type, in binary, octal and hex;
+# the ends of each type as arguments too
+for bits in (8, 16, 32, 64, 128):
+    for signed in (True, False):
+        low, high = (-2**(bits - 1), 2**(bits - 1) - 1) if signed \
+            else (0, 2**bits - 1)
+        ends = [low, low + 1, -1, 0, 1, high - 1, high] if signed \
+            else [low, low + 1, high - 1, high]
+        numbers = ends + [random.randint(low, high) for _ in range(2000)]
+        name = ("i" if signed else "u") + str(bits)
+        with open(f"{work}/{name}", "w") as f:
+            f.write("".join(f"{n}\n" for n in numbers))
+        with open(f"{work}/{name}.args", "w") as f:
+            f.write(" ".join(str(n) for n in ends))
+        for flag, fmt, width in (("b", "b", bits), ("x", "x", bits // 4),
+                                 ("o", "o", (bits + 2) // 3)):
+            for suffix, values in ((flag, numbers), ("args." + flag, ends)):
+                with open(f"{work}/{name}.{suffix}", "w") as f:
+                    f.write("".join(format(n % 2**bits, f"0{width}{fmt}")
+                                    + "\n" for n in values))
+
+# --ieee: rounding to nearest, ties to even, from decimal; subnormals,
+# infinities and NaN; with -s, sign, exponent and mantissa apart
+floats = ["0", "-0", "1", "-1.5", "0.1", "0.333333333333333333", "65504",
+          "65519", "65520", "2049", "2051", "16777217", "16777219",
+          "1e-5", "6e-8", "2e-8", "1e-40", "1.4e-45", "1e-310", "5e-324",
+          "1e38", "3.5e38", "1.7976931348623157e308", "inf", "-inf", "nan"]
+floats += [repr(random.uniform(-1, 1) * 10**random.randint(-50, 50))
+           for _ in range(2000)]
+with open(f"{work}/ieee", "w") as f:
+    f.write("".join(f"{s}\n" for s in floats))
+for name, fmt, bits, exponent in (("f16", ">e", 16, 5), ("f32", ">f", 32, 8),
+                                  ("f64", ">d", 64, 11)):
+    words = []
+    for s in floats:
+        x = float(s)
+        try:
+            word = int.from_bytes(struct.pack(fmt, x), "big")
+        except OverflowError:
+            infinity = (2**exponent - 1) << (bits - exponent - 1)
+            word = (x < 0) << (bits - 1) | infinity
+        words.append(format(word, f"0{bits}b"))
+    for suffix, split in (("b", lambda w: w), ("s", lambda w: " ".join(
+            (w[0], w[1:exponent + 1], w[exponent + 1:])))):
+        with open(f"{work}/ieee.{name}.{suffix}", "w") as f:
+            f.write("".join(split(w) + "\n" for w in words))
+    with open(f"{work}/ieee.{name}.x", "w") as f:
+        f.write("".join(format(int(w, 2), f"0{bits // 4}x") + "\n"
+                        for w in words))
+
+# --range: steps, the top of 64 bits, and -e
+for name, start, end, step in (("count", 1000, 70000, 1),
+                               ("top", 2**64 - 5000, 2**64 - 1, 3),
+                               ("wrap", 2**64 - 100, 2**64 - 1, 7),
+                               ("last", 2**64 - 1, 2**64 - 1, 1)):
+    numbers = range(start, end + 1, step)
+    with open(f"{work}/range.{name}", "w") as f:
+        f.write(f"{start} {end} {step}")
+    with open(f"{work}/range.{name}.b", "w") as f:
+        f.write("".join(format(n, "b") + "\n" for n in numbers))
+    with open(f"{work}/range.{name}.e", "w") as f:
+        f.write("".join(format(n, "b")[::-1] + "\n" for n in numbers))
+
+# --cache: a few hundred numbers, over and over
+pool = random.sample(small, 200) + random.sample(big, 100)
+with open(f"{work}/repeats", "w") as f:
+    f.write("".join(f"{random.choice(pool)}\n" for _ in range(100000)))
+
+# -k: fields 2 and 4 of each line, in hex, the rest left alone
+lines, want = [], []
+for i in range(3000):
+    a, b = random.randrange(2**64), random.randrange(10**30)
+    lines.append(f"id{i} {a} word {b} {i}")
+    want.append(f"id{i} {a:x} word {b:x} {i}")
+lines.append("no numbers here at all")
+want.append("no numbers here at all")
+with open(f"{work}/fields", "w") as f:
+    f.write("\n".join(lines) + "\n")
+with open(f"{work}/fields.want", "w") as f:
+    f.write("\n".join(want) + "\n")
+EOF
+[ $? -eq 0 ] || exit 1
+
+
+#   Decimal in, decimal out: nothing to do but parse it right
+seq 0 250000 > "$WORK/seq"
+expect "seq -d" "$WORK/seq" "$WORK/seq" -d
+
+for set in small big odd exponent; do
+    expect "$set binary" "$WORK/$set" "$WORK/$set.b"
+    expect "$set -d" "$WORK/$set" "$WORK/$set.d" -d
+    expect "$set -x" "$WORK/$set" "$WORK/$set.x" -x
+    expect "$set -X" "$WORK/$set" "$WORK/$set.X" -X
+    expect "$set -o" "$WORK/$set" "$WORK/$set.o" -o
+    expect "$set -e" "$WORK/$set" "$WORK/$set.e" -e
+done
+
+#   Past 2^64 with no whole number to convert, or one too long to write out
+printf '18446744073709551616.5\ninf\n1e10000000\n1e9999999999\n' \
+    > "$WORK/refused"
+cat > "$WORK/want" << 'EOF'
+ERROR:  '18446744073709551616.5' is past 2^64 and not a whole number
+ERROR:  'inf' is past 2^64 and not a whole number
+ERROR:  '1e10000000' would be more than 1000000 digits long
+ERROR:  '1e9999999999' would be more than 1000000 digits long
+EOF
+"$DEC2BIN" - < "$WORK/refused" > "$WORK/got" 2>&1
+same "refused past 2^64"
+
+#   --width, and numbers that need more bits than it: an error and a blank
+#   record in their place, past 64 bits too, whether from stdin, the command
+#   line or --range
+printf '5\n300\n18446744073709551616\n7\n' > "$WORK/wide"
+printf '00000101\n        \n        \n00000111\nexit 1\n' > "$WORK/want"
+"$DEC2BIN" --width=8 - < "$WORK/wide" > "$WORK/got" 2> /dev/null
+echo "exit $?" >> "$WORK/got"
+same "--width=8, too wide (stdin)"
+
+printf '00000101\n        \nexit 1\n' > "$WORK/want"
+for number in 300 18446744073709551616; do
+    "$DEC2BIN" --width=8 5 $number > "$WORK/got" 2> /dev/null
+    echo "exit $?" >> "$WORK/got"
+    same "--width=8 5 $number"
+done
+
+printf '1110\n1111\n    \nexit 1\n' > "$WORK/want"
+"$DEC2BIN" --width=4 --range 14 17 > "$WORK/got" 2> /dev/null
+echo "exit $?" >> "$WORK/got"
+same "--width=4 --range 14 17"
+
+#   --raw, and the whole records before a partial one at the end, which is an
+#   error
+for format in u32le u32be u64le u64be; do
+    expect "--raw=$format" "$WORK/$format" "$WORK/$format.b" --raw=$format
+done
+
+head -c 4003 "$WORK/u32le" > "$WORK/partial"
+{ head -n 1000 "$WORK/u32le.b"; echo "exit 1"; } > "$WORK/want"
+"$DEC2BIN" --raw=u32le - < "$WORK/partial" > "$WORK/got" 2> /dev/null
+echo "exit $?" >> "$WORK/got"
+same "--raw=u32le, partial record"
+
+#   And back again, which goes through the binary and hex parsers
+for set in small big; do
+    for flag in -b -e -x -X -o; do
+        expect "$set -r$flag" "$WORK/$set.${flag#-}" "$WORK/$set" -r $flag
+    done
+done
+
+#   --type, from stdin and, negatives and all, as arguments after --
+for type in i8 u8 i16 u16 i32 u32 i64 u64 i128 u128; do
+    for flag in b x o; do
+        expect "--type=$type -$flag" "$WORK/$type" "$WORK/$type.$flag" \
+            --type=$type -$flag
+        run "--type=$type -$flag (arguments)" "$WORK/$type.args.$flag" \
+            --type=$type -$flag -- $(cat "$WORK/$type.args")
+    done
+done
+
+#   --ieee
+for format in f16 f32 f64; do
+    expect "--ieee=$format" "$WORK/ieee" "$WORK/ieee.$format.b" \
+        --ieee=$format
+    expect "--ieee=$format -s" "$WORK/ieee" "$WORK/ieee.$format.s" \
+        --ieee=$format -s
+    expect "--ieee=$format -x" "$WORK/ieee" "$WORK/ieee.$format.x" \
+        --ieee=$format -x
+done
+
+#   --cache should make no difference to the output, whether everything fits
+#   or it has to keep throwing records out
+for flags in "-b" "-x" "-v -s" "-e"; do
+    "$DEC2BIN" $flags - < "$WORK/repeats" > "$WORK/repeats.want"
+    expect "--cache $flags" "$WORK/repeats" "$WORK/repeats.want" \
+        --cache $flags
+    expect "--cache=4K $flags" "$WORK/repeats" "$WORK/repeats.want" \
+        --cache=4K $flags
+done
+
+expect "-k fields" "$WORK/fields" "$WORK/fields.want" -F ' ' -k 2,4 -x
+
+#   --bitstats has no one else to ask, but the kernels should agree
+DEC2BIN_KERNEL=scalar "$DEC2BIN" --bitstats - < "$WORK/small" \
+    > "$WORK/bitstats" 2> /dev/null
+expect "--bitstats" "$WORK/small" "$WORK/bitstats" --bitstats
+
+
+#   -f against the tool it copies, where there is one
+if command -v xxd > /dev/null; then
+    head -c 100000 "$WORK/big" > "$WORK/bytes"
+    printf '\0\377\200' >> "$WORK/bytes"
+    xxd -b "$WORK/bytes" > "$WORK/bytes.want"
+    run "-f" "$WORK/bytes.want" -vs -f "$WORK/bytes"
+    run "-f -j4" "$WORK/bytes.want" -j4 -vs -f "$WORK/bytes"
+fi
+
+
+#   --range, by ones against seq and the rest against python3
+seq 1000 7 70000 > "$WORK/want"
+"$DEC2BIN" -d --range 1000 70000 7 > "$WORK/got" 2> /dev/null
+same "--range 1000 70000 7 -d"
+
+for span in count top wrap last; do
+    run "--range $(cat "$WORK/range.$span")" "$WORK/range.$span.b" \
+        --range $(cat "$WORK/range.$span")
+    run "--range $(cat "$WORK/range.$span") -e" "$WORK/range.$span.e" \
+        -e --range $(cat "$WORK/range.$span")
+done
+
+
+#   --uring should write just what plain -i and -O do
+for flags in "-b" "-x" "-j4 -v"; do
+    "$DEC2BIN" $flags -i "$WORK/big" -O "$WORK/want" 2> /dev/null
+    "$DEC2BIN" --uring $flags -i "$WORK/big" -O "$WORK/got" 2> /dev/null
+    same "--uring $flags"
+done
+
+
+#   A server should answer just as dec2bin would, for numbers on the command
+#   line and from stdin; a client prints stderr after stdout, not between
+#   records, so the two are compared one after the other
+"$DEC2BIN" --serve "$WORK/socket" 2> /dev/null &
+SERVER=$!
+tries=0
+while [ ! -S "$WORK/socket" ] && [ $tries -lt 50 ]; do
+    sleep 0.1
+    tries=$(( tries + 1 ))
+done
+
+for flags in "-x" "-vo" "-d --format=csv" "--wid=16" "--group 3 --sep=_ -b"; do
+    { "$DEC2BIN" $flags - < "$WORK/small"; echo "exit $?"; } \
+        > "$WORK/want" 2> "$WORK/errors"
+    cat "$WORK/errors" >> "$WORK/want"
+    { "$DEC2BIN" --client "$WORK/socket" $flags - < "$WORK/small"
+        echo "exit $?"; } > "$WORK/got" 2> "$WORK/errors"
+    cat "$WORK/errors" >> "$WORK/got"
+    same "--client $flags (stdin)"
+done
+
+{ "$DEC2BIN" --width=8 - < "$WORK/wide"; echo "exit $?"; } \
+    > "$WORK/want" 2> "$WORK/errors"
+cat "$WORK/errors" >> "$WORK/want"
+{ "$DEC2BIN" --client "$WORK/socket" --width=8 - < "$WORK/wide"
+    echo "exit $?"; } > "$WORK/got" 2> "$WORK/errors"
+cat "$WORK/errors" >> "$WORK/got"
+same "--client --width=8, too wide (stdin)"
+
+"$DEC2BIN" -x 12 $(head -n 20 "$WORK/big") > "$WORK/want" 2>&1
+"$DEC2BIN" --client "$WORK/socket" -x 12 $(head -n 20 "$WORK/big") \
+    > "$WORK/got" 2>&1
+same "--client -x (arguments)"
+
+kill "$SERVER"
+SERVER=""
+
+
+echo "$passed passed, $failed failed"
+[ $failed -eq 0 ]